@@ -25,7 +25,9 @@ SOURCES += src/harbour-fernschreiber.cpp \
     src/boolfiltermodel.cpp \
     src/chatpermissionfiltermodel.cpp \
     src/chatlistmodel.cpp \
+    src/chatlistsnapshot.cpp \
     src/chatmodel.cpp \
+    src/chatstore.cpp \
     src/contactsmodel.cpp \
     src/dbusadaptor.cpp \
     src/dbusinterface.cpp \
@@ -39,9 +41,15 @@ SOURCES += src/harbour-fernschreiber.cpp \
     src/stickermanager.cpp \
     src/tdlibfile.cpp \
     src/tdlibreceiver.cpp \
+    src/tdlibrecording.cpp \
+    src/tdlibrequest.cpp \
+    src/tdlibrequestqueue.cpp \
+    src/tdlibresponse.cpp \
+    src/tdlibupdates.cpp \
     src/tdlibwrapper.cpp \
     src/textfiltermodel.cpp \
-    src/tgsplugin.cpp
+    src/tgsplugin.cpp \
+    src/userstore.cpp
 
 DISTFILES += qml/harbour-fernschreiber.qml \
     qml/components/AudioPreview.qml \
@@ -183,9 +191,19 @@ message(arm64)
 
 INCLUDEPATH += $$PWD/tdlib/include
 DEPENDPATH += $$PWD/tdlib/include
-LIBS += -L$$PWD/tdlib/$${TARGET_ARCHITECTURE}/lib/ -ltdjson
-telegram.files = $$PWD/tdlib/$${TARGET_ARCHITECTURE}/lib
-telegram.path = /usr/share/$${TARGET}
+
+# qmake CONFIG+=tdlibsimulator builds against a simulated TDLib which
+# generates synthetic load instead of talking to Telegram, see
+# src/tdlibsimulator.cpp
+tdlibsimulator {
+    message(Using simulated TDLib)
+    SOURCES += src/tdlibsimulator.cpp
+} else {
+    LIBS += -L$$PWD/tdlib/$${TARGET_ARCHITECTURE}/lib/ -ltdjson
+    telegram.files = $$PWD/tdlib/$${TARGET_ARCHITECTURE}/lib
+    telegram.path = /usr/share/$${TARGET}
+    INSTALLS += telegram
+}
 
 gui.files = qml
 gui.path = /usr/share/$${TARGET}
@@ -216,7 +234,7 @@ fernschreiber.desktop.files = $${TARGET}.desktop
 database.files = db
 database.path = /usr/share/$${TARGET}
 
-INSTALLS += telegram 86.png 108.png 128.png 172.png 256.png \
+INSTALLS += 86.png 108.png 128.png 172.png 256.png \
             fernschreiber.desktop gui images database
 
 HEADERS += \
@@ -224,7 +242,9 @@ HEADERS += \
     src/boolfiltermodel.h \
     src/chatpermissionfiltermodel.h \
     src/chatlistmodel.h \
+    src/chatlistsnapshot.h \
     src/chatmodel.h \
+    src/chatstore.h \
     src/contactsmodel.h \
     src/dbusadaptor.h \
     src/dbusinterface.h \
@@ -240,10 +260,16 @@ HEADERS += \
     src/stickermanager.h \
     src/tdlibfile.h \
     src/tdlibreceiver.h \
+    src/tdlibrecording.h \
+    src/tdlibrequest.h \
+    src/tdlibrequestqueue.h \
+    src/tdlibresponse.h \
     src/tdlibsecrets.h \
+    src/tdlibupdates.h \
     src/tdlibwrapper.h \
     src/textfiltermodel.h \
-    src/tgsplugin.h
+    src/tgsplugin.h \
+    src/userstore.h
 
 # https://github.com/Samsung/rlottie.git
 
@@ -19,6 +19,7 @@
 import QtQuick 2.6
 import Sailfish.Silica 1.0
 import QtMultimedia 5.6
+import WerkWolf.Fernschreiber 1.0
 import "../"
 import "../../js/functions.js" as Functions
 import "../../js/debug.js" as Debug
@@ -114,7 +115,7 @@ MessageContentBase {
             videoComponentLoader.active = true;
         } else {
             videoDownloadBusyIndicator.running = true;
-            tdLibWrapper.downloadFile(videoFileId);
+            tdLibWrapper.downloadFile(videoFileId, TelegramAPI.PriorityInteractive);
         }
     }
 
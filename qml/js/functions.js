@@ -113,7 +113,7 @@ function getMessageText(message, simple, currentUserId, ignoreEntities) {
                 if (i > 0) {
                     addedUserNames += ", ";
                 }
-                addedUserNames += getUserName(tdLibWrapper.getUserInformation(message.content.member_user_ids[i]));
+                addedUserNames += tdLibWrapper.getUserFullName(message.content.member_user_ids[i]);
             }
             return myself ? qsTr("have added %1 to the chat", "myself").arg(addedUserNames) : qsTr("has added %1 to the chat").arg(addedUserNames);
         }
@@ -121,7 +121,7 @@ function getMessageText(message, simple, currentUserId, ignoreEntities) {
         if (message.sender_id['@type'] === "messageSenderUser" && message.sender_id.user_id === message.content.user_id) {
             return myself ? qsTr("left this chat", "myself") : qsTr("left this chat");
         } else {
-            return myself ? qsTr("have removed %1 from the chat", "myself").arg(getUserName(tdLibWrapper.getUserInformation(message.content.user_id))) : qsTr("has removed %1 from the chat").arg(getUserName(tdLibWrapper.getUserInformation(message.content.user_id)));
+            return myself ? qsTr("have removed %1 from the chat", "myself").arg(tdLibWrapper.getUserFullName(message.content.user_id)) : qsTr("has removed %1 from the chat").arg(tdLibWrapper.getUserFullName(message.content.user_id));
         }
     case 'messageChatChangeTitle':
         return myself ? qsTr("changed the chat title to %1", "myself").arg(message.content.title) : qsTr("changed the chat title to %1").arg(message.content.title);
@@ -491,7 +491,7 @@ function getMessagesArrayText(messages) {
     var lastSenderName = "";
     var lines = [];
     for(var i = 0; i < messages.length; i += 1) {
-        var senderName = getUserName(tdLibWrapper.getUserInformation(messages[i].sender_id.user_id));
+        var senderName = tdLibWrapper.getUserFullName(messages[i].sender_id.user_id);
         if(senderName !== lastSenderName) {
             lines.push(senderName);
         }
@@ -518,6 +518,12 @@ Page {
                 updateChatPartnerStatusText();
             }
         }
+        onUserStatusUpdated: {
+            if ((isPrivateChat || isSecretChat) && chatPartnerInformation.id.toString() === userId ) {
+                chatPartnerInformation.status = status;
+                updateChatPartnerStatusText();
+            }
+        }
         onBasicGroupUpdated: {
             if (isBasicGroup && chatGroupInformation.id.toString() === groupId ) {
                 chatGroupInformation = groupInformation;
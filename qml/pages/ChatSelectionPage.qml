@@ -86,6 +86,9 @@ Dialog {
         delegate: ChatListViewItem {
             ownUserId: chatSelectionPage.myUserId
             onClicked: {
+                if (is_placeholder) {
+                    return;
+                }
                 var chat = tdLibWrapper.getChat(display.id);
                 switch(chatSelectionPage.state) {
                 case "forwardMessages":
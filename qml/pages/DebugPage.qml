@@ -55,6 +55,36 @@ Page {
                 onClicked: chatListModel.showAllChats = !chatListModel.showAllChats
             }
 
+            Column {
+                id: chatListColumn
+                width: parent.width
+
+                // Times are in milliseconds since loading has started
+                property var statistics: tdLibWrapper.getChatListStatistics()
+
+                function time(ms) {
+                    return ms < 0 ? "-" : (ms + " ms");
+                }
+
+                DetailItem {
+                    label: "Loaded chats"
+                    value: chatListColumn.statistics.chats + " in " + chatListColumn.statistics.pages + " pages" +
+                           (chatListColumn.statistics.loading ? " (loading " + chatListColumn.statistics.page_size + ")" : "")
+                }
+                DetailItem {
+                    label: "First page"
+                    value: chatListColumn.time(chatListColumn.statistics.first_page)
+                }
+                DetailItem {
+                    label: "First paint"
+                    value: chatListColumn.time(chatListColumn.statistics.first_paint)
+                }
+                DetailItem {
+                    label: "Complete list"
+                    value: chatListColumn.time(chatListColumn.statistics.complete)
+                }
+            }
+
             Row {
                 TextField {
                     id: chatId
@@ -74,11 +104,126 @@ Page {
                     onClicked: tdLibWrapper.joinChat(chatId.text)
                 }
             }
+
+            SectionHeader {
+                text: "Receiver"
+            }
+
+            Column {
+                id: receiverColumn
+                width: parent.width
+
+                // Times are in microseconds
+                property var statistics: tdLibWrapper.getReceiverStatistics()
+                property var types: Object.keys(statistics.types).sort(function(a, b) {
+                    return statistics.types[b].count - statistics.types[a].count;
+                })
+
+                function average(total, count) {
+                    return count > 0 ? Math.round(total / count) : 0;
+                }
+
+                DetailItem {
+                    label: "Wakeups"
+                    value: receiverColumn.statistics.wakeups + " (" + receiverColumn.statistics.idle_wakeups + " idle)"
+                }
+                DetailItem {
+                    label: "Backlog drain time"
+                    value: receiverColumn.statistics.last_drain_time + " ms (max " + receiverColumn.statistics.longest_drain_time + " ms)"
+                }
+                DetailItem {
+                    label: "Batches"
+                    value: receiverColumn.statistics.batches + " / " + receiverColumn.statistics.batched_updates + " updates"
+                }
+                DetailItem {
+                    label: "Batch size"
+                    value: receiverColumn.statistics.last_batch_size + " (max " + receiverColumn.statistics.largest_batch_size + ")"
+                }
+                DetailItem {
+                    label: "Coalesced updates"
+                    value: receiverColumn.statistics.coalesced_updates
+                }
+                DetailItem {
+                    label: "Parallel decodes"
+                    value: receiverColumn.statistics.parallel_decodes + " on " + receiverColumn.statistics.decode_threads + " threads (" + receiverColumn.statistics.reordered + " reordered)"
+                }
+
+                Repeater {
+                    model: receiverColumn.types
+                    delegate: DetailItem {
+                        readonly property var typeStatistics: receiverColumn.statistics.types[modelData]
+                        label: modelData + " ×" + typeStatistics.count
+                        value: "parse " + receiverColumn.average(typeStatistics.parse_time, typeStatistics.count) +
+                               " µs, handler " + receiverColumn.average(typeStatistics.handler_time, typeStatistics.count) +
+                               " µs, queue " + receiverColumn.average(typeStatistics.queue_time, typeStatistics.count) + " µs"
+                    }
+                }
+            }
+
+            Button {
+                anchors.horizontalCenter: parent.horizontalCenter
+                text: "Refresh"
+                onClicked: receiverColumn.statistics = tdLibWrapper.getReceiverStatistics()
+            }
+
+            SectionHeader {
+                text: "Requests"
+            }
+
+            Column {
+                id: queueColumn
+                width: parent.width
+
+                property var statistics: tdLibWrapper.getRequestQueueStatistics()
+
+                Repeater {
+                    model: Object.keys(queueColumn.statistics)
+                    delegate: DetailItem {
+                        readonly property var classStatistics: queueColumn.statistics[modelData]
+                        label: modelData + " (" + classStatistics.in_flight + "/" + classStatistics.limit + " in flight)"
+                        value: classStatistics.waiting + " waiting (max " + classStatistics.largest_backlog + "), " +
+                               classStatistics.sent + " sent, " + classStatistics.deduplicated + " merged"
+                    }
+                }
+            }
+
+            Column {
+                id: requestsColumn
+                width: parent.width
+
+                // Nanoseconds per request
+                property var benchmark: ({})
+
+                Repeater {
+                    model: Object.keys(requestsColumn.benchmark)
+                    delegate: DetailItem {
+                        label: modelData
+                        value: "map " + requestsColumn.benchmark[modelData].variant_map +
+                               " ns, builder " + requestsColumn.benchmark[modelData].builder + " ns"
+                    }
+                }
+            }
+
+            Button {
+                anchors.horizontalCenter: parent.horizontalCenter
+                text: "Benchmark"
+                onClicked: requestsColumn.benchmark = tdLibWrapper.benchmarkRequests(10000)
+            }
         }
 
         VerticalScrollDecorator {}
     }
 
+    Timer {
+        interval: 1000
+        repeat: true
+        running: debugPage.status === PageStatus.Active
+        onTriggered: {
+            queueColumn.statistics = tdLibWrapper.getRequestQueueStatistics();
+            chatListColumn.statistics = tdLibWrapper.getChatListStatistics();
+        }
+    }
+
     Timer {
         id: profileTimer
         interval: 1000
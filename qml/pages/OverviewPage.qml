@@ -37,6 +37,8 @@ Page {
     property int connectionState: TelegramAPI.WaitingForNetwork
     property int ownUserId;
     property bool chatListCreated: false;
+    // Chats from the previous session are shown until the real ones arrive
+    readonly property bool chatListShown: (chatListCreated || chatListModel.count > 0) && !logoutLoading
     property string appName: qsTr("Fernschreiber");
     property string allChat: qsTr("All Chats");
     property string unreadChatsInFolder: qsTr("Unread chats count")
@@ -72,6 +74,12 @@ Page {
         running: false
         repeat: false
         onTriggered: {
+            overviewPage.showChatList();
+        }
+    }
+
+    function showChatList() {
+        if (!overviewPage.chatListCreated) {
             overviewPage.chatListCreated = true;
             chatListView.scrollToTop();
             updateSecondaryContentTimer.start();
@@ -109,9 +117,14 @@ Page {
         }
     }
 
+    ChatsFolderFilterProxy {
+        id: chatFolderProxyModel
+        sourceModel: chatListModel
+    }
+
     TextFilterModel {
         id: chatListProxyModel
-        sourceModel: (chatSearchField.activeFocus) ? chatListModel : null
+        sourceModel: (chatSearchField.activeFocus) ? chatFolderProxyModel : null
         filterRoleName: "filter"
         filterText: chatSearchField.text
     }
@@ -191,7 +204,8 @@ Page {
     }
 
     function updateContent() {
-        tdLibWrapper.getChats();
+        // Enough chats to fill the screen come first, the rest follows in bigger pages
+        tdLibWrapper.getChats(Math.ceil(Math.max(overviewPage.width, overviewPage.height) / Theme.itemSizeExtraLarge) + 1);
     }
 
     function initializePage() {
@@ -278,6 +292,16 @@ Page {
                 chatListModel.calculateUnreadState();
             }
         }
+        onChatListPageLoaded: {
+            // No need to wait for the rest of the list
+            chatListCreatedTimer.stop();
+            overviewPage.showChatList();
+        }
+        onChatListLoaded: {
+            if (!overviewPage.chatListCreated) {
+                chatListCreatedTimer.restart();
+            }
+        }
         onChatsReceived: {
             if(chats && chats.chat_ids && chats.chat_ids.length === 0) {
                 chatListCreatedTimer.restart();
@@ -327,7 +351,7 @@ Page {
         contentHeight: parent.height
         contentWidth: parent.width
         anchors.fill: parent
-        visible: !overviewPage.loading
+        visible: !overviewPage.loading || overviewPage.chatListShown
 
         AppBar {
             id: topAppBar
@@ -419,13 +443,24 @@ Page {
                 right: parent.right
             }
             clip: true
-            opacity: (overviewPage.chatListCreated && !overviewPage.logoutLoading) ? 1 : 0
+            opacity: overviewPage.chatListShown ? 1 : 0
             Behavior on opacity { FadeAnimation {} }
-            model: chatListProxyModel.sourceModel ? chatListProxyModel : chatListModel
+            model: chatListProxyModel.sourceModel ? chatListProxyModel : chatFolderProxyModel
             delegate: ChatListViewItem {
                 ownUserId: overviewPage.ownUserId
                 isVerified: is_verified
+                // Lets the model refresh relative timestamps of the visible delegates only
+                property var inViewChatId
+                Component.onCompleted: {
+                    inViewChatId = chat_id;
+                    chatListModel.setChatInView(inViewChatId, true);
+                }
+                Component.onDestruction: chatListModel.setChatInView(inViewChatId, false)
                 onClicked: {
+                    // Restored from the previous session, not known to TDLib yet
+                    if (is_placeholder) {
+                        return;
+                    }
                     pageStack.push(Qt.resolvedUrl("../pages/ChatPage.qml"), {
                         chatInformation : display,
                         chatPicture: photo_small
@@ -447,9 +482,9 @@ Page {
             spacing: Theme.paddingMedium
             anchors.verticalCenter: chatListView.verticalCenter
 
-            opacity: overviewPage.chatListCreated && !overviewPage.logoutLoading ? 0 : 1
+            opacity: overviewPage.chatListShown ? 0 : 1
             Behavior on opacity { FadeAnimation {} }
-            visible: !overviewPage.chatListCreated || overviewPage.logoutLoading
+            visible: !overviewPage.chatListShown
 
             BusyLabel {
                     id: loadingBusyIndicator
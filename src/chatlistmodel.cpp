@@ -18,8 +18,14 @@
 */
 
 #include "chatlistmodel.h"
+#include "chatlistsnapshot.h"
 #include "fernschreiberutils.h"
+#include <QCoreApplication>
+#include <QDateTime>
 #include <QListIterator>
+#include <QSet>
+#include <QStandardPaths>
+#include <algorithm>
 
 #define DEBUG_MODULE ChatListModel
 #include "debuglog.h"
@@ -29,7 +35,6 @@ namespace {
     const QString DATE("date");
     const QString TEXT("text");
     const QString TYPE("type");
-    const QString TITLE("title");
     const QString PHOTO("photo");
     const QString SMALL("small");
     const QString ORDER("order");
@@ -45,29 +50,77 @@ namespace {
     const QString UNREAD_MENTION_COUNT("unread_mention_count");
     const QString UNREAD_REACTION_COUNT("unread_reaction_count");
     const QString AVAILABLE_REACTIONS("available_reactions");
-    const QString NOTIFICATION_SETTINGS("notification_settings");
     const QString LAST_READ_INBOX_MESSAGE_ID("last_read_inbox_message_id");
     const QString LAST_READ_OUTBOX_MESSAGE_ID("last_read_outbox_message_id");
     const QString SENDING_STATE("sending_state");
-    const QString IS_CHANNEL("is_channel");
-    const QString IS_VERIFIED("is_verified");
     const QString IS_MARKED_AS_UNREAD("is_marked_as_unread");
     const QString IS_PINNED("is_pinned");
-    const QString PINNED_MESSAGE_ID("pinned_message_id");
+    const QString POSITIONS("positions");
     const QString _TYPE("@type");
     const QString SECRET_CHAT_ID("secret_chat_id");
+    const QString LOCAL("local");
+    const QString PATH("path");
+    const QString IS_DOWNLOADING_COMPLETED("is_downloading_completed");
     const QString CHAT_FOLDERS("chat_folders");
     const QString MAIN_CHAT_LIST_POSITION_IN_FOLDERS("main_chat_list_position");
+    const QString TITLE("title");
+    const QString NOTIFICATION_SETTINGS("notification_settings");
+    const QString MUTE_FOR("mute_for");
+    const QString PINNED_CHAT_IDS("pinned_chat_ids");
+    const QString INCLUDED_CHAT_IDS("included_chat_ids");
+    const QString EXCLUDED_CHAT_IDS("excluded_chat_ids");
+    const QString EXCLUDE_MUTED("exclude_muted");
+    const QString EXCLUDE_READ("exclude_read");
+    const QString INCLUDE_CONTACTS("include_contacts");
+    const QString INCLUDE_NON_CONTACTS("include_non_contacts");
+    const QString INCLUDE_BOTS("include_bots");
+    const QString INCLUDE_GROUPS("include_groups");
+    const QString INCLUDE_CHANNELS("include_channels");
+
+    // One bit per folder in ChatData::folders
+    const int MAX_CHAT_FOLDERS = 64;
+
+    // Newly discovered chats are collected for this long and then inserted together
+    const int PENDING_CHATS_DELAY = 20; // ms
+
+    // The top of the list which is shown right away on the next start
+    const QString SNAPSHOT_FILE("chatlist.snapshot");
+    const int SNAPSHOT_CHAT_COUNT = 50;
+
+    const ChatStore::Fields ALL_FIELDS(QFlag(~0));
+}
+
+// Silica's DurationElapsed format counts minutes during the first hour,
+// then hours during the first day, then days
+static qint64 relativeTimeBucket(qint64 age)
+{
+    return (age < 3600) ? (age / 60) : (age < 86400) ? (60 + age / 3600) : (84 + age / 86400);
+}
+
+// Seconds until the relative time label changes
+static qint64 relativeTimeChangesIn(qint64 age)
+{
+    return (age < 0) ? (-age + 1) :
+        (age < 3600) ? (60 - age % 60) :
+        (age < 86400) ? (3600 - age % 3600) :
+        (86400 - age % 86400);
+}
+
+static qint64 currentTime()
+{
+    return QDateTime::currentMSecsSinceEpoch() / 1000;
 }
 
 class ChatListModel::ChatData
 {
 public:
 
-    ChatData(TDLibWrapper *tdLibWrapper, const QVariantMap &data);
+    ChatData(TDLibWrapper *tdLibWrapper, const ChatStore::ChatRef &record);
 
     int compareTo(const ChatData *chat) const;
+    static bool lessThan(const ChatData *chat1, const ChatData *chat2);
     bool setOrder(const QString &order);
+    bool setOrder(qlonglong order);
     const QVariant lastMessage(const QString &key) const;
     QString title() const;
     int unreadCount() const;
@@ -84,20 +137,22 @@ public:
     QString senderMessageStatus() const;
     qlonglong draftMessageDate() const;
     QString draftMessageText() const;
+    qlonglong displayedDate() const;
     bool isChannel() const;
     bool isHidden() const;
     bool isMarkedAsUnread() const;
     bool isPinned() const;
-    bool updateUnreadCount(int unreadCount);
-    bool updateLastReadInboxMessageId(qlonglong messageId);
-    QVector<int> updateLastMessage(const QVariantMap &message);
+    bool isMuted() const;
+    bool isRead() const;
+    int folderKind() const;
     QVector<int> updateGroup(const TDLibWrapper::Group *group);
     QVector<int> updateSecretChat(const QVariantMap &secretChatDetails);
-    ChatData* clone();
+    void refresh(ChatStore::Fields fields);
     TDLibWrapper *tdLibWrapper;
 
 public:
-    QVariantMap chatData;
+    // Shared with TDLibWrapper, kept up to date by the ChatStore
+    ChatStore::ChatRef record;
     qlonglong chatId;
     qlonglong order;
     qlonglong groupId;
@@ -105,21 +160,85 @@ public:
     TDLibWrapper::ChatType chatType;
     TDLibWrapper::ChatMemberStatus memberStatus;
     TDLibWrapper::SecretChatState secretChatState;
+    // Restored from the snapshot, waiting for TDLib to tell the truth
+    bool placeholder;
+    QString placeholderText;
+    qlonglong placeholderDate;
+    // Bit N is set if the chat belongs to the folder N
+    quint64 folders;
+    // Chat list id => order, for the lists other than the main one
+    QHash<qlonglong,qlonglong> listOrders;
+
+    // What data() returns, refreshed only when the record changes
+    struct Roles {
+        QString title;
+        QVariant photoSmall;
+        int unreadCount;
+        int unreadMentionCount;
+        int unreadReactionCount;
+        QVariant availableReactions;
+        qlonglong lastReadInboxMessageId;
+        qlonglong senderUserId;
+        qlonglong senderMessageDate;
+        QString senderMessageText;
+        QString senderMessageStatus;
+        QString filter;
+        QString draftMessageText;
+        qlonglong draftMessageDate;
+        bool isChannel;
+        bool isMarkedAsUnread;
+        bool isPinned;
+    } roles;
 
 };
 
-ChatListModel::ChatData::ChatData(TDLibWrapper *tdLibWrapper, const QVariantMap &data) :
+// A chat folder compiled from its TDLib definition
+class ChatListModel::ChatFolder
+{
+public:
+    enum Kind {
+        KindContact = 0x01,
+        KindNonContact = 0x02,
+        KindBot = 0x04,
+        KindGroup = 0x08,
+        KindChannel = 0x10
+    };
+
+    ChatFolder(int kinds);
+    ChatFolder(qlonglong id, const QVariantMap &chatFolder);
+
+    bool contains(const ChatData *chat) const;
+
+public:
+    const qlonglong chatListId; // Zero for the built-in ones
+
+private:
+    static QSet<qlonglong> chatIds(const QVariant &list);
+
+private:
+    QSet<qlonglong> includedChats; // Pinned ones included
+    QSet<qlonglong> excludedChats;
+    int includedKinds;
+    bool excludeMuted;
+    bool excludeRead;
+};
+
+ChatListModel::ChatData::ChatData(TDLibWrapper *tdLibWrapper, const ChatStore::ChatRef &record) :
     tdLibWrapper(tdLibWrapper),
-    chatData(data),
-    chatId(data.value(ID).toLongLong()),
-    order(data.value(ORDER).toLongLong()),
+    record(record),
+    chatId(record->id),
+    order(record->data.value(ORDER).toLongLong()),
     groupId(0),
     verified(false),
+    chatType((TDLibWrapper::ChatType)record->chatType),
     memberStatus(TDLibWrapper::ChatMemberStatusUnknown),
-    secretChatState(TDLibWrapper::SecretChatStateUnknown)
+    secretChatState(TDLibWrapper::SecretChatStateUnknown),
+    placeholder(false),
+    placeholderDate(0),
+    folders(0)
 {
-    const QVariantMap type(data.value(TYPE).toMap());
-    switch (chatType = TDLibWrapper::chatTypeFromString(type.value(_TYPE).toString())) {
+    const QVariantMap type(record->data.value(TYPE).toMap());
+    switch (chatType) {
     case TDLibWrapper::ChatTypeBasicGroup:
         groupId = type.value(BASIC_GROUP_ID).toLongLong();
         break;
@@ -131,66 +250,89 @@ ChatListModel::ChatData::ChatData(TDLibWrapper *tdLibWrapper, const QVariantMap
     case TDLibWrapper::ChatTypeSecret:
         break;
     }
+    const QVariantList positions(record->data.value(POSITIONS).toList());
+    for (const QVariant &position : positions) {
+        const ChatPositionUpdate listPosition(chatId, position.toMap());
+        if (listPosition.chatListId != ChatPositionUpdate::ChatListMain && listPosition.order) {
+            listOrders.insert(listPosition.chatListId, listPosition.order);
+        }
+    }
+    roles.isChannel = isChannel();
+    refresh(ALL_FIELDS);
 }
 
 int ChatListModel::ChatData::compareTo(const ChatData *other) const
 {
     if (order == other->order) {
-        return (chatId < other->chatId) ? 1 : -1;
+        return (chatId < other->chatId) ? 1 : (chatId > other->chatId) ? -1 : 0;
     } else {
         // This puts most recent ones to the top of the list
         return (order < other->order) ? 1 : -1;
     }
 }
 
+bool ChatListModel::ChatData::lessThan(const ChatData *chat1, const ChatData *chat2)
+{
+    return chat1->compareTo(chat2) < 0;
+}
+
 bool ChatListModel::ChatData::setOrder(const QString &newOrder)
 {
     if (!newOrder.isEmpty()) {
-        chatData.insert(ORDER, newOrder);
         order = newOrder.toLongLong();
         return true;
     }
     return false;
 }
 
+bool ChatListModel::ChatData::setOrder(qlonglong newOrder)
+{
+    // Negative means that the update didn't have the order
+    if (newOrder >= 0) {
+        order = newOrder;
+        return true;
+    }
+    return false;
+}
+
 inline const QVariant ChatListModel::ChatData::lastMessage(const QString &key) const
 {
-    return chatData.value(LAST_MESSAGE).toMap().value(key);
+    return record->data.value(LAST_MESSAGE).toMap().value(key);
 }
 
 QString ChatListModel::ChatData::title() const
 {
-    return chatData.value(TITLE).toString();
+    return record->title();
 }
 
 int ChatListModel::ChatData::unreadCount() const
 {
-    return chatData.value(UNREAD_COUNT).toInt();
+    return record->data.value(UNREAD_COUNT).toInt();
 }
 
 int ChatListModel::ChatData::unreadMentionCount() const
 {
-    return chatData.value(UNREAD_MENTION_COUNT).toInt();
+    return record->data.value(UNREAD_MENTION_COUNT).toInt();
 }
 
 QVariant ChatListModel::ChatData::availableReactions() const
 {
-    return chatData.value(AVAILABLE_REACTIONS);
+    return record->data.value(AVAILABLE_REACTIONS);
 }
 
 int ChatListModel::ChatData::unreadReactionCount() const
 {
-    return chatData.value(UNREAD_REACTION_COUNT).toInt();
+    return record->data.value(UNREAD_REACTION_COUNT).toInt();
 }
 
 QVariant ChatListModel::ChatData::photoSmall() const
 {
-    return chatData.value(PHOTO).toMap().value(SMALL);
+    return record->data.value(PHOTO).toMap().value(SMALL);
 }
 
 qlonglong ChatListModel::ChatData::lastReadInboxMessageId() const
 {
-    return chatData.value(LAST_READ_INBOX_MESSAGE_ID).toLongLong();
+    return record->data.value(LAST_READ_INBOX_MESSAGE_ID).toLongLong();
 }
 
 qlonglong ChatListModel::ChatData::senderUserId() const
@@ -210,11 +352,14 @@ bool ChatListModel::ChatData::senderIsChat() const
 
 qlonglong ChatListModel::ChatData::senderMessageDate() const
 {
-    return lastMessage(DATE).toLongLong();
+    return placeholder ? placeholderDate : lastMessage(DATE).toLongLong();
 }
 
 QString ChatListModel::ChatData::senderMessageText() const
 {
+    if (placeholder) {
+        return placeholderText;
+    }
     qlonglong myUserId = tdLibWrapper->getUserInformation().value(ID).toLongLong();
     return FernschreiberUtils::getMessageShortText(tdLibWrapper, lastMessage(CONTENT).toMap(), isChannel(), myUserId, lastMessage(SENDER_ID).toMap() );
 }
@@ -223,13 +368,13 @@ QString ChatListModel::ChatData::senderMessageText() const
 QString ChatListModel::ChatData::senderMessageStatus() const
 {
     qlonglong myUserId = tdLibWrapper->getUserInformation().value(ID).toLongLong();
-    if (isChannel() || myUserId != senderUserId() || myUserId == chatId) {
+    if (placeholder || isChannel() || myUserId != senderUserId() || myUserId == chatId) {
         return "";
     }
-    if (lastMessage(ID) == chatData.value(LAST_READ_OUTBOX_MESSAGE_ID)) {
+    if (lastMessage(ID) == record->data.value(LAST_READ_OUTBOX_MESSAGE_ID)) {
         return "&nbsp;&nbsp;✅";
     } else {
-        QVariantMap lastMessage = chatData.value(LAST_MESSAGE).toMap();
+        QVariantMap lastMessage = record->data.value(LAST_MESSAGE).toMap();
         if (lastMessage.contains(SENDING_STATE)) {
             QVariantMap sendingState = lastMessage.value(SENDING_STATE).toMap();
             if (sendingState.value(_TYPE).toString() == "messageSendingStatePending") {
@@ -244,7 +389,7 @@ QString ChatListModel::ChatData::senderMessageStatus() const
 }
 qlonglong ChatListModel::ChatData::draftMessageDate() const
 {
-    QVariantMap draft = chatData.value(DRAFT_MESSAGE).toMap();
+    QVariantMap draft = record->data.value(DRAFT_MESSAGE).toMap();
     if(draft.isEmpty()) {
         return qlonglong(0);
     }
@@ -253,20 +398,31 @@ qlonglong ChatListModel::ChatData::draftMessageDate() const
 
 QString ChatListModel::ChatData::draftMessageText() const
 {
-    QVariantMap draft = chatData.value(DRAFT_MESSAGE).toMap();
+    QVariantMap draft = record->data.value(DRAFT_MESSAGE).toMap();
     if(draft.isEmpty()) {
         return QString();
     }
     return draft.value("input_message_text").toMap().value(TEXT).toMap().value(TEXT).toString();
 }
 
+qlonglong ChatListModel::ChatData::displayedDate() const
+{
+    // Same choice as ChatListViewItem makes, newer drafts win
+    return (!roles.draftMessageText.isEmpty() && roles.draftMessageDate > roles.senderMessageDate) ?
+        roles.draftMessageDate : roles.senderMessageDate;
+}
+
 bool ChatListModel::ChatData::isChannel() const
 {
-    return chatData.value(TYPE).toMap().value(IS_CHANNEL).toBool();
+    return record->isChannel();
 }
 
 bool ChatListModel::ChatData::isHidden() const
 {
+    if (placeholder) {
+        // Only TDLib can hide it
+        return false;
+    }
     // Cover all enum values so that compiler warns us when/if enum gets extended
     switch (chatType) {
     case TDLibWrapper::ChatTypeBasicGroup:
@@ -280,7 +436,7 @@ bool ChatListModel::ChatData::isHidden() const
         case TDLibWrapper::ChatMemberStatusAdministrator:
         case TDLibWrapper::ChatMemberStatusMember:
         case TDLibWrapper::ChatMemberStatusRestricted:
-            if (chatData.value(LAST_MESSAGE).isNull()) {
+            if (record->data.value(LAST_MESSAGE).isNull()) {
                 return true;
             }
             break;
@@ -289,7 +445,7 @@ bool ChatListModel::ChatData::isHidden() const
     case TDLibWrapper::ChatTypeUnknown:
         return true;
     case TDLibWrapper::ChatTypePrivate:
-        if (chatData.value(LAST_MESSAGE).isNull()) {
+        if (record->data.value(LAST_MESSAGE).isNull()) {
             return true;
         }
         break;
@@ -304,54 +460,35 @@ bool ChatListModel::ChatData::isHidden() const
 
 bool ChatListModel::ChatData::isMarkedAsUnread() const
 {
-    return chatData.value(IS_MARKED_AS_UNREAD).toBool();
+    return record->data.value(IS_MARKED_AS_UNREAD).toBool();
 }
 
 bool ChatListModel::ChatData::isPinned() const
 {
-    return chatData.value(IS_PINNED).toBool();
+    return record->data.value(IS_PINNED).toBool();
 }
 
-bool ChatListModel::ChatData::updateUnreadCount(int count)
+bool ChatListModel::ChatData::isMuted() const
 {
-    const int prevUnreadCount(unreadCount());
-    chatData.insert(UNREAD_COUNT, count);
-    return prevUnreadCount != unreadCount();
+    return record->data.value(NOTIFICATION_SETTINGS).toMap().value(MUTE_FOR).toInt() > 0;
 }
 
-bool ChatListModel::ChatData::updateLastReadInboxMessageId(qlonglong messageId)
+bool ChatListModel::ChatData::isRead() const
 {
-    const qlonglong prevLastReadInboxMessageId(lastReadInboxMessageId());
-    chatData.insert(LAST_READ_INBOX_MESSAGE_ID, messageId);
-    return prevLastReadInboxMessageId != lastReadInboxMessageId();
+    return !unreadCount() && !isMarkedAsUnread();
 }
 
-QVector<int> ChatListModel::ChatData::updateLastMessage(const QVariantMap &message)
+int ChatListModel::ChatData::folderKind() const
 {
-    const qlonglong prevSenderUserId(senderUserId());
-    const qlonglong prevSenderMessageDate(senderMessageDate());
-    const QString prevSenderMessageText(senderMessageText());
-    const QString prevSenderMessageStatus(senderMessageStatus());
-
-
-    chatData.insert(LAST_MESSAGE, message);
-
-    QVector<int> changedRoles;
-    changedRoles.append(RoleDisplay);
-    if (prevSenderUserId != senderUserId()) {
-        changedRoles.append(RoleLastMessageSenderId);
-    }
-    if (prevSenderMessageDate != senderMessageDate()) {
-        changedRoles.append(RoleLastMessageDate);
+    if (chatType == TDLibWrapper::ChatTypePrivate || chatType == TDLibWrapper::ChatTypeSecret) {
+        const UserStore::User *user = tdLibWrapper->getUser(record->data.value(TYPE).toMap().value(USER_ID).toLongLong());
+        return (user && user->isBot) ? ChatFolder::KindBot :
+            (user && user->isContact) ? ChatFolder::KindContact :
+            ChatFolder::KindNonContact;
+    } else if (chatType == TDLibWrapper::ChatTypeBasicGroup || chatType == TDLibWrapper::ChatTypeSupergroup) {
+        return roles.isChannel ? ChatFolder::KindChannel : ChatFolder::KindGroup;
     }
-    if (prevSenderMessageText != senderMessageText()) {
-        changedRoles.append(RoleFilter);
-        changedRoles.append(RoleLastMessageText);
-    }
-    if (prevSenderMessageStatus != senderMessageStatus()) {
-        changedRoles.append(RoleLastMessageStatus);
-    }
-    return changedRoles;
+    return 0;
 }
 
 QVector<int> ChatListModel::ChatData::updateGroup(const TDLibWrapper::Group *group)
@@ -359,16 +496,14 @@ QVector<int> ChatListModel::ChatData::updateGroup(const TDLibWrapper::Group *gro
     QVector<int> changedRoles;
 
     if (group && groupId == group->groupId) {
-        const TDLibWrapper::ChatMemberStatus groupMemberStatus = group->chatMemberStatus();
-        if (memberStatus != groupMemberStatus) {
-            memberStatus = groupMemberStatus;
+        if (memberStatus != group->memberStatus) {
+            memberStatus = group->memberStatus;
             changedRoles.append(RoleChatMemberStatus);
         }
         // There's no "is_verified" in "basic_group" but that's ok since
         // it naturally becomes false
-        const bool groupIsVerified = group->groupInfo.value(IS_VERIFIED).toBool();
-        if (verified != groupIsVerified) {
-            verified = groupIsVerified;
+        if (verified != group->verified) {
+            verified = group->verified;
             changedRoles.append(RoleIsVerified);
         }
     }
@@ -387,61 +522,143 @@ QVector<int> ChatListModel::ChatData::updateSecretChat(const QVariantMap &secret
     return changedRoles;
 }
 
-ChatListModel::ChatData* ChatListModel::ChatData::clone() {
-    QVariantMap clonedChatData;
+void ChatListModel::ChatData::refresh(ChatStore::Fields fields)
+{
+    if (fields & ChatStore::FieldTitle) {
+        roles.title = title();
+    }
+    if (fields & ChatStore::FieldPhoto) {
+        roles.photoSmall = photoSmall();
+    }
+    if (fields & ChatStore::FieldUnreadCount) {
+        roles.unreadCount = unreadCount();
+    }
+    if (fields & ChatStore::FieldUnreadMentionCount) {
+        roles.unreadMentionCount = unreadMentionCount();
+    }
+    if (fields & ChatStore::FieldUnreadReactionCount) {
+        roles.unreadReactionCount = unreadReactionCount();
+    }
+    if (fields & ChatStore::FieldAvailableReactions) {
+        roles.availableReactions = availableReactions();
+    }
+    if (fields & ChatStore::FieldLastReadInboxMessageId) {
+        roles.lastReadInboxMessageId = lastReadInboxMessageId();
+    }
+    if (fields & ChatStore::FieldLastMessage) {
+        roles.senderUserId = senderUserId();
+        roles.senderMessageDate = senderMessageDate();
+        roles.senderMessageText = senderMessageText();
+    }
+    if (fields & (ChatStore::FieldLastMessage | ChatStore::FieldLastReadOutboxMessageId)) {
+        roles.senderMessageStatus = senderMessageStatus();
+    }
+    if (fields & (ChatStore::FieldTitle | ChatStore::FieldLastMessage)) {
+        roles.filter = roles.title + " " + roles.senderMessageText;
+    }
+    if (fields & ChatStore::FieldDraftMessage) {
+        roles.draftMessageText = draftMessageText();
+        roles.draftMessageDate = draftMessageDate();
+    }
+    if (fields & ChatStore::FieldIsMarkedAsUnread) {
+        roles.isMarkedAsUnread = isMarkedAsUnread();
+    }
+    if (fields & ChatStore::FieldIsPinned) {
+        roles.isPinned = isPinned();
+    }
+}
+
+ChatListModel::ChatFolder::ChatFolder(int kinds) :
+    chatListId(0),
+    includedKinds(kinds),
+    excludeMuted(false),
+    excludeRead(false)
+{
+}
+
+ChatListModel::ChatFolder::ChatFolder(qlonglong id, const QVariantMap &chatFolder) :
+    chatListId(id),
+    includedChats(chatIds(chatFolder.value(INCLUDED_CHAT_IDS)).unite(chatIds(chatFolder.value(PINNED_CHAT_IDS)))),
+    excludedChats(chatIds(chatFolder.value(EXCLUDED_CHAT_IDS))),
+    includedKinds((chatFolder.value(INCLUDE_CONTACTS).toBool() ? KindContact : 0) |
+        (chatFolder.value(INCLUDE_NON_CONTACTS).toBool() ? KindNonContact : 0) |
+        (chatFolder.value(INCLUDE_BOTS).toBool() ? KindBot : 0) |
+        (chatFolder.value(INCLUDE_GROUPS).toBool() ? KindGroup : 0) |
+        (chatFolder.value(INCLUDE_CHANNELS).toBool() ? KindChannel : 0)),
+    excludeMuted(chatFolder.value(EXCLUDE_MUTED).toBool()),
+    excludeRead(chatFolder.value(EXCLUDE_READ).toBool())
+{
+}
+
+QSet<qlonglong> ChatListModel::ChatFolder::chatIds(const QVariant &list)
+{
+    QSet<qlonglong> ids;
+    const QVariantList chatIdList(list.toList());
+    for (const QVariant &chatId : chatIdList) {
+        ids.insert(chatId.toLongLong());
+    }
+    return ids;
+}
 
-    QList<QString> keys = chatData.keys();
-    for(int i = 0; i < keys.count(); i++) {
-        clonedChatData.insert(keys[i], QVariant(chatData[keys[i]]));
+bool ChatListModel::ChatFolder::contains(const ChatData *chat) const
+{
+    // Having a position in the folder's chat list settles it, otherwise
+    // same rules as TDLib, explicitly listed chats go first
+    if (chatListId && chat->listOrders.contains(chatListId)) {
+        return true;
+    } else if (excludedChats.contains(chat->chatId)) {
+        return false;
+    } else if (includedChats.contains(chat->chatId)) {
+        return true;
+    } else {
+        return (includedKinds & chat->folderKind()) &&
+            !(excludeMuted && chat->isMuted()) &&
+            !(excludeRead && chat->isRead());
     }
-    ChatData* res = new ChatData(tdLibWrapper, clonedChatData);
-    res->chatId = chatId;
-    res->order = order;
-    res->groupId = groupId;
-    res->verified = verified;
-    res->chatType = chatType;
-    res->memberStatus = memberStatus;
-    res->secretChatState = secretChatState;
-    return res;
 }
 
-ChatListModel::ChatListModel(TDLibWrapper *tdLibWrapper, AppSettings *appSettings) :
+ChatListModel::ChatListModel(TDLibWrapper *tdLibWrapper, AppSettings *appSettings, bool warmStart) :
+    selectedFolderIndex(0),
     showHiddenChats(false),
     selectedFolder("All Chats")
 {
     this->tdLibWrapper = tdLibWrapper;
     this->appSettings = appSettings;
+    connect(tdLibWrapper->getChatStore(), SIGNAL(chatChanged(qlonglong, ChatStore::Fields)), this, SLOT(handleChatChanged(qlonglong, ChatStore::Fields)));
     connect(tdLibWrapper, SIGNAL(newChatDiscovered(QString, QVariantMap)), this, SLOT(handleChatDiscovered(QString, QVariantMap)));
-    connect(tdLibWrapper, SIGNAL(chatLastMessageUpdated(QString, QString, QVariantMap)), this, SLOT(handleChatLastMessageUpdated(QString, QString, QVariantMap)));
+    connect(tdLibWrapper, SIGNAL(chatLastMessageUpdate(ChatLastMessageUpdate)), this, SLOT(handleChatLastMessageUpdated(ChatLastMessageUpdate)));
     connect(tdLibWrapper, SIGNAL(chatOrderUpdated(QString, QString)), this, SLOT(handleChatOrderUpdated(QString, QString)));
-    connect(tdLibWrapper, SIGNAL(chatReadInboxUpdated(QString, QString, int)), this, SLOT(handleChatReadInboxUpdated(QString, QString, int)));
-    connect(tdLibWrapper, SIGNAL(chatReadOutboxUpdated(QString, QString)), this, SLOT(handleChatReadOutboxUpdated(QString, QString)));
-    connect(tdLibWrapper, SIGNAL(chatPhotoUpdated(qlonglong, QVariantMap)), this, SLOT(handleChatPhotoUpdated(qlonglong, QVariantMap)));
-    connect(tdLibWrapper, SIGNAL(chatPinnedMessageUpdated(qlonglong, qlonglong)), this, SLOT(handleChatPinnedMessageUpdated(qlonglong, qlonglong)));
-    connect(tdLibWrapper, SIGNAL(messageSendSucceeded(qlonglong, qlonglong, QVariantMap)), this, SLOT(handleMessageSendSucceeded(qlonglong, qlonglong, QVariantMap)));
-    connect(tdLibWrapper, SIGNAL(chatNotificationSettingsUpdated(QString, QVariantMap)), this, SLOT(handleChatNotificationSettingsUpdated(QString, QVariantMap)));
+    connect(tdLibWrapper, SIGNAL(chatPositionUpdate(ChatPositionUpdate)), this, SLOT(handleChatPositionUpdated(ChatPositionUpdate)));
     connect(tdLibWrapper, SIGNAL(superGroupUpdated(qlonglong)), this, SLOT(handleGroupUpdated(qlonglong)));
     connect(tdLibWrapper, SIGNAL(basicGroupUpdated(qlonglong)), this, SLOT(handleGroupUpdated(qlonglong)));
     connect(tdLibWrapper, SIGNAL(secretChatUpdated(qlonglong, QVariantMap)), this, SLOT(handleSecretChatUpdated(qlonglong, QVariantMap)));
     connect(tdLibWrapper, SIGNAL(secretChatReceived(qlonglong, QVariantMap)), this, SLOT(handleSecretChatUpdated(qlonglong, QVariantMap)));
-    connect(tdLibWrapper, SIGNAL(chatTitleUpdated(QString, QString)), this, SLOT(handleChatTitleUpdated(QString, QString)));
-    connect(tdLibWrapper, SIGNAL(chatIsMarkedAsUnreadUpdated(qlonglong, bool)), this, SLOT(handleChatIsMarkedAsUnreadUpdated(qlonglong, bool)));
-    connect(tdLibWrapper, SIGNAL(chatPinnedUpdated(qlonglong, bool)), this, SLOT(handleChatPinnedUpdated(qlonglong, bool)));
     connect(tdLibWrapper, SIGNAL(chatDraftMessageUpdated(qlonglong, QVariantMap, QString)), this, SLOT(handleChatDraftMessageUpdated(qlonglong, QVariantMap, QString)));
-    connect(tdLibWrapper, SIGNAL(chatUnreadMentionCountUpdated(qlonglong, int)), this, SLOT(handleChatUnreadMentionCountUpdated(qlonglong, int)));
-    connect(tdLibWrapper, SIGNAL(chatUnreadReactionCountUpdated(qlonglong, int)), this, SLOT(handleChatUnreadReactionCountUpdated(qlonglong, int)));
-    connect(tdLibWrapper, SIGNAL(chatAvailableReactionsUpdated(qlonglong,QVariantMap)), this, SLOT(handleChatAvailableReactionsUpdated(qlonglong,QVariantMap)));
     connect(tdLibWrapper, SIGNAL(chatFolders(QVariantList, qlonglong)), this, SLOT(handleChatFolders(QVariantList, qlonglong)));
     connect(tdLibWrapper, SIGNAL(chatFolder(QVariantMap)), this, SLOT(handleChatFolderInformation(QVariantMap)));
+    connect(tdLibWrapper, SIGNAL(chatListLoaded()), this, SLOT(removePlaceholders()));
+    // A failed page, e.g. a timeout, won't be followed by chatListLoaded
+    connect(tdLibWrapper, SIGNAL(chatListLoadFailed()), this, SLOT(removePlaceholders()));
+    connect(tdLibWrapper, SIGNAL(ownUserIdFound(QString)), this, SLOT(handleOwnUserIdFound()));
 
-    // Don't start the timer until we have at least one chat
+    // Armed for the next change of a timestamp which is in view
     relativeTimeRefreshTimer = new QTimer(this);
-    relativeTimeRefreshTimer->setSingleShot(false);
-    relativeTimeRefreshTimer->setInterval(30000);
+    relativeTimeRefreshTimer->setSingleShot(true);
+    relativeTimeRefreshed = currentTime();
     connect(relativeTimeRefreshTimer, SIGNAL(timeout()), SLOT(handleRelativeTimeRefreshTimer()));
+    pendingChatsTimer = new QTimer(this);
+    pendingChatsTimer->setSingleShot(true);
+    pendingChatsTimer->setInterval(PENDING_CHATS_DELAY);
+    connect(pendingChatsTimer, SIGNAL(timeout()), SLOT(addPendingChats()));
     connect(this, SIGNAL(rowsInserted(QModelIndex,int,int)), SIGNAL(countChanged()));
     connect(this, SIGNAL(rowsRemoved(QModelIndex,int,int)), SIGNAL(countChanged()));
     connect(this, SIGNAL(modelReset()), SIGNAL(countChanged()));
+
+    if (warmStart) {
+        snapshotFile = QStandardPaths::writableLocation(QStandardPaths::CacheLocation) + "/" + SNAPSHOT_FILE;
+        loadSnapshot();
+        connect(qApp, SIGNAL(aboutToQuit()), SLOT(saveSnapshot()));
+    }
 }
 
 ChatListModel::~ChatListModel()
@@ -449,21 +666,29 @@ ChatListModel::~ChatListModel()
     LOG("Destroying myself...");
     qDeleteAll(chatList);
     qDeleteAll(hiddenChats.values());
-}
-
-ChatListModel* ChatListModel::clone() {
-    ChatListModel* res = new ChatListModel(tdLibWrapper, appSettings);
-    res->relativeTimeRefreshTimer->stop();
-    for(int i = 0; i < chatList.count(); i++) {
-        res->chatList.append(chatList.at(i)->clone());
-    }
-    return res;
+    qDeleteAll(pendingChats.values());
+    qDeleteAll(folders);
 }
 
 void ChatListModel::reset()
 {
+    if (!snapshotFile.isEmpty()) {
+        ChatListSnapshot(snapshotFile).remove();
+    }
+    pendingChatsTimer->stop();
+    beginResetModel();
+    // Visible chats are all in the chat list
+    qDeleteAll(chatList);
+    qDeleteAll(hiddenChats.values());
+    qDeleteAll(pendingChats.values());
     chatList.clear();
+    visibleChats.clear();
     hiddenChats.clear();
+    pendingChats.clear();
+    groupChats.clear();
+    endResetModel();
+    chatsInView.clear();
+    relativeTimeRefreshTimer->stop();
 }
 
 QHash<int,QByteArray> ChatListModel::roleNames() const
@@ -495,6 +720,7 @@ QHash<int,QByteArray> ChatListModel::roleNames() const
     roles.insert(ChatListModel::RoleDraftMessageText, "draft_message_text");
     roles.insert(ChatListModel::RoleChatFoldersList, "chat_folder");
     roles.insert(ChatListModel::RoleMainChatPositionId, "main_chats_folder_position");
+    roles.insert(ChatListModel::RoleIsPlaceholder, "is_placeholder");
     return roles;
 }
 
@@ -509,32 +735,33 @@ QVariant ChatListModel::data(const QModelIndex &index, int role) const
     if (row >= 0 && row < chatList.size()) {
         const ChatData *data = chatList.at(row);
         switch ((ChatListModel::Role)role) {
-        case ChatListModel::RoleDisplay: return data->chatData;
+        case ChatListModel::RoleDisplay: return data->record->data;
         case ChatListModel::RoleChatId: return data->chatId;
         case ChatListModel::RoleChatType: return data->chatType;
         case ChatListModel::RoleGroupId: return data->groupId;
-        case ChatListModel::RoleTitle: return data->title();
-        case ChatListModel::RolePhotoSmall: return data->photoSmall();
-        case ChatListModel::RoleUnreadCount: return data->unreadCount();
-        case ChatListModel::RoleUnreadMentionCount: return data->unreadMentionCount();
-        case ChatListModel::RoleAvailableReactions: return data->availableReactions();
-        case ChatListModel::RoleUnreadReactionCount: return data->unreadReactionCount();
-        case ChatListModel::RoleLastReadInboxMessageId: return data->lastReadInboxMessageId();
-        case ChatListModel::RoleLastMessageSenderId: return data->senderUserId();
-        case ChatListModel::RoleLastMessageText: return data->senderMessageText();
-        case ChatListModel::RoleLastMessageDate: return data->senderMessageDate();
-        case ChatListModel::RoleLastMessageStatus: return data->senderMessageStatus();
+        case ChatListModel::RoleTitle: return data->roles.title;
+        case ChatListModel::RolePhotoSmall: return data->roles.photoSmall;
+        case ChatListModel::RoleUnreadCount: return data->roles.unreadCount;
+        case ChatListModel::RoleUnreadMentionCount: return data->roles.unreadMentionCount;
+        case ChatListModel::RoleAvailableReactions: return data->roles.availableReactions;
+        case ChatListModel::RoleUnreadReactionCount: return data->roles.unreadReactionCount;
+        case ChatListModel::RoleLastReadInboxMessageId: return data->roles.lastReadInboxMessageId;
+        case ChatListModel::RoleLastMessageSenderId: return data->roles.senderUserId;
+        case ChatListModel::RoleLastMessageText: return data->roles.senderMessageText;
+        case ChatListModel::RoleLastMessageDate: return data->roles.senderMessageDate;
+        case ChatListModel::RoleLastMessageStatus: return data->roles.senderMessageStatus;
         case ChatListModel::RoleChatMemberStatus: return data->memberStatus;
         case ChatListModel::RoleSecretChatState: return data->secretChatState;
         case ChatListModel::RoleIsVerified: return data->verified;
-        case ChatListModel::RoleIsChannel: return data->isChannel();
-        case ChatListModel::RoleIsMarkedAsUnread: return data->isMarkedAsUnread();
-        case ChatListModel::RoleIsPinned: return data->isPinned();
-        case ChatListModel::RoleFilter: return data->title() + " " + data->senderMessageText();
-        case ChatListModel::RoleDraftMessageText: return data->draftMessageText();
-        case ChatListModel::RoleDraftMessageDate: return data->draftMessageDate();
-        case ChatListModel::RoleChatFoldersList: return this->getChatFolderList().at(row);
+        case ChatListModel::RoleIsChannel: return data->roles.isChannel;
+        case ChatListModel::RoleIsMarkedAsUnread: return data->roles.isMarkedAsUnread;
+        case ChatListModel::RoleIsPinned: return data->roles.isPinned;
+        case ChatListModel::RoleFilter: return data->roles.filter;
+        case ChatListModel::RoleDraftMessageText: return data->roles.draftMessageText;
+        case ChatListModel::RoleDraftMessageDate: return data->roles.draftMessageDate;
+        case ChatListModel::RoleChatFoldersList: return getChatFolderList(data);
         case ChatListModel::RoleMainChatPositionId: return mainAllChatFolderPosition;
+        case ChatListModel::RoleIsPlaceholder: return data->placeholder;
         }
     }
     return QVariant();
@@ -563,44 +790,40 @@ QVariantMap ChatListModel::get(int row)
 
 QVariantMap ChatListModel::getById(qlonglong chatId)
 {
-    if (chatIndexMap.contains(chatId)) {
-        return chatList.value(chatIndexMap.value(chatId))->chatData;
+    if (pendingChats.contains(chatId)) {
+        addPendingChats();
+    }
+    const ChatData *chat = visibleChats.value(chatId);
+    if (chat) {
+        return chat->record->data;
     }
     return QVariantMap();
 }
 
+int ChatListModel::indexOf(const ChatData *chat) const
+{
+    // Only valid while the chat's order matches its position,
+    // i.e. look it up before changing the order
+    const QList<ChatData*>::const_iterator it = std::lower_bound(chatList.constBegin(), chatList.constEnd(), chat, ChatData::lessThan);
+    return (it != chatList.constEnd() && *it == chat) ? (it - chatList.constBegin()) : -1;
+}
+
 int ChatListModel::updateChatOrder(int chatIndex)
 {
     ChatData *chat = chatList.at(chatIndex);
 
+    // Everything except the chat itself is still sorted
     const int n = chatList.size();
     int newIndex = chatIndex;
-    while (newIndex > 0 && chat->compareTo(chatList.at(newIndex-1)) < 0) {
-        newIndex--;
-    }
-    if (newIndex == chatIndex) {
-        while (newIndex < n-1 && chat->compareTo(chatList.at(newIndex+1)) > 0) {
-            newIndex++;
-        }
+    if (chatIndex > 0 && chat->compareTo(chatList.at(chatIndex - 1)) < 0) {
+        newIndex = std::lower_bound(chatList.constBegin(), chatList.constBegin() + chatIndex, chat, ChatData::lessThan) - chatList.constBegin();
+    } else if (chatIndex < n - 1 && chat->compareTo(chatList.at(chatIndex + 1)) > 0) {
+        newIndex = std::lower_bound(chatList.constBegin() + chatIndex + 1, chatList.constEnd(), chat, ChatData::lessThan) - chatList.constBegin() - 1;
     }
     if (newIndex != chatIndex) {
         LOG("Moving chat" << chat->chatId << "from position" << chatIndex << "to" << newIndex);
         beginMoveRows(QModelIndex(), chatIndex, chatIndex, QModelIndex(), (newIndex < chatIndex) ? newIndex : (newIndex+1));
         chatList.move(chatIndex, newIndex);
-        chatIndexMap.insert(chat->chatId, newIndex);
-        // Update damaged part of the map
-        const int last = qMax(chatIndex, newIndex);
-        if (newIndex < chatIndex) {
-            // First index is already correct
-            for (int i = newIndex + 1; i <= last; i++) {
-                chatIndexMap.insert(chatList.at(i)->chatId, i);
-            }
-        } else {
-            // Last index is already correct
-            for (int i = chatIndex; i < last; i++) {
-                chatIndexMap.insert(chatList.at(i)->chatId, i);
-            }
-        }
         endMoveRows();
     } else {
         LOG("Chat" << chat->chatId << "stays at position" << chatIndex);
@@ -609,12 +832,32 @@ int ChatListModel::updateChatOrder(int chatIndex)
     return newIndex;
 }
 
-void ChatListModel::enableRefreshTimer()
+void ChatListModel::setChatInView(qlonglong chatId, bool inView)
 {
-    // Start timestamp refresh timer if not yet active (usually when the first visible chat is discovered)
-    if (!relativeTimeRefreshTimer->isActive()) {
-        LOG("Enabling refresh timer");
-        relativeTimeRefreshTimer->start();
+    const int count = chatsInView.value(chatId) + (inView ? 1 : -1);
+    if (count > 0) {
+        chatsInView.insert(chatId, count);
+        const ChatData *chat = visibleChats.value(chatId);
+        if (inView && chat) {
+            // The delegate has just been painted, so it's up to date
+            scheduleRelativeTimeRefresh(chat);
+        }
+    } else {
+        chatsInView.remove(chatId);
+        if (chatsInView.isEmpty()) {
+            relativeTimeRefreshTimer->stop();
+        }
+    }
+}
+
+void ChatListModel::scheduleRelativeTimeRefresh(const ChatData *chat)
+{
+    const qlonglong date = chat->displayedDate();
+    if (date > 0) {
+        const int msec = relativeTimeChangesIn(currentTime() - date) * 1000;
+        if (!relativeTimeRefreshTimer->isActive() || relativeTimeRefreshTimer->remainingTime() > msec) {
+            relativeTimeRefreshTimer->start(msec);
+        }
     }
 }
 
@@ -627,7 +870,7 @@ void ChatListModel::calculateUnreadState()
         QListIterator<ChatData*> chatIterator(this->chatList);
         while (chatIterator.hasNext()) {
             ChatData *currentChat = chatIterator.next();
-            int unreadCount = currentChat->unreadCount();
+            int unreadCount = currentChat->roles.unreadCount;
             if (unreadCount > 0) {
                 unreadChats++;
                 unreadMessages += unreadCount;
@@ -642,60 +885,278 @@ void ChatListModel::setSelectedFolderName(QString title)
 {
     selectedFolder = title;
     LOG("Select chat folder: " << selectedFolder);
-    //set choosen chats
+    // Unknown ones (e.g. the translated "All Chats") show everything
+    const int folderIndex = qMax(chatFolderTitles.indexOf(title), 0);
+    if (selectedFolderIndex != folderIndex) {
+        selectedFolderIndex = folderIndex;
+        emit selectedFolderChanged();
+    }
 }
 
-void ChatListModel::addVisibleChat(ChatData *chat)
+bool ChatListModel::updateFolders(ChatData *chat)
+{
+    quint64 mask = 0;
+    const int n = folders.size();
+    for (int i = 0; i < n; i++) {
+        const ChatFolder *folder = folders.at(i);
+        if (folder && folder->contains(chat)) {
+            mask |= (Q_UINT64_C(1) << i);
+        }
+    }
+    if (chat->folders != mask) {
+        chat->folders = mask;
+        return true;
+    }
+    return false;
+}
+
+void ChatListModel::updateAllFolders()
 {
+    // Hidden and pending chats are taken care of when they become visible
+    int firstChanged = -1;
+    int lastChanged = -1;
     const int n = chatList.size();
-    int pos;
-    for (pos = 0; pos < n && chat->compareTo(chatList.at(pos)) >= 0; pos++);
+    for (int i = 0; i < n; i++) {
+        if (updateFolders(chatList.at(i))) {
+            if (firstChanged < 0) {
+                firstChanged = i;
+            }
+            lastChanged = i;
+        }
+    }
+    if (firstChanged >= 0) {
+        LOG("Folders changed for rows" << firstChanged << "-" << lastChanged);
+        emit dataChanged(index(firstChanged), index(lastChanged), QVector<int>() << ChatListModel::RoleChatFoldersList);
+    }
+}
+
+qlonglong ChatListModel::selectedChatListId() const
+{
+    const ChatFolder *folder = folders.value(selectedFolderIndex);
+    return folder ? folder->chatListId : 0;
+}
+
+bool ChatListModel::lessThanInSelectedFolder(int row1, int row2) const
+{
+    // Rows are sorted by the main list, folders have their own order
+    const qlonglong chatListId = selectedChatListId();
+    const ChatData *chat1 = chatList.value(row1);
+    const ChatData *chat2 = chatList.value(row2);
+    if (chatListId && chat1 && chat2) {
+        const qlonglong order1 = chat1->listOrders.value(chatListId);
+        const qlonglong order2 = chat2->listOrders.value(chatListId);
+        if (order1 != order2) {
+            return order1 > order2;
+        }
+    }
+    return row1 < row2;
+}
+
+void ChatListModel::updateListPosition(const ChatPositionUpdate &update)
+{
+    ChatData *chat = visibleChats.value(update.chatId);
+    const bool visible = (chat != Q_NULLPTR);
+    if (!chat) {
+        chat = hiddenChats.value(update.chatId);
+    }
+    if (!chat) {
+        chat = pendingChats.value(update.chatId);
+    }
+    if (chat && chat->listOrders.value(update.chatListId) != update.order) {
+        LOG("Updating position of" << update.chatId << "in list" << update.chatListId << "to" << update.order);
+        if (update.order) {
+            chat->listOrders.insert(update.chatListId, update.order);
+        } else {
+            chat->listOrders.remove(update.chatListId);
+        }
+        // Let the folder proxy move or filter this one row
+        if (visible && (updateFolders(chat) || update.chatListId == selectedChatListId())) {
+            const QModelIndex modelIndex(index(indexOf(chat)));
+            emit dataChanged(modelIndex, modelIndex, QVector<int>() << ChatListModel::RoleChatFoldersList);
+        }
+    }
+}
+
+bool ChatListModel::isInSelectedFolder(int row) const
+{
+    // "All Chats" is not a real folder
+    return selectedFolderIndex <= 0 || row < 0 || row >= chatList.size() ||
+        (chatList.at(row)->folders & (Q_UINT64_C(1) << selectedFolderIndex));
+}
+
+void ChatListModel::addVisibleChat(ChatData *chat)
+{
+    // Hidden chats aren't refreshed while they are hidden
+    chat->refresh(ALL_FIELDS);
+    updateFolders(chat);
+    const int pos = std::lower_bound(chatList.constBegin(), chatList.constEnd(), chat, ChatData::lessThan) - chatList.constBegin();
     LOG("Adding chat" << chat->chatId << "at" << pos);
     beginInsertRows(QModelIndex(), pos, pos);
     chatList.insert(pos, chat);
-    chatIndexMap.insert(chat->chatId, pos);
-    // Update damaged part of the map
-    for (int i = pos + 1; i <= n; i++) {
-        chatIndexMap.insert(chatList.at(i)->chatId, i);
-    }
+    visibleChats.insert(chat->chatId, chat);
     endInsertRows();
     if (this->tdLibWrapper->getJoinChatRequested()) {
         this->tdLibWrapper->registerJoinChat();
-        emit chatJoined(chat->chatId, chat->chatData.value("title").toString());
+        emit chatJoined(chat->chatId, chat->title());
+    }
+}
+
+void ChatListModel::loadSnapshot()
+{
+    const QList<ChatListSnapshot::Chat> chats(ChatListSnapshot(snapshotFile).load());
+    for (const ChatListSnapshot::Chat &snapshotChat : chats) {
+        if (!visibleChats.contains(snapshotChat.id)) {
+            ChatData *chat = new ChatData(tdLibWrapper, ChatStore::ChatRef(new ChatStore::Chat(snapshotChat.toMap())));
+            chat->placeholder = true;
+            chat->placeholderText = snapshotChat.lastMessageText;
+            chat->placeholderDate = snapshotChat.lastMessageDate;
+            chat->refresh(ChatStore::FieldLastMessage);
+            updateFolders(chat);
+            visibleChats.insert(chat->chatId, chat);
+            chatList.append(chat);
+        }
+    }
+    if (!chatList.isEmpty()) {
+        // It's been saved in this order but let's not trust the file too much
+        std::sort(chatList.begin(), chatList.end(), ChatData::lessThan);
+    }
+}
+
+void ChatListModel::saveSnapshot()
+{
+    ChatListSnapshot snapshot(snapshotFile);
+    if (chatList.isEmpty()) {
+        snapshot.remove();
+        return;
+    }
+    QList<ChatListSnapshot::Chat> chats;
+    const int n = qMin(chatList.size(), SNAPSHOT_CHAT_COUNT);
+    for (int i = 0; i < n; i++) {
+        const ChatData *data = chatList.at(i);
+        ChatListSnapshot::Chat chat;
+        chat.id = data->chatId;
+        chat.order = data->order;
+        chat.type = data->record->data.value(TYPE).toMap().value(_TYPE).toString();
+        chat.title = data->title();
+        chat.lastMessageText = data->senderMessageText();
+        chat.lastMessageDate = data->senderMessageDate();
+        chat.unreadCount = data->unreadCount();
+        chat.unreadMentionCount = data->unreadMentionCount();
+        chat.isPinned = data->isPinned();
+        const QVariantMap photo(data->photoSmall().toMap());
+        const QVariantMap local(photo.value(LOCAL).toMap());
+        chat.photoFileId = photo.value(ID).toInt();
+        if (local.value(IS_DOWNLOADING_COMPLETED).toBool()) {
+            chat.photoPath = local.value(PATH).toString();
+        }
+        chats.append(chat);
+    }
+    snapshot.save(chats);
+}
+
+void ChatListModel::removePlaceholders()
+{
+    // Whatever TDLib hasn't confirmed by now is gone
+    for (int i = chatList.size() - 1; i >= 0; i--) {
+        ChatData *chat = chatList.at(i);
+        if (chat->placeholder) {
+            LOG("Removing placeholder" << chat->chatId << "at" << i);
+            beginRemoveRows(QModelIndex(), i, i);
+            chatList.removeAt(i);
+            visibleChats.remove(chat->chatId);
+            endRemoveRows();
+            delete chat;
+        }
+    }
+}
+
+void ChatListModel::addPendingChats()
+{
+    pendingChatsTimer->stop();
+    QList<ChatData*> chats;
+    QHashIterator<qlonglong,ChatData*> it(pendingChats);
+    while (it.hasNext()) {
+        ChatData *chat = it.next().value();
+        // Something may have changed while it was waiting
+        if (chat->isHidden() && !showHiddenChats) {
+            LOG("Hidden chat" << chat->chatId);
+            hiddenChats.insert(chat->chatId, chat);
+        } else {
+            updateFolders(chat);
+            chats.append(chat);
+        }
+    }
+    pendingChats.clear();
+
+    const int n = chats.size();
+    if (n > 0) {
+        LOG("Adding" << n << "chats");
+        std::sort(chats.begin(), chats.end(), ChatData::lessThan);
+        int pos = 0;
+        int i = 0;
+        while (i < n) {
+            // Insert the run of chats that goes in front of chatList.at(pos) in one go
+            pos = std::lower_bound(chatList.constBegin() + pos, chatList.constEnd(), chats.at(i), ChatData::lessThan) - chatList.constBegin();
+            const int j = (pos < chatList.size()) ?
+                (std::lower_bound(chats.constBegin() + i + 1, chats.constEnd(), chatList.at(pos), ChatData::lessThan) - chats.constBegin()) : n;
+            LOG("Adding chats" << i << "-" << (j - 1) << "at" << pos);
+            beginInsertRows(QModelIndex(), pos, pos + j - i - 1);
+            for (int k = i; k < j; k++) {
+                chatList.insert(pos++, chats.at(k));
+                visibleChats.insert(chats.at(k)->chatId, chats.at(k));
+            }
+            endInsertRows();
+            i = j;
+        }
+        if (this->tdLibWrapper->getJoinChatRequested()) {
+            this->tdLibWrapper->registerJoinChat();
+            emit chatJoined(chats.first()->chatId, chats.first()->title());
+        }
+        tdLibWrapper->registerChatListPainted();
     }
-    enableRefreshTimer();
 }
 
 void ChatListModel::updateChatVisibility(const TDLibWrapper::Group *group)
 {
     LOG("Updating chat visibility" << (group ? qPrintable(QString::number(group->groupId)) : ""));
+    QList<ChatData*> visible;
+    QList<ChatData*> hidden;
+    if (group) {
+        // Only the chats referencing this group can be affected
+        const QList<qlonglong> chatIds(groupChats.values(group->groupId));
+        for (const qlonglong chatId : chatIds) {
+            ChatData *chat;
+            if ((chat = visibleChats.value(chatId)) != Q_NULLPTR) {
+                visible.append(chat);
+            } else if ((chat = hiddenChats.value(chatId)) != Q_NULLPTR) {
+                hidden.append(chat);
+            } else if ((chat = pendingChats.value(chatId)) != Q_NULLPTR) {
+                // Waiting chats will be checked when they are added
+                chat->updateGroup(group);
+            }
+        }
+    } else {
+        visible = chatList;
+        hidden = hiddenChats.values();
+    }
+
     // See if any group has been removed from from view
-    for (int i = 0; i < chatList.size(); i++) {
-        ChatData *chat = chatList.at(i);
+    QVector<int> hiddenRows;
+    for (ChatData *chat : visible) {
+        const int chatIndex = indexOf(chat);
         const QVector<int> changedRoles(chat->updateGroup(group));
         if (chat->isHidden() && !showHiddenChats) {
-            LOG("Hiding chat" << chat->chatId << "at" << i);
-            beginRemoveRows(QModelIndex(), i, i);
-            chatList.removeAt(i);
-            // Update damaged part of the map
-            const int n = chatList.size();
-            for (int pos = i; pos < n; pos++) {
-                chatIndexMap.insert(chatList.at(pos)->chatId, pos);
-            }
-            i--;
-            hiddenChats.insert(chat->chatId, chat);
-            endRemoveRows();
+            LOG("Hiding chat" << chat->chatId << "at" << chatIndex);
+            hiddenRows.append(chatIndex);
         } else if (!changedRoles.isEmpty()) {
-            const QModelIndex modelIndex(index(i));
+            const QModelIndex modelIndex(index(chatIndex));
             emit dataChanged(modelIndex, modelIndex, changedRoles);
         }
     }
+    hideChats(hiddenRows);
 
     // And see if any group been added to the view
-    const QList<ChatData*> hiddenChatList = hiddenChats.values();
-    const int n = hiddenChatList.size();
-    for (int j = 0; j < n; j++) {
-        ChatData *chat = hiddenChatList.at(j);
+    for (ChatData *chat : hidden) {
         chat->updateGroup(group);
         if (!chat->isHidden() || showHiddenChats) {
             hiddenChats.remove(chat->chatId);
@@ -704,36 +1165,55 @@ void ChatListModel::updateChatVisibility(const TDLibWrapper::Group *group)
     }
 }
 
+void ChatListModel::hideChats(QVector<int> rows)
+{
+    // Removes each contiguous run of rows in one go, starting from the bottom
+    std::sort(rows.begin(), rows.end());
+    int last = rows.size() - 1;
+    while (last >= 0) {
+        int first = last;
+        while (first > 0 && rows.at(first - 1) == rows.at(first) - 1) {
+            first--;
+        }
+        const int firstRow = rows.at(first);
+        const int lastRow = rows.at(last);
+        LOG("Hiding rows" << firstRow << "-" << lastRow);
+        beginRemoveRows(QModelIndex(), firstRow, lastRow);
+        for (int row = firstRow; row <= lastRow; row++) {
+            ChatData *chat = chatList.at(row);
+            visibleChats.remove(chat->chatId);
+            hiddenChats.insert(chat->chatId, chat);
+        }
+        chatList.erase(chatList.begin() + firstRow, chatList.begin() + lastRow + 1);
+        endRemoveRows();
+        last = first - 1;
+    }
+}
+
 void ChatListModel::updateSecretChatVisibility(const QVariantMap secretChatDetails)
 {
     LOG("Updating secret chat visibility" << secretChatDetails.value(ID).toString());
+    addPendingChats();
     // See if any secret chat has been closed
+    QVector<int> hiddenRows;
     for (int i = 0; i < chatList.size(); i++) {
         ChatData *chat = chatList.at(i);
         if (chat->chatType != TDLibWrapper::ChatTypeSecret) {
             continue;
         }
-        if (chat->chatData.value(TYPE).toMap().value(SECRET_CHAT_ID).toLongLong() != secretChatDetails.value(ID).toLongLong()) {
+        if (chat->record->data.value(TYPE).toMap().value(SECRET_CHAT_ID).toLongLong() != secretChatDetails.value(ID).toLongLong()) {
             continue;
         }
         const QVector<int> changedRoles(chat->updateSecretChat(secretChatDetails));
         if (chat->isHidden() && !showHiddenChats) {
             LOG("Hiding chat" << chat->chatId << "at" << i);
-            beginRemoveRows(QModelIndex(), i, i);
-            chatList.removeAt(i);
-            // Update damaged part of the map
-            const int n = chatList.size();
-            for (int pos = i; pos < n; pos++) {
-                chatIndexMap.insert(chatList.at(pos)->chatId, pos);
-            }
-            i--;
-            hiddenChats.insert(chat->chatId, chat);
-            endRemoveRows();
+            hiddenRows.append(i);
         } else if (!changedRoles.isEmpty()) {
             const QModelIndex modelIndex(index(i));
             emit dataChanged(modelIndex, modelIndex, changedRoles);
         }
     }
+    hideChats(hiddenRows);
 }
 
 bool ChatListModel::showAllChats() const
@@ -753,8 +1233,16 @@ void ChatListModel::setShowAllChats(bool showAll)
 void ChatListModel::handleChatDiscovered(const QString &, const QVariantMap &chatToBeAdded)
 {
     LOG("New chat discovered");
-    ChatData *chat = new ChatData(tdLibWrapper, chatToBeAdded);
+    const ChatStore::ChatRef record(tdLibWrapper->getChatStore()->value(chatToBeAdded.value(ID).toLongLong()));
+    if (!record) {
+        WARN("Chat" << chatToBeAdded.value(ID).toString() << "is not in the store");
+        return;
+    }
+    ChatData *chat = new ChatData(tdLibWrapper, record);
 
+    if (chat->groupId && !groupChats.contains(chat->groupId, chat->chatId)) {
+        groupChats.insert(chat->groupId, chat->chatId);
+    }
     const TDLibWrapper::Group *group = tdLibWrapper->getGroup(chat->groupId);
     if (group) {
         chat->updateGroup(group);
@@ -767,194 +1255,194 @@ void ChatListModel::handleChatDiscovered(const QString &, const QVariantMap &cha
         }
     }
 
-    if (chat->isHidden() && !showHiddenChats) {
+    ChatData *placeholder = visibleChats.value(chat->chatId);
+    if (placeholder) {
+        // The real thing has arrived for a chat restored from the snapshot
+        const int chatIndex = indexOf(placeholder);
+        if (!chat->order) {
+            chat->order = placeholder->order;
+        }
+        if (chat->isHidden() && !showHiddenChats) {
+            LOG("Hiding restored chat" << chat->chatId << "at" << chatIndex);
+            beginRemoveRows(QModelIndex(), chatIndex, chatIndex);
+            chatList.removeAt(chatIndex);
+            visibleChats.remove(chat->chatId);
+            hiddenChats.insert(chat->chatId, chat);
+            endRemoveRows();
+        } else {
+            LOG("Replacing restored chat" << chat->chatId << "at" << chatIndex);
+            updateFolders(chat);
+            chatList.replace(chatIndex, chat);
+            visibleChats.insert(chat->chatId, chat);
+            const QModelIndex modelIndex(index(chatIndex));
+            emit dataChanged(modelIndex, modelIndex);
+            // The order may have changed since the snapshot was taken
+            updateChatOrder(chatIndex);
+        }
+        delete placeholder;
+    } else if (chat->isHidden() && !showHiddenChats) {
         LOG("Hidden chat" << chat->chatId);
         hiddenChats.insert(chat->chatId, chat);
     } else {
         LOG("Visible chat" << chat->chatId);
-        addVisibleChat(chat);
-    }
-}
-
-void ChatListModel::handleChatLastMessageUpdated(const QString &id, const QString &order, const QVariantMap &lastMessage)
-{
-    bool ok;
-    const qlonglong chatId = id.toLongLong(&ok);
-    if (ok) {
-        if (chatIndexMap.contains(chatId)) {
-            int chatIndex = chatIndexMap.value(chatId);
-            LOG("Updating last message for chat" << chatId <<" at index" << chatIndex << "new order" << order);
-            ChatData *chat = chatList.at(chatIndex);
-            if (chat->setOrder(order)) {
-                chatIndex = updateChatOrder(chatIndex);
-            }
-            const QModelIndex modelIndex(index(chatIndex));
-            emit dataChanged(modelIndex, modelIndex, chat->updateLastMessage(lastMessage));
-            emit chatChanged(chatId);
-        } else {
-            ChatData *chat = hiddenChats.value(chatId);
-            if (chat) {
-                LOG("Updating last message for hidden chat" << chatId << "new order" << order);
-                chat->setOrder(order);
-                chat->chatData.insert(LAST_MESSAGE, lastMessage);
-                // A chat can become visible (e.g. when a known contact joins Telegram)
-                // When the private chat is discovered it doesn't have any messages, now it could be there...
-                if (!chat->isHidden() || showHiddenChats) {
-                    hiddenChats.remove(chatId);
-                    addVisibleChat(chat);
-                }
-            }
+        pendingChats.insert(chat->chatId, chat);
+        if (!pendingChatsTimer->isActive()) {
+            pendingChatsTimer->start();
         }
     }
 }
 
-void ChatListModel::handleChatOrderUpdated(const QString &id, const QString &order)
+void ChatListModel::handleChatChanged(qlonglong chatId, ChatStore::Fields fields)
 {
-    bool ok;
-    const qlonglong chatId = id.toLongLong(&ok);
-    if (ok) {
-        if (chatIndexMap.contains(chatId)) {
-            LOG("Updating chat order of" << chatId << "to" << order);
-            int chatIndex = chatIndexMap.value(chatId);
-            if (chatList.at(chatIndex)->setOrder(order)) {
-                updateChatOrder(chatIndex);
-            }
-        } else {
-            ChatData *chat = hiddenChats.value(chatId);
-            if (chat) {
-                LOG("Updating order of hidden chat" << chatId << "to" << order);
-                chat->setOrder(order);
-            }
-        }
-    }
-}
-
-void ChatListModel::handleChatReadInboxUpdated(const QString &id, const QString &lastReadInboxMessageId, int unreadCount)
-{
-    bool ok;
-    const qlonglong chatId = id.toLongLong(&ok);
-    if (ok) {
-        const qlonglong messageId = lastReadInboxMessageId.toLongLong();
-        if (chatIndexMap.contains(chatId)) {
-            LOG("Updating chat unread count for" << chatId << "unread messages" << unreadCount << ", last read message ID: " << lastReadInboxMessageId);
-            const int chatIndex = chatIndexMap.value(chatId);
-            ChatData *chat = chatList.at(chatIndex);
-            QVector<int> changedRoles;
+    // The record itself has already been updated by the ChatStore,
+    // hidden chats get refreshed when they become visible
+    ChatData *chat = visibleChats.value(chatId);
+    if (chat) {
+        chat->refresh(fields);
+        QVector<int> changedRoles;
+        if (fields & (ChatStore::FieldLastMessage | ChatStore::FieldUnreadCount |
+            ChatStore::FieldLastReadInboxMessageId | ChatStore::FieldLastReadOutboxMessageId |
+            ChatStore::FieldNotificationSettings | ChatStore::FieldPermissions)) {
             changedRoles.append(ChatListModel::RoleDisplay);
-            if (chat->updateUnreadCount(unreadCount)) {
-                changedRoles.append(ChatListModel::RoleUnreadCount);
-            }
-            if (chat->updateLastReadInboxMessageId(messageId)) {
-                changedRoles.append(ChatListModel::RoleLastReadInboxMessageId);
-            }
+        }
+        if (fields & ChatStore::FieldTitle) {
+            changedRoles.append(ChatListModel::RoleTitle);
+        }
+        if (fields & (ChatStore::FieldTitle | ChatStore::FieldLastMessage)) {
+            changedRoles.append(ChatListModel::RoleFilter);
+        }
+        if (fields & ChatStore::FieldPhoto) {
+            changedRoles.append(ChatListModel::RolePhotoSmall);
+        }
+        if (fields & ChatStore::FieldLastMessage) {
+            changedRoles.append(ChatListModel::RoleLastMessageSenderId);
+            changedRoles.append(ChatListModel::RoleLastMessageDate);
+            changedRoles.append(ChatListModel::RoleLastMessageText);
+        }
+        if (fields & (ChatStore::FieldLastMessage | ChatStore::FieldLastReadOutboxMessageId)) {
+            changedRoles.append(ChatListModel::RoleLastMessageStatus);
+        }
+        if (fields & ChatStore::FieldIsPinned) {
+            changedRoles.append(ChatListModel::RoleIsPinned);
+        }
+        if (fields & ChatStore::FieldUnreadCount) {
+            changedRoles.append(ChatListModel::RoleUnreadCount);
+        }
+        if (fields & ChatStore::FieldLastReadInboxMessageId) {
+            changedRoles.append(ChatListModel::RoleLastReadInboxMessageId);
+        }
+        if (fields & ChatStore::FieldUnreadMentionCount) {
+            changedRoles.append(ChatListModel::RoleUnreadMentionCount);
+        }
+        if (fields & ChatStore::FieldUnreadReactionCount) {
+            changedRoles.append(ChatListModel::RoleUnreadReactionCount);
+        }
+        if (fields & ChatStore::FieldAvailableReactions) {
+            changedRoles.append(ChatListModel::RoleAvailableReactions);
+        }
+        if (fields & ChatStore::FieldDraftMessage) {
+            changedRoles.append(ChatListModel::RoleDraftMessageDate);
+            changedRoles.append(ChatListModel::RoleDraftMessageText);
+        }
+        if (fields & ChatStore::FieldIsMarkedAsUnread) {
+            changedRoles.append(ChatListModel::RoleIsMarkedAsUnread);
+        }
+        if ((fields & (ChatStore::FieldNotificationSettings | ChatStore::FieldUnreadCount |
+            ChatStore::FieldIsMarkedAsUnread)) && updateFolders(chat)) {
+            changedRoles.append(ChatListModel::RoleChatFoldersList);
+        }
+        if (!changedRoles.isEmpty()) {
+            const int chatIndex = indexOf(chat);
+            LOG("Chat" << chatId << "at index" << chatIndex << "changed" << fields);
             const QModelIndex modelIndex(index(chatIndex));
             emit dataChanged(modelIndex, modelIndex, changedRoles);
+        }
+        if (fields & ChatStore::FieldUnreadCount) {
             this->calculateUnreadState();
-        } else {
-            ChatData *chat = hiddenChats.value(chatId);
-            if (chat) {
-                LOG("Updating unread count for hidden chat" << chatId << "unread messages" << unreadCount << ", last read message ID: " << lastReadInboxMessageId);
-                chat->updateUnreadCount(unreadCount);
-                chat->updateLastReadInboxMessageId(messageId);
-            }
         }
-    }
-}
-
-void ChatListModel::handleChatReadOutboxUpdated(const QString &id, const QString &lastReadOutboxMessageId)
-{
-    bool ok;
-    const qlonglong chatId = id.toLongLong(&ok);
-    if (ok) {
-        if (chatIndexMap.contains(chatId)) {
-            LOG("Updating last read message for" << chatId << "last ID" << lastReadOutboxMessageId);
-            const int chatIndex = chatIndexMap.value(chatId);
-            ChatData *chat = chatList.at(chatIndex);
-            chat->chatData.insert(LAST_READ_OUTBOX_MESSAGE_ID, lastReadOutboxMessageId);
-            const QModelIndex modelIndex(index(chatIndex));
-            emit dataChanged(modelIndex, modelIndex);
-        } else {
-            ChatData *chat = hiddenChats.value(chatId);
-            if (chat) {
-                chat->chatData.insert(LAST_READ_OUTBOX_MESSAGE_ID, lastReadOutboxMessageId);
-            }
+        if ((fields & (ChatStore::FieldLastMessage | ChatStore::FieldDraftMessage)) && chatsInView.contains(chatId)) {
+            scheduleRelativeTimeRefresh(chat);
         }
+    } else if ((chat = pendingChats.value(chatId)) != Q_NULLPTR) {
+        chat->refresh(fields);
     }
 }
 
-void ChatListModel::handleChatPhotoUpdated(qlonglong chatId, const QVariantMap &photo)
+void ChatListModel::handleChatLastMessageUpdated(const ChatLastMessageUpdate &update)
 {
-    if (chatIndexMap.contains(chatId)) {
-        LOG("Updating chat photo for" << chatId);
-        const int chatIndex = chatIndexMap.value(chatId);
-        ChatData *chat = chatList.at(chatIndex);
-        chat->chatData.insert(PHOTO, photo);
-        QVector<int> changedRoles;
-        changedRoles.append(ChatListModel::RolePhotoSmall);
-        const QModelIndex modelIndex(index(chatIndex));
-        emit dataChanged(modelIndex, modelIndex, changedRoles);
-    } else {
-        ChatData *chat = hiddenChats.value(chatId);
-        if (chat) {
-            LOG("Updating photo for hidden chat" << chatId);
-            chat->chatData.insert(PHOTO, photo);
+    const qlonglong chatId = update.chatId;
+    ChatData *chat = visibleChats.value(chatId);
+    if (chat) {
+        const int chatIndex = indexOf(chat);
+        LOG("Updating last message for chat" << chatId <<" at index" << chatIndex << "new order" << update.order);
+        if (chat->setOrder(update.order)) {
+            updateChatOrder(chatIndex);
         }
-    }
-}
-
-void ChatListModel::handleChatPinnedMessageUpdated(qlonglong chatId, qlonglong pinnedMessageId)
-{
-    if (chatIndexMap.contains(chatId)) {
-        LOG("Updating pinned message for" << chatId);
-        const int chatIndex = chatIndexMap.value(chatId);
-        ChatData *chat = chatList.at(chatIndex);
-        chat->chatData.insert(PINNED_MESSAGE_ID, pinnedMessageId);
+        emit chatChanged(chatId);
     } else {
-        ChatData *chat = hiddenChats.value(chatId);
+        chat = hiddenChats.value(chatId);
         if (chat) {
-            LOG("Updating pinned message for hidden chat" << chatId);
-            chat->chatData.insert(PINNED_MESSAGE_ID, pinnedMessageId);
+            LOG("Updating last message for hidden chat" << chatId << "new order" << update.order);
+            chat->setOrder(update.order);
+            // A chat can become visible (e.g. when a known contact joins Telegram)
+            // When the private chat is discovered it doesn't have any messages, now it could be there...
+            if (!chat->isHidden() || showHiddenChats) {
+                hiddenChats.remove(chatId);
+                addVisibleChat(chat);
+            }
+        } else if ((chat = pendingChats.value(chatId)) != Q_NULLPTR) {
+            chat->setOrder(update.order);
         }
     }
 }
 
-void ChatListModel::handleMessageSendSucceeded(qlonglong messageId, qlonglong oldMessageId, const QVariantMap &message)
+void ChatListModel::handleChatOrderUpdated(const QString &id, const QString &order)
 {
     bool ok;
-    const qlonglong chatId(message.value(CHAT_ID).toLongLong(&ok));
+    const qlonglong chatId = id.toLongLong(&ok);
     if (ok) {
-        if (chatIndexMap.contains(chatId)) {
-            const int chatIndex = chatIndexMap.value(chatId);
-            LOG("Updating last message for chat" << chatId << "at index" << chatIndex << ", as message was sent, old ID:" << oldMessageId << ", new ID:" << messageId);
-            const QModelIndex modelIndex(index(chatIndex));
-            emit dataChanged(modelIndex, modelIndex, chatList.at(chatIndex)->updateLastMessage(message));
+        ChatData *chat = visibleChats.value(chatId);
+        if (chat) {
+            LOG("Updating chat order of" << chatId << "to" << order);
+            const int chatIndex = indexOf(chat);
+            if (chat->setOrder(order)) {
+                updateChatOrder(chatIndex);
+            }
         } else {
-            ChatData *chat = hiddenChats.value(chatId);
+            chat = hiddenChats.value(chatId);
+            if (!chat) {
+                chat = pendingChats.value(chatId);
+            }
             if (chat) {
-                LOG("Updating last message for hidden chat" << chatId << ", as message was sent, old ID:" << oldMessageId << ", new ID:" << messageId);
-                chat->chatData.insert(LAST_MESSAGE, message);
+                LOG("Updating order of invisible chat" << chatId << "to" << order);
+                chat->setOrder(order);
             }
         }
     }
 }
 
-void ChatListModel::handleChatNotificationSettingsUpdated(const QString &id, const QVariantMap &chatNotificationSettings)
+void ChatListModel::handleChatPositionUpdated(const ChatPositionUpdate &update)
 {
-    bool ok;
-    const qlonglong chatId = id.toLongLong(&ok);
-    if (ok) {
-        if (chatIndexMap.contains(chatId)) {
-            const int chatIndex = chatIndexMap.value(chatId);
-            LOG("Updating notification settings for chat" << chatId << "at index" << chatIndex);
-            ChatData *chat = chatList.at(chatIndex);
-            chat->chatData.insert(NOTIFICATION_SETTINGS, chatNotificationSettings);
-            const QModelIndex modelIndex(index(chatIndex));
-            emit dataChanged(modelIndex, modelIndex);
-        } else {
-            ChatData *chat = hiddenChats.value(chatId);
-            if (chat) {
-                chat->chatData.insert(NOTIFICATION_SETTINGS, chatNotificationSettings);
-            }
+    if (update.chatListId != ChatPositionUpdate::ChatListMain) {
+        updateListPosition(update);
+        return;
+    }
+    const qlonglong chatId = update.chatId;
+    ChatData *chat = visibleChats.value(chatId);
+    if (chat) {
+        LOG("Updating chat position of" << chatId << "to" << update.order << "pinned" << update.isPinned);
+        const int chatIndex = indexOf(chat);
+        if (chat->setOrder(update.order)) {
+            updateChatOrder(chatIndex);
+        }
+    } else {
+        chat = hiddenChats.value(chatId);
+        if (!chat) {
+            chat = pendingChats.value(chatId);
+        }
+        if (chat) {
+            LOG("Updating position of invisible chat" << chatId << "to" << update.order);
+            chat->setOrder(update.order);
         }
     }
 }
@@ -970,170 +1458,96 @@ void ChatListModel::handleSecretChatUpdated(qlonglong secretChatId, const QVaria
     updateSecretChatVisibility(secretChat);
 }
 
-void ChatListModel::handleChatTitleUpdated(const QString &chatId, const QString &title)
+void ChatListModel::handleChatDraftMessageUpdated(qlonglong chatId, const QVariantMap &, const QString &order)
 {
-    qlonglong chatIdLongLong = chatId.toLongLong();
-    if (chatIndexMap.contains(chatIdLongLong)) {
-        LOG("Updating title for" << chatId);
-        const int chatIndex = chatIndexMap.value(chatIdLongLong);
-        ChatData *chat = chatList.at(chatIndex);
-        chat->chatData.insert(TITLE, title);
-        QVector<int> changedRoles;
-        changedRoles.append(ChatListModel::RoleTitle);
-        changedRoles.append(ChatListModel::RoleFilter);
-        const QModelIndex modelIndex(index(chatIndex));
-        emit dataChanged(modelIndex, modelIndex, changedRoles);
-    } else {
-        ChatData *chat = hiddenChats.value(chatId.toLongLong());
-        if (chat) {
-            LOG("Updating title for hidden chat" << chatId);
-            chat->chatData.insert(TITLE, title);
+    LOG("Updating draft message order for" << chatId);
+    ChatData *chat = visibleChats.value(chatId);
+    if (chat) {
+        const int chatIndex = indexOf(chat);
+        if (chat->setOrder(order)) {
+            updateChatOrder(chatIndex);
         }
-    }
-}
-
-void ChatListModel::handleChatPinnedUpdated(qlonglong chatId, bool chatIsPinned)
-{
-    if (chatIndexMap.contains(chatId)) {
-        LOG("Updating chat is pinned for" << chatId << chatIsPinned);
-        const int chatIndex = chatIndexMap.value(chatId);
-        ChatData *chat = chatList.at(chatIndex);
-        chat->chatData.insert(IS_PINNED, chatIsPinned);
-        QVector<int> changedRoles;
-        changedRoles.append(ChatListModel::RoleIsPinned);
-        const QModelIndex modelIndex(index(chatIndex));
-        emit dataChanged(modelIndex, modelIndex, changedRoles);
     } else {
-        ChatData *chat = hiddenChats.value(chatId);
+        chat = pendingChats.value(chatId);
         if (chat) {
-            LOG("Updating chat is pinned for hidden chat" << chatId);
-            chat->chatData.insert(IS_PINNED, chatIsPinned);
+            chat->setOrder(order);
         }
     }
 }
 
-void ChatListModel::handleChatIsMarkedAsUnreadUpdated(qlonglong chatId, bool chatIsMarkedAsUnread)
+void ChatListModel::handleRelativeTimeRefreshTimer()
 {
-    if (chatIndexMap.contains(chatId)) {
-        LOG("Updating chat is marked as unread for" << chatId << chatIsMarkedAsUnread);
-        const int chatIndex = chatIndexMap.value(chatId);
-        ChatData *chat = chatList.at(chatIndex);
-        chat->chatData.insert(IS_MARKED_AS_UNREAD, chatIsMarkedAsUnread);
-        QVector<int> changedRoles;
-        changedRoles.append(ChatListModel::RoleIsMarkedAsUnread);
-        const QModelIndex modelIndex(index(chatIndex));
-        emit dataChanged(modelIndex, modelIndex, changedRoles);
-    } else {
-        ChatData *chat = hiddenChats.value(chatId);
-        if (chat) {
-            LOG("Updating chat is marked as unread for hidden chat" << chatId);
-            chat->chatData.insert(IS_MARKED_AS_UNREAD, chatIsMarkedAsUnread);
+    // The timer fires at the earliest change, so everything in view has
+    // been up to date since the previous refresh
+    const qint64 now = currentTime();
+    qint64 next = 0;
+    int refreshed = 0;
+    QVector<int> roles;
+    roles.append(ChatListModel::RoleLastMessageDate);
+    roles.append(ChatListModel::RoleDraftMessageDate);
+    QHashIterator<qlonglong,int> it(chatsInView);
+    while (it.hasNext()) {
+        const ChatData *chat = visibleChats.value(it.next().key());
+        const qlonglong date = chat ? chat->displayedDate() : 0;
+        if (date > 0) {
+            if (relativeTimeBucket(relativeTimeRefreshed - date) != relativeTimeBucket(now - date)) {
+                const QModelIndex modelIndex(index(indexOf(chat)));
+                emit dataChanged(modelIndex, modelIndex, roles);
+                refreshed++;
+            }
+            const qint64 changesIn = relativeTimeChangesIn(now - date);
+            if (!next || changesIn < next) {
+                next = changesIn;
+            }
         }
     }
-}
-
-void ChatListModel::handleChatDraftMessageUpdated(qlonglong chatId, const QVariantMap &draftMessage, const QString &order)
-{
-    LOG("Updating draft message for" << chatId);
-    if (chatIndexMap.contains(chatId)) {
-        const int chatIndex = chatIndexMap.value(chatId);
-        ChatData *chat = chatList.at(chatIndex);
-        chat->chatData.insert(DRAFT_MESSAGE, draftMessage);
-
-        QVector<int> changedRoles;
-        changedRoles.append(ChatListModel::RoleDraftMessageDate);
-        changedRoles.append(ChatListModel::RoleDraftMessageText);
-        const QModelIndex modelIndex(index(chatIndex));
-        emit dataChanged(modelIndex, modelIndex, changedRoles);
-        if (chat->setOrder(order)) {
-            updateChatOrder(chatIndex);
-        }
+    LOG("Refreshed" << refreshed << "of" << chatsInView.count() << "timestamps, next refresh in" << next << "s");
+    relativeTimeRefreshed = now;
+    if (next) {
+        relativeTimeRefreshTimer->start(next * 1000);
     }
 }
 
-void ChatListModel::handleChatUnreadMentionCountUpdated(qlonglong chatId, int unreadMentionCount)
+void ChatListModel::handleOwnUserIdFound()
 {
-    if (chatIndexMap.contains(chatId)) {
-        LOG("Updating mention count for" << chatId << unreadMentionCount);
-        const int chatIndex = chatIndexMap.value(chatId);
-        ChatData *chat = chatList.at(chatIndex);
-        chat->chatData.insert(UNREAD_MENTION_COUNT, unreadMentionCount);
-        QVector<int> changedRoles;
-        changedRoles.append(ChatListModel::RoleUnreadMentionCount);
-        const QModelIndex modelIndex(index(chatIndex));
-        emit dataChanged(modelIndex, modelIndex, changedRoles);
-    } else {
-        ChatData *chat = hiddenChats.value(chatId);
-        if (chat) {
-            LOG("Updating mention count for hidden chat" << chatId << unreadMentionCount);
-            chat->chatData.insert(UNREAD_MENTION_COUNT, unreadMentionCount);
-        }
+    // Cached last message texts and statuses depend on who we are
+    LOG("Refreshing last messages");
+    QListIterator<ChatData*> chatIterator(chatList);
+    while (chatIterator.hasNext()) {
+        chatIterator.next()->refresh(ChatStore::FieldLastMessage);
     }
-}
-
-void ChatListModel::handleChatUnreadReactionCountUpdated(qlonglong chatId, int unreadReactionCount)
-{
-    if (chatIndexMap.contains(chatId)) {
-        LOG("Updating reaction count for" << chatId << unreadReactionCount);
-        const int chatIndex = chatIndexMap.value(chatId);
-        ChatData *chat = chatList.at(chatIndex);
-        chat->chatData.insert(UNREAD_REACTION_COUNT, unreadReactionCount);
-        QVector<int> changedRoles;
-        changedRoles.append(ChatListModel::RoleUnreadReactionCount);
-        const QModelIndex modelIndex(index(chatIndex));
-        emit dataChanged(modelIndex, modelIndex, changedRoles);
-    } else {
-        ChatData *chat = hiddenChats.value(chatId);
-        if (chat) {
-            LOG("Updating reaction count for hidden chat" << chatId << unreadReactionCount);
-            chat->chatData.insert(UNREAD_REACTION_COUNT, unreadReactionCount);
-        }
+    QHashIterator<qlonglong,ChatData*> pendingIt(pendingChats);
+    while (pendingIt.hasNext()) {
+        pendingIt.next().value()->refresh(ChatStore::FieldLastMessage);
     }
-}
-
-void ChatListModel::handleChatAvailableReactionsUpdated(qlonglong chatId, const QVariantMap availableReactions)
-{
-    if (chatIndexMap.contains(chatId)) {
-        LOG("Updating available reaction type for" << chatId << availableReactions);
-        const int chatIndex = chatIndexMap.value(chatId);
-        ChatData *chat = chatList.at(chatIndex);
-        chat->chatData.insert(AVAILABLE_REACTIONS, availableReactions);
-        QVector<int> changedRoles;
-        changedRoles.append(ChatListModel::RoleAvailableReactions);
-        const QModelIndex modelIndex(index(chatIndex));
-        emit dataChanged(modelIndex, modelIndex, changedRoles);
-    } else {
-        ChatData *chat = hiddenChats.value(chatId);
-        if (chat) {
-            LOG("Updating available reaction type for hidden chat" << chatId << availableReactions);
-            chat->chatData.insert(AVAILABLE_REACTIONS, availableReactions);
-        }
+    if (!chatList.isEmpty()) {
+        QVector<int> roles;
+        roles.append(ChatListModel::RoleLastMessageText);
+        roles.append(ChatListModel::RoleLastMessageStatus);
+        roles.append(ChatListModel::RoleFilter);
+        emit dataChanged(index(0), index(chatList.size() - 1), roles);
     }
 }
 
-void ChatListModel::handleRelativeTimeRefreshTimer()
-{
-    LOG("Refreshing timestamps");
-    QVector<int> roles;
-    roles.append(ChatListModel::RoleLastMessageDate);
-    roles.append(ChatListModel::RoleLastMessageStatus);
-    emit dataChanged(index(0), index(chatList.size() - 1), roles);
-}
-
 void ChatListModel::handleChatFolders(const QVariantList &foldersInformation, qlonglong mainChatlistPosition)
 {
     LOG("Updating available chat Folders" << foldersInformation << "with main Chatlist position" << mainChatlistPosition);
     chatFolders.clear();
     chatFolderTitles.clear();
+    qDeleteAll(folders);
+    folders.clear();
 
     chatFolders.insert("-1", tr("All Chats"));
     chatFolderTitles.push_back(tr("All Chats"));
+    folders.append(Q_NULLPTR);
 
     chatFolders.insert("-2", tr("Chats only"));
     chatFolderTitles.push_back(tr("Chats only"));
+    folders.append(new ChatFolder(ChatFolder::KindContact | ChatFolder::KindNonContact | ChatFolder::KindBot | ChatFolder::KindGroup));
 
     chatFolders.insert("-3", tr("Channels only"));
     chatFolderTitles.push_back(tr("Channels only"));
+    folders.append(new ChatFolder(ChatFolder::KindChannel));
 
     int positionIndex = 0;
     mainAllChatFolderPosition = mainChatlistPosition;
@@ -1143,9 +1557,15 @@ void ChatListModel::handleChatFolders(const QVariantList &foldersInformation, ql
         QString title = map.value("title").toString();
         chatFolders.insert(id, title);
         chatFolderTitles.push_back(title);
+        // The definition may have already arrived, otherwise it's on its way
+        folders.append((folders.size() < MAX_CHAT_FOLDERS) ? new ChatFolder(id.toLongLong(), chatFolderList.value(title).toMap()) : Q_NULLPTR);
         ++positionIndex;
     }
 
+    // Even if the index is the same, the folder may not be
+    selectedFolderIndex = qMax(chatFolderTitles.indexOf(selectedFolder), 0);
+    updateAllFolders();
+    emit selectedFolderChanged();
     emit chatFoldersChanged(chatFolders);
 }
 
@@ -1158,6 +1578,14 @@ void ChatListModel::handleChatFolderInformation(const QVariantMap &chatFolderInf
             chatFolderList.erase(it);
     }
     chatFolderList.insert(title, chatFolderInformation);
+    const int folderIndex = chatFolderTitles.lastIndexOf(title);
+    if (folderIndex > 0 && folderIndex < MAX_CHAT_FOLDERS) {
+        LOG("Updating definition of chat folder" << title);
+        ChatFolder *folder = folders.at(folderIndex);
+        folders.replace(folderIndex, new ChatFolder(folder ? folder->chatListId : 0, chatFolderInformation));
+        delete folder;
+        updateAllFolders();
+    }
     emit chatFolderInforamtionChanged(chatFolderList);
 }
 
@@ -1166,19 +1594,62 @@ QVariantList ChatListModel::getChatFolderList() const
     return chatFolderTitles;
 }
 
+QStringList ChatListModel::getChatFolderList(const ChatData *chat) const
+{
+    QStringList titles;
+    const int n = qMin(chatFolderTitles.size(), MAX_CHAT_FOLDERS);
+    for (int i = 1; i < n; i++) {
+        if (chat->folders & (Q_UINT64_C(1) << i)) {
+            titles.append(chatFolderTitles.at(i).toString());
+        }
+    }
+    return titles;
+}
+
 ChatsFolderFilterProxy::ChatsFolderFilterProxy(QObject *parent)
     :QSortFilterProxyModel(parent)
 {
+    // ChatListModel reports folder membership and position changes with this role
+    setFilterRole(ChatListModel::RoleChatFoldersList);
+    setSortRole(ChatListModel::RoleChatFoldersList);
+}
+
+void ChatsFolderFilterProxy::setSource(QObject *model)
+{
+    setSourceModel(qobject_cast<QAbstractItemModel*>(model));
+}
+
+void ChatsFolderFilterProxy::setSourceModel(QAbstractItemModel *model)
+{
+    if (sourceModel() != model) {
+        if (m_model) {
+            disconnect(m_model, SIGNAL(selectedFolderChanged()), this, SLOT(handleSelectedFolderChanged()));
+        }
+        m_model = qobject_cast<ChatListModel*>(model);
+        if (m_model) {
+            connect(m_model, SIGNAL(selectedFolderChanged()), SLOT(handleSelectedFolderChanged()));
+        }
+        QSortFilterProxyModel::setSourceModel(model);
+        handleSelectedFolderChanged();
+        emit sourceChanged();
+    }
+}
 
+bool ChatsFolderFilterProxy::filterAcceptsRow(int source_row, const QModelIndex &) const
+{
+    // Folder membership is precomputed, changes come in as dataChanged
+    return !m_model || m_model->isInSelectedFolder(source_row);
 }
 
-bool ChatsFolderFilterProxy::filterAcceptsRow(int source_row, const QModelIndex &source_parent) const
+bool ChatsFolderFilterProxy::lessThan(const QModelIndex &left, const QModelIndex &right) const
 {
-    QModelIndex index = sourceModel()->index(source_row, 0, source_parent);
-    return true;
+    return m_model ? m_model->lessThanInSelectedFolder(left.row(), right.row()) : QSortFilterProxyModel::lessThan(left, right);
 }
 
-void ChatsFolderFilterProxy::sourceModelChanged()
+void ChatsFolderFilterProxy::handleSelectedFolderChanged()
 {
-    m_model = qobject_cast<ChatListModel*>(sourceModel());
+    invalidateFilter();
+    // Folders which have a chat list of their own are shown in its order,
+    // otherwise the rows stay in the order of the main list
+    sort((m_model && m_model->selectedChatListId()) ? 0 : -1);
 }
@@ -62,10 +62,13 @@ public:
         RoleDraftMessageText,
         RoleDraftMessageDate,
         RoleChatFoldersList,
-        RoleMainChatPositionId
+        RoleMainChatPositionId,
+        RoleIsPlaceholder
     };
 
-    ChatListModel(TDLibWrapper *tdLibWrapper, AppSettings *appSettings);
+    // Warm start shows the chats from the previous session until TDLib
+    // is ready and saves the top of the list on exit
+    ChatListModel(TDLibWrapper *tdLibWrapper, AppSettings *appSettings, bool warmStart = false);
     ~ChatListModel() override;
 
     QHash<int,QByteArray> roleNames() const Q_DECL_OVERRIDE;
@@ -78,34 +81,30 @@ public:
     Q_INVOKABLE void reset();
 
     Q_INVOKABLE void calculateUnreadState();
+    // Delegates tell which chats they show, only those get their
+    // relative timestamps refreshed
+    Q_INVOKABLE void setChatInView(qlonglong chatId, bool inView);
     Q_INVOKABLE void setSelectedFolderName(QString title);
 
     bool showAllChats() const;
     void setShowAllChats(bool showAll);
-    ChatListModel* clone();
 
 private slots:
     void handleChatDiscovered(const QString &chatId, const QVariantMap &chatInformation);
-    void handleChatLastMessageUpdated(const QString &chatId, const QString &order, const QVariantMap &lastMessage);
+    void handleChatChanged(qlonglong chatId, ChatStore::Fields fields);
+    void handleChatLastMessageUpdated(const ChatLastMessageUpdate &update);
     void handleChatOrderUpdated(const QString &chatId, const QString &order);
-    void handleChatReadInboxUpdated(const QString &chatId, const QString &lastReadInboxMessageId, int unreadCount);
-    void handleChatReadOutboxUpdated(const QString &chatId, const QString &lastReadOutboxMessageId);
-    void handleChatPhotoUpdated(qlonglong chatId, const QVariantMap &photo);
-    void handleChatPinnedMessageUpdated(qlonglong chatId, qlonglong pinnedMessageId);
-    void handleMessageSendSucceeded(qlonglong messageId, qlonglong oldMessageId, const QVariantMap &message);
-    void handleChatNotificationSettingsUpdated(const QString &chatId, const QVariantMap &chatNotificationSettings);
+    void handleChatPositionUpdated(const ChatPositionUpdate &update);
     void handleGroupUpdated(qlonglong groupId);
     void handleSecretChatUpdated(qlonglong secretChatId, const QVariantMap &secretChat);
-    void handleChatTitleUpdated(const QString &chatId, const QString &title);
-    void handleChatPinnedUpdated(qlonglong chatId, bool chatIsPinned);
-    void handleChatIsMarkedAsUnreadUpdated(qlonglong chatId, bool chatIsMarkedAsUnread);
     void handleChatDraftMessageUpdated(qlonglong chatId, const QVariantMap &draftMessage, const QString &order);
-    void handleChatUnreadMentionCountUpdated(qlonglong chatId, int unreadMentionCount);
-    void handleChatUnreadReactionCountUpdated(qlonglong chatId, int unreadReactionCount);
-    void handleChatAvailableReactionsUpdated(qlonglong chatId, const QVariantMap availableReactions);
     void handleRelativeTimeRefreshTimer();
+    void handleOwnUserIdFound();
     void handleChatFolders(const QVariantList &foldersInformation, qlonglong mainChatlistPosition);
     void handleChatFolderInformation(const QVariantMap &chatFolderInformation);
+    void addPendingChats();
+    void saveSnapshot();
+    void removePlaceholders();
 
 signals:
     void countChanged();
@@ -115,46 +114,78 @@ signals:
     void unreadStateChanged(int unreadMessagesCount, int unreadChatsCount);
     void chatFoldersChanged(const QVariantMap &chatFolders);
     void chatFolderInforamtionChanged(const QVariantMap &chatFolderInforamtion);
+    void selectedFolderChanged();
 
 private:
     class ChatData;
+    class ChatFolder;
     void addVisibleChat(ChatData *chat);
     void updateChatVisibility(const TDLibWrapper::Group *group);
+    void hideChats(QVector<int> rows);
     void updateSecretChatVisibility(const QVariantMap secretChatDetails);
+    int indexOf(const ChatData *chat) const;
     int updateChatOrder(int chatIndex);
-    void enableRefreshTimer();
+    void scheduleRelativeTimeRefresh(const ChatData *chat);
+    void loadSnapshot();
     QVariantList getChatFolderList() const;
+    QStringList getChatFolderList(const ChatData *chat) const;
+    bool updateFolders(ChatData *chat);
+    void updateAllFolders();
+    bool isInSelectedFolder(int row) const;
+    bool lessThanInSelectedFolder(int row1, int row2) const;
+    qlonglong selectedChatListId() const;
+    void updateListPosition(const ChatPositionUpdate &update);
     qlonglong mainAllChatFolderPosition;
 
 private:
     TDLibWrapper *tdLibWrapper;
     AppSettings *appSettings;
     QTimer *relativeTimeRefreshTimer;
+    qint64 relativeTimeRefreshed; // Seconds since epoch
+    QHash<qlonglong,int> chatsInView;
+    QTimer *pendingChatsTimer;
     QList<ChatData*> chatList;
     QVariantMap chatFolders;
     QVariantList chatFolderTitles;
     QVariantMap chatFolderList;
-    QHash<qlonglong,int> chatIndexMap;
+    // Parallel to chatFolderTitles, each folder is a bit in ChatData::folders
+    QList<ChatFolder*> folders;
+    int selectedFolderIndex;
+    // Positions aren't stored anywhere, chatList is sorted and gets binary searched
+    QHash<qlonglong,ChatData*> visibleChats;
     QHash<qlonglong,ChatData*> hiddenChats;
+    QHash<qlonglong,ChatData*> pendingChats;
+    // Group id => ids of the chats referencing it, whatever their state
+    QMultiHash<qlonglong,qlonglong> groupChats;
     bool showHiddenChats;
     QString selectedFolder;
+    QString snapshotFile;
 };
 
 
 class ChatsFolderFilterProxy : public QSortFilterProxyModel
 {
     Q_OBJECT
+    Q_PROPERTY(QObject* sourceModel READ sourceModel WRITE setSource NOTIFY sourceChanged)
+
 public:
     ChatsFolderFilterProxy(QObject *parent = Q_NULLPTR);
 
+    void setSource(QObject* model);
+    void setSourceModel(QAbstractItemModel *model) Q_DECL_OVERRIDE;
+
+signals:
+    void sourceChanged();
+
     // QSortFilterProxyModel interface
 protected:
-    bool filterAcceptsRow(int source_row, const QModelIndex &source_parent) const;
+    bool filterAcceptsRow(int source_row, const QModelIndex &source_parent) const Q_DECL_OVERRIDE;
+    bool lessThan(const QModelIndex &left, const QModelIndex &right) const Q_DECL_OVERRIDE;
 
-private:
-
-    void sourceModelChanged();
+private slots:
+    void handleSelectedFolderChanged();
 
+private:
     ChatListModel *m_model = nullptr;
 };
 
@@ -0,0 +1,174 @@
+/*
+    Copyright (C) 2020 Sebastian J. Wolf and other contributors
+
+    This file is part of Fernschreiber.
+
+    Fernschreiber is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Fernschreiber is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Fernschreiber. If not, see <http://www.gnu.org/licenses/>.
+*/
+#include "chatlistsnapshot.h"
+
+#include <QDataStream>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QSaveFile>
+
+#define DEBUG_MODULE ChatListSnapshot
+#include "debuglog.h"
+
+namespace {
+    const QString ID("id");
+    const QString _TYPE("@type");
+    const QString TYPE("type");
+    const QString TITLE("title");
+    const QString ORDER("order");
+    const QString PHOTO("photo");
+    const QString SMALL("small");
+    const QString LOCAL("local");
+    const QString PATH("path");
+    const QString IS_PINNED("is_pinned");
+    const QString UNREAD_COUNT("unread_count");
+    const QString UNREAD_MENTION_COUNT("unread_mention_count");
+    const QString IS_DOWNLOADING_COMPLETED("is_downloading_completed");
+    const QString TYPE_CHAT("chat");
+    const QString TYPE_CHAT_PHOTO_INFO("chatPhotoInfo");
+    const QString TYPE_FILE("file");
+    const QString TYPE_LOCAL_FILE("localFile");
+
+    const quint32 SNAPSHOT_MAGIC = 0x46534353; // FSCS
+    const quint16 SNAPSHOT_VERSION = 1;
+}
+
+ChatListSnapshot::Chat::Chat() :
+    id(0),
+    order(0),
+    lastMessageDate(0),
+    unreadCount(0),
+    unreadMentionCount(0),
+    isPinned(false),
+    photoFileId(0)
+{
+}
+
+QVariantMap ChatListSnapshot::Chat::toMap() const
+{
+    QVariantMap chatType;
+    chatType.insert(_TYPE, type);
+
+    QVariantMap chat;
+    chat.insert(_TYPE, TYPE_CHAT);
+    chat.insert(ID, id);
+    chat.insert(TYPE, chatType);
+    chat.insert(TITLE, title);
+    chat.insert(ORDER, QString::number(order));
+    chat.insert(UNREAD_COUNT, unreadCount);
+    chat.insert(UNREAD_MENTION_COUNT, unreadMentionCount);
+    chat.insert(IS_PINNED, isPinned);
+    if (photoFileId) {
+        QVariantMap local;
+        local.insert(_TYPE, TYPE_LOCAL_FILE);
+        local.insert(PATH, photoPath);
+        local.insert(IS_DOWNLOADING_COMPLETED, !photoPath.isEmpty());
+
+        QVariantMap file;
+        file.insert(_TYPE, TYPE_FILE);
+        file.insert(ID, photoFileId);
+        file.insert(LOCAL, local);
+
+        QVariantMap photo;
+        photo.insert(_TYPE, TYPE_CHAT_PHOTO_INFO);
+        photo.insert(SMALL, file);
+        chat.insert(PHOTO, photo);
+    }
+    return chat;
+}
+
+ChatListSnapshot::ChatListSnapshot(const QString &file) :
+    path(file)
+{
+}
+
+QList<ChatListSnapshot::Chat> ChatListSnapshot::load() const
+{
+    QList<Chat> chats;
+    QFile file(path);
+    if (file.open(QIODevice::ReadOnly) && file.size() > 0) {
+        uchar *data = file.map(0, file.size());
+        if (data) {
+            // No copying, QDataStream reads straight from the mapped pages
+            const QByteArray bytes(QByteArray::fromRawData((const char*)data, int(file.size())));
+            QDataStream in(bytes);
+            quint32 magic = 0;
+            quint16 version = 0;
+            quint32 count = 0;
+            in >> magic >> version >> count;
+            if (magic == SNAPSHOT_MAGIC && version == SNAPSHOT_VERSION) {
+                for (quint32 i = 0; i < count && in.status() == QDataStream::Ok; i++) {
+                    Chat chat;
+                    qint32 unreadCount, unreadMentionCount, photoFileId;
+                    in >> chat.id >> chat.order >> chat.type >> chat.title >>
+                        chat.lastMessageText >> chat.lastMessageDate >>
+                        unreadCount >> unreadMentionCount >> chat.isPinned >>
+                        photoFileId >> chat.photoPath;
+                    chat.unreadCount = unreadCount;
+                    chat.unreadMentionCount = unreadMentionCount;
+                    chat.photoFileId = photoFileId;
+                    if (in.status() == QDataStream::Ok) {
+                        if (!chat.photoPath.isEmpty() && !QFileInfo::exists(chat.photoPath)) {
+                            chat.photoPath.clear();
+                        }
+                        chats.append(chat);
+                    }
+                }
+                if (in.status() != QDataStream::Ok) {
+                    WARN("Snapshot" << path << "is truncated");
+                }
+            } else {
+                WARN("Ignoring snapshot" << path << "version" << version);
+            }
+            file.unmap(data);
+        }
+    }
+    LOG("Loaded" << chats.count() << "chats from" << path);
+    return chats;
+}
+
+bool ChatListSnapshot::save(const QList<Chat> &chats) const
+{
+    QDir().mkpath(QFileInfo(path).absolutePath());
+    QSaveFile file(path);
+    if (file.open(QIODevice::WriteOnly)) {
+        QDataStream out(&file);
+        out << SNAPSHOT_MAGIC << SNAPSHOT_VERSION << quint32(chats.count());
+        for (const Chat &chat : chats) {
+            out << chat.id << chat.order << chat.type << chat.title <<
+                chat.lastMessageText << chat.lastMessageDate <<
+                qint32(chat.unreadCount) << qint32(chat.unreadMentionCount) << chat.isPinned <<
+                qint32(chat.photoFileId) << chat.photoPath;
+        }
+        if (out.status() == QDataStream::Ok && file.commit()) {
+            LOG("Saved" << chats.count() << "chats to" << path);
+            return true;
+        }
+    }
+    WARN("Failed to save" << path);
+    return false;
+}
+
+void ChatListSnapshot::remove() const
+{
+    if (QFile::remove(path)) {
+        LOG("Removed" << path);
+    }
+}
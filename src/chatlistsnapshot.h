@@ -0,0 +1,61 @@
+/*
+    Copyright (C) 2020 Sebastian J. Wolf and other contributors
+
+    This file is part of Fernschreiber.
+
+    Fernschreiber is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Fernschreiber is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Fernschreiber. If not, see <http://www.gnu.org/licenses/>.
+*/
+#ifndef CHATLISTSNAPSHOT_H
+#define CHATLISTSNAPSHOT_H
+
+#include <QList>
+#include <QString>
+#include <QVariantMap>
+
+// What the top of the chat list looked like when the app was closed,
+// good enough to show something before TDLib gets going. The file is
+// mapped into memory and parsed in one pass, there's no JSON involved.
+
+class ChatListSnapshot
+{
+public:
+    class Chat {
+    public:
+        Chat();
+        QVariantMap toMap() const; // Shaped like TDLib's chat
+    public:
+        qlonglong id;
+        qlonglong order;
+        QString type; // @type of the chat type
+        QString title;
+        QString lastMessageText;
+        qlonglong lastMessageDate;
+        int unreadCount;
+        int unreadMentionCount;
+        bool isPinned;
+        int photoFileId;
+        QString photoPath; // Small photo, only if it has been downloaded
+    };
+
+    ChatListSnapshot(const QString &path);
+
+    QList<Chat> load() const;
+    bool save(const QList<Chat> &chats) const;
+    void remove() const;
+
+private:
+    const QString path;
+};
+
+#endif // CHATLISTSNAPSHOT_H
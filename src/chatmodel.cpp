@@ -326,8 +326,8 @@ ChatModel::ChatModel(TDLibWrapper *tdLibWrapper) :
     connect(this->tdLibWrapper, SIGNAL(sponsoredMessageReceived(qlonglong, QVariantMap)), this, SLOT(handleSponsoredMessageReceived(qlonglong, QVariantMap)));
     connect(this->tdLibWrapper, SIGNAL(newMessageReceived(qlonglong, QVariantMap)), this, SLOT(handleNewMessageReceived(qlonglong, QVariantMap)));
     connect(this->tdLibWrapper, SIGNAL(receivedMessage(qlonglong, qlonglong, QVariantMap)), this, SLOT(handleMessageReceived(qlonglong, qlonglong, QVariantMap)));
-    connect(this->tdLibWrapper, SIGNAL(chatReadInboxUpdated(QString, QString, int)), this, SLOT(handleChatReadInboxUpdated(QString, QString, int)));
-    connect(this->tdLibWrapper, SIGNAL(chatReadOutboxUpdated(QString, QString)), this, SLOT(handleChatReadOutboxUpdated(QString, QString)));
+    connect(this->tdLibWrapper, SIGNAL(chatReadInboxUpdate(ChatReadInboxUpdate)), this, SLOT(handleChatReadInboxUpdated(ChatReadInboxUpdate)));
+    connect(this->tdLibWrapper, SIGNAL(chatReadOutboxUpdate(ChatReadOutboxUpdate)), this, SLOT(handleChatReadOutboxUpdated(ChatReadOutboxUpdate)));
     connect(this->tdLibWrapper, SIGNAL(messageSendSucceeded(qlonglong, qlonglong, QVariantMap)), this, SLOT(handleMessageSendSucceeded(qlonglong, qlonglong, QVariantMap)));
     connect(this->tdLibWrapper, SIGNAL(chatNotificationSettingsUpdated(QString, QVariantMap)), this, SLOT(handleChatNotificationSettingsUpdated(QString, QVariantMap)));
     connect(this->tdLibWrapper, SIGNAL(chatPhotoUpdated(qlonglong, QVariantMap)), this, SLOT(handleChatPhotoUpdated(qlonglong, QVariantMap)));
@@ -666,20 +666,21 @@ void ChatModel::handleMessageReceived(qlonglong chatId, qlonglong messageId, con
     }
 }
 
-void ChatModel::handleChatReadInboxUpdated(const QString &id, const QString &lastReadInboxMessageId, int unreadCount)
+void ChatModel::handleChatReadInboxUpdated(const ChatReadInboxUpdate &update)
 {
-    if (id.toLongLong() == chatId) {
-        LOG("Updating chat unread count, unread messages" << unreadCount << ", last read message ID:" << lastReadInboxMessageId);
-        this->chatInformation.insert("unread_count", unreadCount);
+    if (update.chatId == chatId) {
+        const QString lastReadInboxMessageId(QString::number(update.lastReadInboxMessageId));
+        LOG("Updating chat unread count, unread messages" << update.unreadCount << ", last read message ID:" << lastReadInboxMessageId);
+        this->chatInformation.insert("unread_count", update.unreadCount);
         this->chatInformation.insert(LAST_READ_INBOX_MESSAGE_ID, lastReadInboxMessageId);
-        emit unreadCountUpdated(unreadCount, lastReadInboxMessageId);
+        emit unreadCountUpdated(update.unreadCount, lastReadInboxMessageId);
     }
 }
 
-void ChatModel::handleChatReadOutboxUpdated(const QString &id, const QString &lastReadOutboxMessageId)
+void ChatModel::handleChatReadOutboxUpdated(const ChatReadOutboxUpdate &update)
 {
-    if (id.toLongLong() == chatId) {
-        this->chatInformation.insert(LAST_READ_OUTBOX_MESSAGE_ID, lastReadOutboxMessageId);
+    if (update.chatId == chatId) {
+        this->chatInformation.insert(LAST_READ_OUTBOX_MESSAGE_ID, QString::number(update.lastReadOutboxMessageId));
         int sentIndex = calculateLastReadSentMessageId();
         LOG("Updating sent message ID, new index" << sentIndex);
         emit lastReadSentMessageUpdated(sentIndex);
@@ -18,12 +18,13 @@
 #include "chatpermissionfiltermodel.h"
 #include "chatlistmodel.h"
 
+#include <QElapsedTimer>
+
 #define DEBUG_MODULE ChatPermissionFilterModel
 #include "debuglog.h"
 
 namespace {
     const QString PERMISSIONS("permissions");
-    const QString STATUS("status");
 }
 
 ChatPermissionFilterModel::ChatPermissionFilterModel(QObject *parent) : QSortFilterProxyModel(parent)
@@ -33,27 +34,23 @@ ChatPermissionFilterModel::ChatPermissionFilterModel(QObject *parent) : QSortFil
 
 void ChatPermissionFilterModel::setSource(QObject *model)
 {
-    ChatListModel* chatListModel = qobject_cast<ChatListModel*>(model);
-    ChatListModel* chatListModelClone = chatListModel->clone();
-    setSourceModel(chatListModelClone);
+    // A live view, the chat list model is shared with the rest of the app
+    setSourceModel(qobject_cast<QAbstractItemModel*>(model));
 }
 
 void ChatPermissionFilterModel::setSourceModel(QAbstractItemModel *model)
 {
     if (sourceModel() != model) {
         LOG(model);
+        QElapsedTimer timer;
+        timer.start();
+        // This is where the rows get filtered
         QSortFilterProxyModel::setSourceModel(model);
+        LOG("Filtered" << rowCount() << "of" << (model ? model->rowCount() : 0) << "chats in" << timer.nsecsElapsed() / 1000 << "us");
         emit sourceChanged();
     }
 }
 
-ChatPermissionFilterModel::~ChatPermissionFilterModel() {
-    QAbstractItemModel* _sourceModel = sourceModel();
-    if(_sourceModel != nullptr) {
-        delete _sourceModel;
-    }
-}
-
 TDLibWrapper *ChatPermissionFilterModel::getTDLibWrapper() const
 {
     return tdLibWrapper;
@@ -90,6 +87,10 @@ bool ChatPermissionFilterModel::filterAcceptsRow(int sourceRow, const QModelInde
     if (model && tdLibWrapper && !requirePermissions.isEmpty()) {
         const TDLibWrapper::Group* group = Q_NULLPTR;
         const QModelIndex index(model->index(sourceRow, 0, sourceParent));
+        if (model->data(index, ChatListModel::RoleIsPlaceholder).toBool()) {
+            // Restored from the previous session, TDLib doesn't know it yet
+            return false;
+        }
         TDLibWrapper::ChatType chatType = (TDLibWrapper::ChatType)
             model->data(index, ChatListModel::RoleChatType).toInt();
 
@@ -119,7 +120,7 @@ bool ChatPermissionFilterModel::filterAcceptsRow(int sourceRow, const QModelInde
                 permissions = model->data(index, ChatListModel::RoleDisplay).toMap().value(PERMISSIONS).toMap();
                 break;
             case TDLibWrapper::ChatMemberStatusRestricted:
-                permissions = group->groupInfo.value(STATUS).toMap().value(PERMISSIONS).toMap();
+                permissions = group->permissions;
                 break;
             case TDLibWrapper::ChatMemberStatusLeft:
             case TDLibWrapper::ChatMemberStatusUnknown:
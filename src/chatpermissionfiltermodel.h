@@ -31,7 +31,6 @@ class ChatPermissionFilterModel : public QSortFilterProxyModel
 
 public:
     ChatPermissionFilterModel(QObject *parent = Q_NULLPTR);
-    ~ChatPermissionFilterModel() override;
     TDLibWrapper *getTDLibWrapper() const;
     void setTDLibWrapper(QObject* obj);
 
@@ -0,0 +1,206 @@
+/*
+    Copyright (C) 2020 Sebastian J. Wolf and other contributors
+
+    This file is part of Fernschreiber.
+
+    Fernschreiber is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Fernschreiber is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Fernschreiber. If not, see <http://www.gnu.org/licenses/>.
+*/
+#include "chatstore.h"
+#include "tdlibwrapper.h"
+
+#include <QtAlgorithms>
+
+#define DEBUG_MODULE ChatStore
+#include "debuglog.h"
+
+namespace {
+    const QString ID("id");
+    const QString TYPE("type");
+    const QString _TYPE("@type");
+    const QString CHAT_ID("chat_id");
+    const QString IS_CHANNEL("is_channel");
+    const QString TITLE("title");
+}
+
+// Indexed by the bit number of the field
+static const char* const FIELD_KEYS[] = {
+    "title",                        // FieldTitle
+    "photo",                        // FieldPhoto
+    "last_message",                 // FieldLastMessage
+    "is_pinned",                    // FieldIsPinned
+    "unread_count",                 // FieldUnreadCount
+    "last_read_inbox_message_id",   // FieldLastReadInboxMessageId
+    "last_read_outbox_message_id",  // FieldLastReadOutboxMessageId
+    "unread_mention_count",         // FieldUnreadMentionCount
+    "unread_reaction_count",        // FieldUnreadReactionCount
+    "available_reactions",          // FieldAvailableReactions
+    "notification_settings",        // FieldNotificationSettings
+    "draft_message",                // FieldDraftMessage
+    "is_marked_as_unread",          // FieldIsMarkedAsUnread
+    "pinned_message_id",            // FieldPinnedMessageId
+    "permissions"                   // FieldPermissions
+};
+
+ChatStore::Chat::Chat(const QVariantMap &chatData) :
+    id(chatData.value(ID).toLongLong()),
+    chatType(TDLibWrapper::chatTypeFromString(chatData.value(TYPE).toMap().value(_TYPE).toString())),
+    data(chatData)
+{
+}
+
+QString ChatStore::Chat::title() const
+{
+    return data.value(TITLE).toString();
+}
+
+bool ChatStore::Chat::isChannel() const
+{
+    return data.value(TYPE).toMap().value(IS_CHANNEL).toBool();
+}
+
+ChatStore::ChatStore(QObject *parent) :
+    QObject(parent)
+{
+}
+
+int ChatStore::count() const
+{
+    return chats.count();
+}
+
+ChatStore::ChatRef ChatStore::value(qlonglong chatId) const
+{
+    return chats.value(chatId);
+}
+
+QVariantMap ChatStore::getChat(qlonglong chatId) const
+{
+    const QSharedPointer<Chat> chat(chats.value(chatId));
+    return chat ? chat->data : QVariantMap();
+}
+
+void ChatStore::clear()
+{
+    // Whoever still holds a record keeps it alive
+    chats.clear();
+}
+
+ChatStore::Fields ChatStore::set(Chat *chat, Field field, const QVariant &value)
+{
+    const QString key(QLatin1String(FIELD_KEYS[qCountTrailingZeroBits(quint32(field))]));
+    if (chat->data.value(key) != value) {
+        chat->data.insert(key, value);
+        return field;
+    }
+    return Fields();
+}
+
+void ChatStore::update(qlonglong chatId, Field field, const QVariant &value)
+{
+    const QSharedPointer<Chat> chat(chats.value(chatId));
+    if (chat && set(chat.data(), field, value)) {
+        emit chatChanged(chatId, field);
+    }
+}
+
+void ChatStore::handleNewChat(const QVariantMap &chatInformation)
+{
+    const qlonglong chatId = chatInformation.value(ID).toLongLong();
+    LOG("New chat" << chatId);
+    chats.insert(chatId, QSharedPointer<Chat>(new Chat(chatInformation)));
+}
+
+void ChatStore::handleChatTitleUpdated(const QString &chatId, const QString &title)
+{
+    update(chatId.toLongLong(), FieldTitle, title);
+}
+
+void ChatStore::handleChatPhotoUpdated(qlonglong chatId, const QVariantMap &photo)
+{
+    update(chatId, FieldPhoto, photo);
+}
+
+void ChatStore::handleChatLastMessageUpdated(const ChatLastMessageUpdate &update)
+{
+    this->update(update.chatId, FieldLastMessage, update.lastMessage);
+}
+
+void ChatStore::handleChatPositionUpdated(const ChatPositionUpdate &update)
+{
+    if (update.chatListId == ChatPositionUpdate::ChatListMain) {
+        this->update(update.chatId, FieldIsPinned, update.isPinned);
+    }
+}
+
+void ChatStore::handleChatReadInboxUpdated(const ChatReadInboxUpdate &update)
+{
+    const QSharedPointer<Chat> chat(chats.value(update.chatId));
+    if (chat) {
+        const Fields changed(set(chat.data(), FieldUnreadCount, update.unreadCount) |
+            set(chat.data(), FieldLastReadInboxMessageId, update.lastReadInboxMessageId));
+        if (changed) {
+            emit chatChanged(update.chatId, changed);
+        }
+    }
+}
+
+void ChatStore::handleChatReadOutboxUpdated(const ChatReadOutboxUpdate &update)
+{
+    this->update(update.chatId, FieldLastReadOutboxMessageId, QString::number(update.lastReadOutboxMessageId));
+}
+
+void ChatStore::handleChatUnreadMentionCountUpdated(qlonglong chatId, int unreadMentionCount)
+{
+    update(chatId, FieldUnreadMentionCount, unreadMentionCount);
+}
+
+void ChatStore::handleChatUnreadReactionCountUpdated(qlonglong chatId, int unreadReactionCount)
+{
+    update(chatId, FieldUnreadReactionCount, unreadReactionCount);
+}
+
+void ChatStore::handleChatAvailableReactionsUpdated(qlonglong chatId, const QVariantMap &availableReactions)
+{
+    update(chatId, FieldAvailableReactions, availableReactions);
+}
+
+void ChatStore::handleChatNotificationSettingsUpdated(const QString &chatId, const QVariantMap &notificationSettings)
+{
+    update(chatId.toLongLong(), FieldNotificationSettings, notificationSettings);
+}
+
+void ChatStore::handleChatDraftMessageUpdated(qlonglong chatId, const QVariantMap &draftMessage)
+{
+    update(chatId, FieldDraftMessage, draftMessage);
+}
+
+void ChatStore::handleChatIsMarkedAsUnreadUpdated(qlonglong chatId, bool isMarkedAsUnread)
+{
+    update(chatId, FieldIsMarkedAsUnread, isMarkedAsUnread);
+}
+
+void ChatStore::handleChatPinnedMessageUpdated(qlonglong chatId, qlonglong pinnedMessageId)
+{
+    update(chatId, FieldPinnedMessageId, pinnedMessageId);
+}
+
+void ChatStore::handleChatPermissionsUpdated(const QString &chatId, const QVariantMap &permissions)
+{
+    update(chatId.toLongLong(), FieldPermissions, permissions);
+}
+
+void ChatStore::handleMessageSendSucceeded(qlonglong, qlonglong, const QVariantMap &message)
+{
+    update(message.value(CHAT_ID).toLongLong(), FieldLastMessage, message);
+}
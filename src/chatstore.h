@@ -0,0 +1,109 @@
+/*
+    Copyright (C) 2020 Sebastian J. Wolf and other contributors
+
+    This file is part of Fernschreiber.
+
+    Fernschreiber is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Fernschreiber is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Fernschreiber. If not, see <http://www.gnu.org/licenses/>.
+*/
+#ifndef CHATSTORE_H
+#define CHATSTORE_H
+
+#include <QObject>
+#include <QHash>
+#include <QSharedPointer>
+#include <QVariantMap>
+
+#include "tdlibupdates.h"
+
+// The one and only copy of every chat known to TDLibWrapper. The models
+// hold on to the records rather than copying them, and learn about the
+// changes from chatChanged() which says which fields have been touched.
+// The store is connected to TDLibReceiver before anyone else, so it's
+// already up to date when the rest of the app hears about an update.
+
+class ChatStore : public QObject
+{
+    Q_OBJECT
+public:
+    enum Field {
+        FieldTitle = 0x0001,
+        FieldPhoto = 0x0002,
+        FieldLastMessage = 0x0004,
+        FieldIsPinned = 0x0008,
+        FieldUnreadCount = 0x0010,
+        FieldLastReadInboxMessageId = 0x0020,
+        FieldLastReadOutboxMessageId = 0x0040,
+        FieldUnreadMentionCount = 0x0080,
+        FieldUnreadReactionCount = 0x0100,
+        FieldAvailableReactions = 0x0200,
+        FieldNotificationSettings = 0x0400,
+        FieldDraftMessage = 0x0800,
+        FieldIsMarkedAsUnread = 0x1000,
+        FieldPinnedMessageId = 0x2000,
+        FieldPermissions = 0x4000
+    };
+    Q_DECLARE_FLAGS(Fields, Field)
+
+    class Chat {
+    public:
+        Chat(const QVariantMap &chatData);
+        QString title() const;
+        bool isChannel() const;
+    public:
+        const qlonglong id;
+        const int chatType; // TDLibWrapper::ChatType
+        QVariantMap data;
+    };
+
+    typedef QSharedPointer<const Chat> ChatRef;
+
+    ChatStore(QObject *parent = Q_NULLPTR);
+
+    int count() const;
+    ChatRef value(qlonglong chatId) const;
+    QVariantMap getChat(qlonglong chatId) const;
+    void clear();
+
+signals:
+    void chatChanged(qlonglong chatId, ChatStore::Fields fields);
+
+public slots:
+    void handleNewChat(const QVariantMap &chatInformation);
+    void handleChatTitleUpdated(const QString &chatId, const QString &title);
+    void handleChatPhotoUpdated(qlonglong chatId, const QVariantMap &photo);
+    void handleChatLastMessageUpdated(const ChatLastMessageUpdate &update);
+    void handleChatPositionUpdated(const ChatPositionUpdate &update);
+    void handleChatReadInboxUpdated(const ChatReadInboxUpdate &update);
+    void handleChatReadOutboxUpdated(const ChatReadOutboxUpdate &update);
+    void handleChatUnreadMentionCountUpdated(qlonglong chatId, int unreadMentionCount);
+    void handleChatUnreadReactionCountUpdated(qlonglong chatId, int unreadReactionCount);
+    void handleChatAvailableReactionsUpdated(qlonglong chatId, const QVariantMap &availableReactions);
+    void handleChatNotificationSettingsUpdated(const QString &chatId, const QVariantMap &notificationSettings);
+    void handleChatDraftMessageUpdated(qlonglong chatId, const QVariantMap &draftMessage);
+    void handleChatIsMarkedAsUnreadUpdated(qlonglong chatId, bool isMarkedAsUnread);
+    void handleChatPinnedMessageUpdated(qlonglong chatId, qlonglong pinnedMessageId);
+    void handleChatPermissionsUpdated(const QString &chatId, const QVariantMap &permissions);
+    void handleMessageSendSucceeded(qlonglong messageId, qlonglong oldMessageId, const QVariantMap &message);
+
+private:
+    Fields set(Chat *chat, Field field, const QVariant &value);
+    void update(qlonglong chatId, Field field, const QVariant &value);
+
+private:
+    QHash<qlonglong, QSharedPointer<Chat> > chats;
+};
+
+Q_DECLARE_OPERATORS_FOR_FLAGS(ChatStore::Fields)
+
+#endif // CHATSTORE_H
@@ -87,7 +87,7 @@ void ContactsModel::handleUsersReceived(const QString &extra, const QVariantList
         while (userIdIterator.hasNext()) {
             QString nextUserId = userIdIterator.next().toString();
             if (!this->tdLibWrapper->hasUserInformation(nextUserId)) {
-                this->tdLibWrapper->getUserFullInfo(nextUserId);
+                this->tdLibWrapper->getUserFullInfo(nextUserId, TDLibWrapper::PriorityBackground);
             }
             this->contactIds.append(nextUserId);
         }
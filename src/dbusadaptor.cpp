@@ -18,14 +18,20 @@
 */
 
 #include "dbusadaptor.h"
+#include "tdlibwrapper.h"
 
 #define DEBUG_MODULE DBusAdaptor
 #include "debuglog.h"
 
-DBusAdaptor::DBusAdaptor(QObject *parent): QDBusAbstractAdaptor(parent)
+DBusAdaptor::DBusAdaptor(QObject *parent): QDBusAbstractAdaptor(parent), tdLibWrapper(Q_NULLPTR)
 {
 }
 
+void DBusAdaptor::setTDLibWrapper(TDLibWrapper *tdLibWrapper)
+{
+    this->tdLibWrapper = tdLibWrapper;
+}
+
 void DBusAdaptor::openMessage(const QString &chatId, const QString &messageId)
 {
     LOG("Open Message" << chatId << messageId);
@@ -39,3 +45,9 @@ void DBusAdaptor::openUrl(const QStringList &arguments)
         emit pleaseOpenUrl(arguments.first());
     }
 }
+
+QVariantMap DBusAdaptor::getReceiverStatistics()
+{
+    LOG("Get receiver statistics");
+    return this->tdLibWrapper ? this->tdLibWrapper->getReceiverStatistics() : QVariantMap();
+}
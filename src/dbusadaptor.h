@@ -21,6 +21,9 @@
 #define DBUSADAPTOR_H
 
 #include <QDBusAbstractAdaptor>
+#include <QVariantMap>
+
+class TDLibWrapper;
 
 class DBusAdaptor : public QDBusAbstractAdaptor
 {
@@ -30,6 +33,7 @@ class DBusAdaptor : public QDBusAbstractAdaptor
 
 public:
     DBusAdaptor(QObject *parent);
+    void setTDLibWrapper(TDLibWrapper *tdLibWrapper);
 
 signals:
     void pleaseOpenMessage(const QString &chatId, const QString &messageId);
@@ -38,6 +42,10 @@ signals:
 public slots:
     void openMessage(const QString &chatId, const QString &messageId);
     void openUrl(const QStringList &arguments);
+    QVariantMap getReceiverStatistics();
+
+private:
+    TDLibWrapper *tdLibWrapper;
 
 };
 
@@ -164,7 +164,7 @@ QString FernschreiberUtils::getMessageShortText(TDLibWrapper *tdLibWrapper, cons
                 if (i > 0) {
                     addedUserNames += ", ";
                 }
-                addedUserNames += getUserName(tdLibWrapper->getUserInformation(memberUserIds.at(i).toString()));
+                addedUserNames += tdLibWrapper->getUserFullName(memberUserIds.at(i).toString());
             }
             return myself ? tr("have added %1 to the chat", "myself").arg(addedUserNames) : tr("has added %1 to the chat").arg(addedUserNames);
         }
@@ -173,7 +173,7 @@ QString FernschreiberUtils::getMessageShortText(TDLibWrapper *tdLibWrapper, cons
         if (messageSenderType == MESSAGE_SENDER_TYPE_USER && messageSenderUserId == messageContent.value("user_id").toLongLong()) {
             return myself ? tr("left this chat", "myself") : tr("left this chat");
         } else {
-            return myself ? tr("have removed %1 from the chat", "myself").arg(getUserName(tdLibWrapper->getUserInformation(messageContent.value("user_id").toString()))) : tr("has removed %1 from the chat").arg(getUserName(tdLibWrapper->getUserInformation(messageContent.value("user_id").toString())));
+            return myself ? tr("have removed %1 from the chat", "myself").arg(tdLibWrapper->getUserFullName(messageContent.value("user_id").toString())) : tr("has removed %1 from the chat").arg(tdLibWrapper->getUserFullName(messageContent.value("user_id").toString()));
         }
     }
     if (contentType == "messageChatChangeTitle") {
@@ -132,6 +132,7 @@ int main(int argc, char *argv[])
     qmlRegisterType<NamedAction>(uri, 1, 0, "NamedAction");
     qmlRegisterType<TextFilterModel>(uri, 1, 0, "TextFilterModel");
     qmlRegisterType<BoolFilterModel>(uri, 1, 0, "BoolFilterModel");
+    qmlRegisterType<ChatsFolderFilterProxy>(uri, 1, 0, "ChatsFolderFilterProxy");
     qmlRegisterType<ChatPermissionFilterModel>(uri, 1, 0, "ChatPermissionFilterModel");
     qmlRegisterSingletonType<DebugLogJS>(uri, 1, 0, "DebugLog", DebugLogJS::createSingleton);
 
@@ -151,7 +152,7 @@ int main(int argc, char *argv[])
     DBusAdaptor *dBusAdaptor = tdLibWrapper->getDBusAdaptor();
     context->setContextProperty("dBusAdaptor", dBusAdaptor);
 
-    ChatListModel chatListModel(tdLibWrapper, appSettings);
+    ChatListModel chatListModel(tdLibWrapper, appSettings, true);
     context->setContextProperty("chatListModel", &chatListModel);
 
     ChatModel chatModel(tdLibWrapper);
@@ -28,6 +28,7 @@ KnownUsersModel::KnownUsersModel(TDLibWrapper *tdLibWrapper, QObject *parent)
     this->tdLibWrapper = tdLibWrapper;
 
     connect(this->tdLibWrapper, SIGNAL(userUpdated(QString, QVariantMap)), this, SLOT(handleUserUpdated(QString, QVariantMap)));
+    connect(this->tdLibWrapper, SIGNAL(userStatusUpdated(QString, QVariantMap)), this, SLOT(handleUserStatusUpdated(QString, QVariantMap)));
 }
 
 QHash<int, QByteArray> KnownUsersModel::roleNames() const
@@ -45,27 +46,52 @@ QHash<int, QByteArray> KnownUsersModel::roleNames() const
 
 int KnownUsersModel::rowCount(const QModelIndex &) const
 {
-    return this->knownUsers.size();
+    return this->userIds.size();
 }
 
 QVariant KnownUsersModel::data(const QModelIndex &index, int role) const
 {
     if (index.isValid()) {
-        QVariantMap requestedUser = knownUsers.values().value(index.row()).toMap();
-        switch (static_cast<KnownUserRole>(role)) {
-            case KnownUserRole::RoleDisplay: return requestedUser;
-            case KnownUserRole::RoleUserId: return requestedUser.value("id");
-            case KnownUserRole::RoleTitle: return QString(requestedUser.value("first_name").toString() + " " + requestedUser.value("last_name").toString()).trimmed();
-            case KnownUserRole::RoleUsername: return requestedUser.value("usernames").toMap().value("editable_username").toString();
-            case KnownUserRole::RoleUserHandle: return QString("@" + (requestedUser.value("usernames").toMap().value("editable_username").toString().isEmpty() ? requestedUser.value("id").toString() : requestedUser.value("usernames").toMap().value("editable_username").toString()));
-            case KnownUserRole::RolePhotoSmall: return requestedUser.value("profile_photo").toMap().value("small");
-            case KnownUserRole::RoleFilter: return  QString(requestedUser.value("first_name").toString() + " " + requestedUser.value("last_name").toString() + " " + requestedUser.value("usernames").toMap().value("editable_username").toString()).trimmed();
+        // The user details are looked up in TDLibWrapper rather than copied here
+        const UserStore::User *user = tdLibWrapper->getUser(userIds.value(index.row()));
+        if (user) {
+            const QString username(user->usernames.isEmpty() ? QString() : user->usernames.first());
+            switch (static_cast<KnownUserRole>(role)) {
+                case KnownUserRole::RoleDisplay: return UserStore::toMap(user);
+                case KnownUserRole::RoleUserId: return user->id;
+                case KnownUserRole::RoleTitle: return user->fullName();
+                case KnownUserRole::RoleUsername: return username;
+                case KnownUserRole::RoleUserHandle: return QString("@" + (username.isEmpty() ? QString::number(user->id) : username));
+                case KnownUserRole::RolePhotoSmall: return user->photoSmall;
+                case KnownUserRole::RoleFilter: return QString(user->firstName + " " + user->lastName + " " + username).trimmed();
+            }
         }
     }
     return QVariant();
 }
 
-void KnownUsersModel::handleUserUpdated(const QString &userId, const QVariantMap &userInformation)
+void KnownUsersModel::handleUserUpdated(const QString &userId, const QVariantMap &)
 {
-    this->knownUsers.insert(userId, userInformation);
+    const qlonglong id = userId.toLongLong();
+    const int row = this->userRows.value(id, -1);
+    if (row >= 0) {
+        const QModelIndex modelIndex(index(row));
+        emit dataChanged(modelIndex, modelIndex);
+    } else {
+        const int newRow = this->userIds.count();
+        beginInsertRows(QModelIndex(), newRow, newRow);
+        this->userIds.append(id);
+        this->userRows.insert(id, newRow);
+        endInsertRows();
+    }
+}
+
+void KnownUsersModel::handleUserStatusUpdated(const QString &userId, const QVariantMap &)
+{
+    // Only the display role contains the status
+    const int row = this->userRows.value(userId.toLongLong(), -1);
+    if (row >= 0) {
+        const QModelIndex modelIndex(index(row));
+        emit dataChanged(modelIndex, modelIndex, QVector<int>() << KnownUserRole::RoleDisplay);
+    }
 }
@@ -47,10 +47,12 @@ public:
 
 public slots:
     void handleUserUpdated(const QString &userId, const QVariantMap &userInformation);
+    void handleUserStatusUpdated(const QString &userId, const QVariantMap &status);
 
 private:
     TDLibWrapper *tdLibWrapper;
-    QVariantMap knownUsers;
+    QList<qlonglong> userIds;
+    QHash<qlonglong, int> userRows;
 
 };
 
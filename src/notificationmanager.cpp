@@ -35,10 +35,8 @@ namespace {
     const QString TYPE("type");
     const QString ID("id");
     const QString CHAT_ID("chat_id");
-    const QString IS_CHANNEL("is_channel");
     const QString TOTAL_COUNT("total_count");
     const QString DATE("date");
-    const QString TITLE("title");
     const QString CONTENT("content");
     const QString MESSAGE("message");
     const QString FIRST_NAME("first_name");
@@ -70,32 +68,6 @@ namespace {
     const QString VISIBILITY_PUBLIC("public");
 }
 
-class NotificationManager::ChatInfo
-{
-public:
-    ChatInfo(const QVariantMap &info);
-
-    void setChatInfo(const QVariantMap &info);
-
-public:
-    TDLibWrapper::ChatType type;
-    bool isChannel;
-    QString title;
-};
-
-NotificationManager::ChatInfo::ChatInfo(const QVariantMap &chatInfo)
-{
-    setChatInfo(chatInfo);
-}
-
-void NotificationManager::ChatInfo::setChatInfo(const QVariantMap &chatInfo)
-{
-    const QVariantMap chatTypeInformation = chatInfo.value(TYPE).toMap();
-    type = TDLibWrapper::chatTypeFromString(chatTypeInformation.value(_TYPE).toString());
-    isChannel = chatTypeInformation.value(IS_CHANNEL).toBool();
-    title = chatInfo.value(TITLE).toString();
-}
-
 class NotificationManager::NotificationGroup
 {
 public:
@@ -133,12 +105,12 @@ NotificationManager::NotificationManager(TDLibWrapper *tdLibWrapper, AppSettings
     this->appSettings = appSettings;
     this->mceInterface = mceInterface;
     this->chatModel = chatModel;
+    this->chats = tdLibWrapper->getChatStore();
 
     connect(this->tdLibWrapper, SIGNAL(activeNotificationsUpdated(QVariantList)), this, SLOT(handleUpdateActiveNotifications(QVariantList)));
     connect(this->tdLibWrapper, SIGNAL(notificationGroupUpdated(QVariantMap)), this, SLOT(handleUpdateNotificationGroup(QVariantMap)));
     connect(this->tdLibWrapper, SIGNAL(notificationUpdated(QVariantMap)), this, SLOT(handleUpdateNotification(QVariantMap)));
-    connect(this->tdLibWrapper, SIGNAL(newChatDiscovered(QString, QVariantMap)), this, SLOT(handleChatDiscovered(QString, QVariantMap)));
-    connect(this->tdLibWrapper, SIGNAL(chatTitleUpdated(QString, QString)), this, SLOT(handleChatTitleUpdated(QString, QString)));
+    connect(this->chats, SIGNAL(chatChanged(qlonglong, ChatStore::Fields)), this, SLOT(handleChatChanged(qlonglong, ChatStore::Fields)));
 
     this->controlLedNotification(false);
 
@@ -167,7 +139,6 @@ NotificationManager::NotificationManager(TDLibWrapper *tdLibWrapper, AppSettings
 NotificationManager::~NotificationManager()
 {
     LOG("Destroying myself...");
-    qDeleteAll(chatMap.values());
     qDeleteAll(notificationGroups.values());
 }
 
@@ -282,33 +253,16 @@ void NotificationManager::handleUpdateNotification(const QVariantMap &updatedNot
     LOG("Received notification update, group ID:" << updatedNotification.value(NOTIFICATION_GROUP_ID).toInt());
 }
 
-void NotificationManager::handleChatDiscovered(const QString &chatId, const QVariantMap &chatInformation)
-{
-    const qlonglong id = chatId.toLongLong();
-    ChatInfo *chat = chatMap.value(id);
-    if (chat) {
-        chat->setChatInfo(chatInformation);
-        LOG("Updated chat information" << id << chat->title);
-    } else {
-        chat = new ChatInfo(chatInformation);
-        chatMap.insert(id, chat);
-        LOG("New chat" << id << chat->title);
-    }
-}
-
-void NotificationManager::handleChatTitleUpdated(const QString &chatId, const QString &title)
+void NotificationManager::handleChatChanged(qlonglong chatId, ChatStore::Fields fields)
 {
-    const qlonglong id = chatId.toLongLong();
-    ChatInfo *chat = chatMap.value(id);
-    if (chat) {
-        LOG("Chat" << id << "title changed to" << title);
-        chat->title = title;
+    if (fields & ChatStore::FieldTitle) {
+        LOG("Chat" << chatId << "title changed");
 
         // Silently update notification summary
         QListIterator<NotificationGroup*> groupsIterator(notificationGroups.values());
         while (groupsIterator.hasNext()) {
             const NotificationGroup *group = groupsIterator.next();
-            if (group->chatId == id) {
+            if (group->chatId == chatId) {
                 LOG("Updating summary for group ID" << group->notificationGroupId);
                 publishNotification(group, false);
                 break;
@@ -320,7 +274,7 @@ void NotificationManager::handleChatTitleUpdated(const QString &chatId, const QS
 void NotificationManager::publishNotification(const NotificationGroup *notificationGroup, bool needFeedback)
 {
     QVariantMap messageMap;
-    const ChatInfo *chatInformation = chatMap.value(notificationGroup->chatId);
+    const ChatStore::ChatRef chatInformation(chats->value(notificationGroup->chatId));
     if (!notificationGroup->notificationOrder.isEmpty()) {
         const int lastNotificationId = notificationGroup->notificationOrder.last();
         const QVariantMap lastNotification(notificationGroup->activeNotifications.value(lastNotificationId));
@@ -353,21 +307,22 @@ void NotificationManager::publishNotification(const NotificationGroup *notificat
         if (outputMessageCount) {
             notificationBody += "; ";
         }
-        if (chatInformation && (chatInformation->type == TDLibWrapper::ChatTypeBasicGroup ||
-           (chatInformation->type == TDLibWrapper::ChatTypeSupergroup && !chatInformation->isChannel))) {
+        if (chatInformation && (chatInformation->chatType == TDLibWrapper::ChatTypeBasicGroup ||
+           (chatInformation->chatType == TDLibWrapper::ChatTypeSupergroup && !chatInformation->isChannel()))) {
             // Add author
             QString fullName;
             if (senderInformation.value(_TYPE).toString() == "messageSenderChat") {
-                fullName = tdLibWrapper->getChat(senderInformation.value(CHAT_ID).toString()).value(TITLE).toString();
+                const ChatStore::ChatRef senderChat(chats->value(senderInformation.value(CHAT_ID).toLongLong()));
+                fullName = senderChat ? senderChat->title() : QString();
             } else {
-                fullName = FernschreiberUtils::getUserName(tdLibWrapper->getUserInformation(senderInformation.value(USER_ID).toString()));
+                fullName = tdLibWrapper->getUserFullName(senderInformation.value(USER_ID).toString());
             }
             notificationBody += fullName.trimmed() + ": ";
         }
-        notificationBody += FernschreiberUtils::getMessageShortText(tdLibWrapper, messageMap.value(CONTENT).toMap(), (chatInformation ? chatInformation->isChannel : false), tdLibWrapper->getUserInformation().value(ID).toLongLong(), senderInformation );
+        notificationBody += FernschreiberUtils::getMessageShortText(tdLibWrapper, messageMap.value(CONTENT).toMap(), (chatInformation ? chatInformation->isChannel() : false), tdLibWrapper->getUserInformation().value(ID).toLongLong(), senderInformation );
     }
 
-    const QString summary(chatInformation ? chatInformation->title : QString());
+    const QString summary(chatInformation ? chatInformation->title() : QString());
     nemoNotification->setBody(notificationBody);
     nemoNotification->setSummary(summary);
     nemoNotification->setHintValue(HINT_VIBRA, needFeedback);
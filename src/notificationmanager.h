@@ -31,7 +31,6 @@ class ChatModel;
 class NotificationManager : public QObject
 {
     Q_OBJECT
-    class ChatInfo;
     class NotificationGroup;
 
 public:
@@ -44,8 +43,7 @@ public slots:
     void handleUpdateActiveNotifications(const QVariantList &notificationGroups);
     void handleUpdateNotificationGroup(const QVariantMap &notificationGroupUpdate);
     void handleUpdateNotification(const QVariantMap &updatedNotification);
-    void handleChatDiscovered(const QString &chatId, const QVariantMap &chatInformation);
-    void handleChatTitleUpdated(const QString &chatId, const QString &title);
+    void handleChatChanged(qlonglong chatId, ChatStore::Fields fields);
 
 private:
 
@@ -62,7 +60,7 @@ private:
     AppSettings *appSettings;
     MceInterface *mceInterface;
     ChatModel *chatModel;
-    QMap<qlonglong,ChatInfo*> chatMap;
+    const ChatStore *chats;
     QMap<int,NotificationGroup*> notificationGroups;
     QString appIconFile;
 
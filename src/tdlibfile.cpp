@@ -22,31 +22,6 @@
 #define DEBUG_MODULE TDLibFile
 #include "debuglog.h"
 
-namespace {
-    const QString ID("id");
-    const QString EXPECTED_SIZE("expected_size");
-    const QString SIZE("size");
-    const QString LOCAL("local");
-    const QString CAN_BE_DELETED("can_be_deleted");
-    const QString CAN_BE_DOWNLOADED("can_be_downloaded");
-    const QString DOWNLOAD_OFFSET("download_offset");
-    const QString DOWNLOADED_PREFIX_SIZE("downloaded_prefix_size");
-    const QString DOWNLOADED_SIZE("downloaded_size");
-    const QString IS_DOWNLODING_ACTIVE("is_downloading_active");
-    const QString IS_DOWNLODING_COMPELETED("is_downloading_completed");
-    const QString PATH("path");
-    const QString REMOTE("remote");
-    const QString IS_UPLOADING_ACTIVE("is_uploading_active");
-    const QString IS_UPLOADING_COMPLETED("is_uploading_completed");
-    const QString UNIQUE_ID("unique_id");
-    const QString UPLOADED_SIZE("uploaded_size");
-
-    const QString _TYPE("@type");
-    const QString TYPE_FILE("file");
-    const QString TYPE_LOCAL_FILE("localFile");
-    const QString TYPE_REMOTE_FILE("remoteFile");
-}
-
 // s(SignalName,signalName)
 #define QUEUED_SIGNALS(s) \
     s(TdLib,tdlib) \
@@ -95,7 +70,7 @@ TDLibFile::TDLibFile(TDLibWrapper *tdlib, const QVariantMap &fileInfo)
 {
     init();
     updateTDLibWrapper(tdlib);
-    updateFileInfo(fileInfo);
+    updateFileInfo(FileUpdate(fileInfo));
     // Reset queued signals
     firstQueuedSignal = SignalCount;
     queuedSignals = 0;
@@ -173,7 +148,7 @@ void TDLibFile::updateTDLibWrapper(TDLibWrapper* tdlib)
         }
         tdLibWrapper = tdlib;
         if (tdlib) {
-            connect(tdlib, SIGNAL(fileUpdated(int,QVariantMap)), SLOT(handleFileUpdated(int,QVariantMap)));
+            connect(tdlib, SIGNAL(fileUpdate(FileUpdate)), SLOT(handleFileUpdate(FileUpdate)));
             if (autoLoad) {
                 downloadFile();
             }
@@ -211,21 +186,27 @@ bool TDLibFile::load()
         killTimer(downloadHoldOffTimer);
         downloadHoldOffTimer = 0;
     }
-    return downloadFile();
+    // Somebody is waiting for this one, it shouldn't hold up the thumbnails
+    return downloadFile(TDLibWrapper::PriorityInteractive);
 }
 
-bool TDLibFile::downloadFile()
+bool TDLibFile::downloadFile(TDLibWrapper::RequestPriority priority)
 {
     if (id && tdLibWrapper && !downloadHoldOffTimer &&
         !is_downloading_active && !is_downloading_completed && can_be_downloaded) {
         downloadHoldOffTimer = startTimer(DownloadHoldOffMs);
-        tdLibWrapper->downloadFile(id);
+        tdLibWrapper->downloadFile(id, priority);
         return true;
     }
     return false;
 }
 
 void TDLibFile::setFileInfo(const QVariantMap &fileInfo)
+{
+    setFileInfo(FileUpdate(fileInfo));
+}
+
+void TDLibFile::setFileInfo(const FileUpdate &fileInfo)
 {
     updateFileInfo(fileInfo);
     if (is_downloading_completed && downloadHoldOffTimer) {
@@ -248,10 +229,10 @@ void TDLibFile::timerEvent(QTimerEvent *)
     }
 }
 
-void TDLibFile::handleFileUpdated(int fileId, const QVariantMap &fileInfo)
+void TDLibFile::handleFileUpdate(const FileUpdate &fileInfo)
 {
-    if (id == fileId) {
-        LOG("File" << fileId << "updated");
+    if (id == fileInfo.id) {
+        LOG("File" << fileInfo.id << "updated");
         setFileInfo(fileInfo);
         emitQueuedSignals();
     }
@@ -285,120 +266,100 @@ void TDLibFile::handleFileUpdated(int fileId, const QVariantMap &fileInfo)
 }
 */
 
-void TDLibFile::updateFileInfo(const QVariantMap &file)
+void TDLibFile::updateFileInfo(const FileUpdate &file)
 {
-    if (file.value(_TYPE).toString() == TYPE_FILE) {
-        QString s;
-        qlonglong ll;
-        bool b, fileChanged = false;
-        int i = file.value(ID).toInt();
-        if (id != i) {
-            LOG("File id has changed" << id << "=>" << i);
-            id = i;
+    if (file.isValid) {
+        bool fileChanged = false;
+        if (id != file.id) {
+            LOG("File id has changed" << id << "=>" << file.id);
+            id = file.id;
             fileChanged = true;
             queueSignal(SignalIdChanged);
         }
-        ll = file.value(EXPECTED_SIZE).toLongLong();
-        if (expected_size != ll) {
-            expected_size = ll;
+        if (expected_size != file.expectedSize) {
+            expected_size = file.expectedSize;
             fileChanged = true;
             queueSignal(SignalExpectedSizeChanged);
         }
-        ll = file.value(SIZE).toLongLong();
-        if (size != ll) {
-            size = ll;
+        if (size != file.size) {
+            size = file.size;
             fileChanged = true;
             queueSignal(SignalSizeChanged);
         }
 
-        const QVariantMap local(file.value(LOCAL).toMap());
-        if (local.value(_TYPE).toString() == TYPE_LOCAL_FILE) {
-            ll = local.value(DOWNLOAD_OFFSET).toLongLong();
-            if (download_offset != ll) {
-                download_offset = ll;
+        if (file.hasLocal) {
+            if (download_offset != file.downloadOffset) {
+                download_offset = file.downloadOffset;
                 fileChanged = true;
                 queueSignal(SignalDownloadOffsetChanged);
             }
-            ll = local.value(DOWNLOADED_PREFIX_SIZE).toLongLong();
-            if (downloaded_prefix_size != ll) {
-                downloaded_prefix_size = ll;
+            if (downloaded_prefix_size != file.downloadedPrefixSize) {
+                downloaded_prefix_size = file.downloadedPrefixSize;
                 fileChanged = true;
                 queueSignal(SignalDownloadedPrefixSizeChanged);
             }
-            ll = local.value(DOWNLOADED_SIZE).toLongLong();
-            if (downloaded_size != ll) {
-                downloaded_size = ll;
+            if (downloaded_size != file.downloadedSize) {
+                downloaded_size = file.downloadedSize;
                 fileChanged = true;
                 queueSignal(SignalDownloadedSizeChanged);
             }
-            b = local.value(CAN_BE_DELETED).toBool();
-            if (can_be_deleted != b) {
-                can_be_deleted = b;
+            if (can_be_deleted != file.canBeDeleted) {
+                can_be_deleted = file.canBeDeleted;
                 fileChanged = true;
                 queueSignal(SignalCanBeDeletedChanged);
             }
-            b = local.value(CAN_BE_DOWNLOADED).toBool();
-            if (can_be_downloaded != b) {
-                can_be_downloaded = b;
+            if (can_be_downloaded != file.canBeDownloaded) {
+                can_be_downloaded = file.canBeDownloaded;
                 fileChanged = true;
                 queueSignal(SignalCanBeDownloadedChanged);
             }
-            b = local.value(IS_DOWNLODING_ACTIVE).toBool();
-            if (is_downloading_active != b) {
-                is_downloading_active = b;
+            if (is_downloading_active != file.isDownloadingActive) {
+                is_downloading_active = file.isDownloadingActive;
                 fileChanged = true;
                 queueSignal(SignalDownloadingActiveChanged);
             }
-            b = local.value(IS_DOWNLODING_COMPELETED).toBool();
-            if (is_downloading_completed != b) {
-                is_downloading_completed = b;
+            if (is_downloading_completed != file.isDownloadingCompleted) {
+                is_downloading_completed = file.isDownloadingCompleted;
                 fileChanged = true;
                 queueSignal(SignalDownloadingCompletedChanged);
             }
-            s = local.value(PATH).toString();
-            if (path != s) {
-                path = s;
+            if (path != file.path) {
+                path = file.path;
                 fileChanged = true;
                 queueSignal(SignalPathChanged);
             }
         }
 
-        const QVariantMap remote(file.value(REMOTE).toMap());
-        if (remote.value(_TYPE).toString() == TYPE_REMOTE_FILE) {
-            ll = file.value(UPLOADED_SIZE).toLongLong();
-            if (uploaded_size != ll) {
-                uploaded_size = ll;
+        if (file.hasRemote) {
+            if (uploaded_size != file.uploadedSize) {
+                uploaded_size = file.uploadedSize;
                 fileChanged = true;
                 queueSignal(SignalUploadedSizeChanged);
             }
-            b = file.value(IS_UPLOADING_ACTIVE).toBool();
-            if (is_uploading_active != b) {
-                is_uploading_active = b;
+            if (is_uploading_active != file.isUploadingActive) {
+                is_uploading_active = file.isUploadingActive;
                 fileChanged = true;
                 queueSignal(SignalUploadingActiveChanged);
             }
-            b = file.value(IS_UPLOADING_COMPLETED).toBool();
-            if (is_uploading_completed != b) {
-                is_uploading_completed = b;
+            if (is_uploading_completed != file.isUploadingCompleted) {
+                is_uploading_completed = file.isUploadingCompleted;
                 fileChanged = true;
                 queueSignal(SignalUploadingCompletedChanged);
             }
-            s = local.value(ID).toString();
-            if (remote_id != s) {
-                remote_id = s;
+            if (remote_id != file.remoteId) {
+                remote_id = file.remoteId;
                 fileChanged = true;
                 queueSignal(SignalRemoteIdChanged);
             }
-            s = local.value(UNIQUE_ID).toString();
-            if (unique_id != s) {
-                unique_id = s;
+            if (unique_id != file.uniqueId) {
+                unique_id = file.uniqueId;
                 fileChanged = true;
                 queueSignal(SignalUniqueIdChanged);
             }
         }
 
         if (fileChanged) {
-            infoMap = file;
+            infoMap = file.file;
             queueSignal(SignalFileInfoChanged);
         }
     }
@@ -21,6 +21,7 @@
 #define TDLIBFILE_H
 
 #include "tdlibwrapper.h"
+#include "tdlibupdates.h"
 
 class TDLibFile : public QObject
 {
@@ -57,6 +58,7 @@ public:
 
     const QVariantMap &getFileInfo() const;
     void setFileInfo(const QVariantMap &fileInfo);
+    void setFileInfo(const FileUpdate &fileInfo);
 
     bool isAutoLoad() const;
     void setAutoLoad(bool autoLoad);
@@ -103,7 +105,7 @@ signals:
     void uploadingCompletedChanged();
 
 private slots:
-    void handleFileUpdated(int fileId, const QVariantMap &fileInfo);
+    void handleFileUpdate(const FileUpdate &fileInfo);
 
 protected:
     void timerEvent(QTimerEvent *event) Q_DECL_OVERRIDE;
@@ -111,8 +113,8 @@ protected:
 private:
     void init();
     void updateTDLibWrapper(TDLibWrapper* tdlib);
-    void updateFileInfo(const QVariantMap &fileInfo);
-    bool downloadFile();
+    void updateFileInfo(const FileUpdate &fileInfo);
+    bool downloadFile(TDLibWrapper::RequestPriority priority = TDLibWrapper::PriorityVisibleMedia);
     void queueSignal(uint signal);
     void emitQueuedSignals();
 
@@ -17,6 +17,15 @@
     along with Fernschreiber. If not, see <http://www.gnu.org/licenses/>.
 */
 #include "tdlibreceiver.h"
+#include "tdlibrecording.h"
+#include "tdlibrequestqueue.h"
+#include "tdlibresponse.h"
+
+#include <QMutexLocker>
+#include <QRunnable>
+#include <QThread>
+#include <QThreadPool>
+#include <QtAlgorithms>
 
 #define DEBUG_MODULE TDLibReceiver
 #include "debuglog.h"
@@ -38,7 +47,6 @@ namespace {
     const QString POSITIONS("positions");
     const QString PHOTO("photo");
     const QString ORDER("order");
-    const QString IS_PINNED("is_pinned");
     const QString BASIC_GROUP("basic_group");
     const QString SUPERGROUP("supergroup");
     const QString LAST_MESSAGE("last_message");
@@ -71,6 +79,8 @@ namespace {
 
     const QString _TYPE("@type");
     const QString _EXTRA("@extra");
+    // Pseudo type of the responses routed to a TDLibResponse
+    const QString RESPONSE("@response");
     const QString TYPE_CHAT_POSITION("chatPosition");
     const QString TYPE_CHAT_LIST_MAIN("chatListMain");
     const QString TYPE_STICKER_SET_INFO("stickerSetInfo");
@@ -83,8 +93,39 @@ namespace {
     const QString TYPE_ANIMATED_EMOJI("animatedEmoji");
     const QString TYPE_INPUT_MESSAGE_REPLY_TO_MESSAGE("inputMessageReplyToMessage");
     const QString TYPE_DRAFT_MESSAGE("draftMessage");
+    const QString TYPE_UPDATE_USER_STATUS("updateUserStatus");
+    const QString TYPE_UPDATE_CHAT_ONLINE_MEMBER_COUNT("updateChatOnlineMemberCount");
+    const QString TYPE_UPDATE_FILE("updateFile");
+    const QString TYPE_UPDATE_CHAT_POSITION("updateChatPosition");
+    const QString TYPE_UPDATE_CHAT_READ_INBOX("updateChatReadInbox");
+    const QString TYPE_UPDATE_NEW_MESSAGE("updateNewMessage");
+    const QString TYPE_MESSAGES("messages");
+    const QString TYPE_FOUND_CHAT_MESSAGES("foundChatMessages");
+    const QString TYPE_UPDATE_AUTHORIZATION_STATE("updateAuthorizationState");
+
+    const int DEFAULT_MAX_BATCH_SIZE = 100;
+    const int DEFAULT_MAX_BATCH_LATENCY = 16; // ms, roughly one frame
+    const int POWERSAVING_MAX_BATCH_LATENCY = 250; // ms
+    const int MAX_SIGNAL_ARGUMENTS = 10; // What QMetaMethod::invoke takes
+
+    // Receive timeouts (in seconds) when there's nothing to do. In the
+    // background the timeout doubles with every idle wakeup up to the limit.
+    const double WAIT_TIMEOUT = 5.0;
+    const double POWERSAVING_MAX_WAIT_TIMEOUT = 30.0;
+    const double DISPLAY_OFF_MAX_WAIT_TIMEOUT = 120.0;
+
+    // Documents of this size and larger are decoded by the worker pool,
+    // smaller ones are quicker to decode than to hand over
+    const int PARALLEL_DECODE_THRESHOLD = 8192;
+    const int MAX_DECODE_THREADS = 3;
+    const int DECODE_POLL_INTERVAL = 1; // ms, receive timeout while waiting for the workers
 
-    const double POWERSAVING_TDLIB_REQUEST_INTERVAL = 100;
+    // Ordering keys, see getOrderingKey()
+    const QString ORDERING_KEY_ANY(""); // Must stay in order with everything
+    const QString ORDERING_KEY_NONE("*"); // Doesn't depend on anything
+
+    // Cheap request which makes td_receive return right away
+    const char WAKEUP_REQUEST[] = "{\"@type\":\"getOption\",\"name\":\"version\",\"@extra\":\"wakeup\"}";
 }
 
 static QString getChatPositionOrder(const QVariantMap &position)
@@ -108,10 +149,447 @@ static QString findChatPositionOrder(const QVariantList &positions)
     return QString();
 }
 
-TDLibReceiver::TDLibReceiver(void *tdLibClient, QObject *parent) : QThread(parent)
+static inline bool isJsonSpace(char c)
+{
+    return c == ' ' || c == '\t' || c == '\n' || c == '\r';
+}
+
+static const char *skipJsonString(const char *ptr, const char *end)
+{
+    // ptr points right after the opening quote
+    while (ptr < end && *ptr != '"') {
+        if (*ptr == '\\') {
+            ptr++;
+        }
+        ptr++;
+    }
+    return ptr;
+}
+
+// Fetches the value of a top level key straight from the raw JSON buffer,
+// without building the document. Strings are returned without quotes and
+// with escape sequences untouched, which is good enough for type names and
+// ids. Returns a null array if the key isn't there or its value is not a
+// scalar. With depth > 1 it looks at the first nested object at that depth
+// which has this key, e.g. depth 2 for the message in updateNewMessage.
+static QByteArray peekValue(const QByteArray &json, const char *key, int targetDepth)
+{
+    const int keyLength = qstrlen(key);
+    const char *ptr = json.constData();
+    const char *end = ptr + json.size();
+    bool expectKey = false;
+    int depth = 0;
+    while (ptr < end) {
+        switch (*ptr++) {
+        case '{':
+            expectKey = (++depth == targetDepth);
+            break;
+        case '[':
+            depth++;
+            break;
+        case '}':
+        case ']':
+            if (--depth <= 0) {
+                return QByteArray();
+            }
+            break;
+        case ',':
+            expectKey = (depth == targetDepth);
+            break;
+        case '"':
+        {
+            const char *start = ptr;
+            ptr = skipJsonString(ptr, end);
+            if (ptr >= end) {
+                return QByteArray();
+            }
+            const int length = ptr++ - start;
+            if (expectKey) {
+                expectKey = false;
+                while (ptr < end && isJsonSpace(*ptr)) {
+                    ptr++;
+                }
+                // Strings in arrays may look like keys at this depth
+                if (ptr < end && *ptr == ':' && length == keyLength && !qstrncmp(start, key, length)) {
+                    ptr++;
+                    while (ptr < end && isJsonSpace(*ptr)) {
+                        ptr++;
+                    }
+                    if (ptr < end && *ptr == '"') {
+                        start = ++ptr;
+                        ptr = skipJsonString(ptr, end);
+                        return (ptr < end) ? QByteArray(start, ptr - start) : QByteArray();
+                    } else if (ptr < end && *ptr != '{' && *ptr != '[') {
+                        start = ptr;
+                        while (ptr < end && *ptr != ',' && *ptr != '}' && !isJsonSpace(*ptr)) {
+                            ptr++;
+                        }
+                        return QByteArray(start, ptr - start);
+                    }
+                    return QByteArray();
+                }
+            }
+            break;
+        }
+        default:
+            break;
+        }
+    }
+    return QByteArray();
+}
+
+static inline QByteArray peekTopLevelValue(const QByteArray &json, const char *key)
+{
+    return peekValue(json, key, 1);
+}
+
+static int peekClientId(const QByteArray &json)
+{
+    // TDLib appends it to every object, so look at the end first
+    static const char key[] = "\"@client_id\":";
+    const int keyLength = sizeof(key) - 1;
+    const int pos = json.indexOf(key, qMax(json.size() - keyLength - 16, 0));
+    if (pos >= 0) {
+        int clientId = 0;
+        for (const char *ptr = json.constData() + pos + keyLength; *ptr >= '0' && *ptr <= '9'; ptr++) {
+            clientId = clientId * 10 + (*ptr - '0');
+        }
+        return clientId;
+    }
+    return peekTopLevelValue(json, "@client_id").toInt();
+}
+
+// Documents with different ordering keys may be delivered in a different
+// order than they have been received. Those which concern one particular
+// chat (or user) only need to stay in order with the others for the same
+// chat, sticker sets don't care about anything. Everything else keeps the
+// original order.
+static QString getOrderingKey(const QString &type, const QByteArray &json)
+{
+    QByteArray id;
+    if (type == TYPE_STICKER_SET || type == "stickerSets" || type == "stickers" ||
+        type == "updateInstalledStickerSets" || type == "updateRecentStickers") {
+        return ORDERING_KEY_NONE;
+    } else if (type == TYPE_UPDATE_USER_STATUS) {
+        id = peekTopLevelValue(json, "user_id");
+        return id.isEmpty() ? ORDERING_KEY_ANY : QString("user:" + id);
+    } else if (type == TYPE_UPDATE_NEW_MESSAGE) {
+        id = peekValue(json, "chat_id", 2);
+    } else if (type == TYPE_MESSAGES || type == TYPE_FOUND_CHAT_MESSAGES) {
+        // All messages come from the same chat
+        id = peekValue(json, "chat_id", 3);
+    } else if (type.startsWith("updateChat") || type.startsWith("updateMessage") ||
+        type == TYPE_MESSAGE || type == "updateDeleteMessages") {
+        id = peekTopLevelValue(json, "chat_id");
+    }
+    return id.isEmpty() ? ORDERING_KEY_ANY : QString("chat:" + id);
+}
+
+static bool mustFollow(const QString &key, const QString &earlierKey)
+{
+    return key != ORDERING_KEY_NONE && earlierKey != ORDERING_KEY_NONE &&
+        (key == ORDERING_KEY_ANY || earlierKey == ORDERING_KEY_ANY || key == earlierKey);
+}
+
+// Some updates carry the complete new state of a single object, and only
+// the last one of those matters. Returns the key identifying that object,
+// or an empty string if the update has to be delivered as is.
+static QString getCoalescingKey(const QString &type, const QVariantMap &receivedInformation)
+{
+    if (type == TYPE_UPDATE_USER_STATUS) {
+        return type + QLatin1Char(':') + receivedInformation.value(USER_ID).toString();
+    } else if (type == TYPE_UPDATE_CHAT_ONLINE_MEMBER_COUNT || type == TYPE_UPDATE_CHAT_READ_INBOX) {
+        return type + QLatin1Char(':') + receivedInformation.value(CHAT_ID).toString();
+    } else if (type == TYPE_UPDATE_FILE) {
+        return type + QLatin1Char(':') + receivedInformation.value("file").toMap().value(ID).toString();
+    } else if (type == TYPE_UPDATE_CHAT_POSITION) {
+        const QVariantMap list(receivedInformation.value(POSITION).toMap().value(LIST).toMap());
+        return type + QLatin1Char(':') + receivedInformation.value(CHAT_ID).toString() +
+            QLatin1Char(':') + list.value(_TYPE).toString() +
+            QLatin1Char(':') + list.value("chat_folder_id").toString();
+    }
+    return QString();
+}
+
+class TDLibReceiver::DecodeTask : public QRunnable
+{
+public:
+    DecodeTask(TDLibReceiver *r, DecodeJob *j) : receiver(r), job(j) {}
+    void run() Q_DECL_OVERRIDE {
+        receiver->decodeJob(job);
+    }
+private:
+    TDLibReceiver *receiver;
+    DecodeJob *job;
+};
+
+// The one thread which receives from TDLib on behalf of all clients
+class TDLibReceiver::Loop : public QThread
+{
+public:
+    static Loop *instance();
+
+    void attach(TDLibReceiver *receiver);
+    void detach(TDLibReceiver *receiver);
+    bool setRecordingFile(const QString &path);
+    bool setReplayFile(TDLibReceiver *receiver, const QString &path, double speed);
+
+protected:
+    void run() Q_DECL_OVERRIDE;
+
+private:
+    Loop();
+    const char *receive(double timeout);
+    TDLibReceiver *findReceiver(const QByteArray &json) const;
+    double maxIdleTimeout() const;
+
+public:
+    // Read by the main thread
+    QAtomicInt wakeupCount;
+    QAtomicInt idleWakeupCount;
+    QAtomicInt lastDrainTime;
+    QAtomicInt longestDrainTime;
+
+private:
+    // Receivers are only touched with the mutex locked, which makes it
+    // safe to detach them at any time
+    QMutex mutex;
+    QHash<int, TDLibReceiver*> receivers;
+    bool running;
+    double idleTimeout;
+    // The recording (or replay) is set up before the thread gets started
+    TDLibRecorder *recorder;
+    TDLibPlayer *player;
+    TDLibReceiver *replayReceiver;
+};
+
+TDLibReceiver::Loop::Loop() :
+    wakeupCount(0),
+    idleWakeupCount(0),
+    lastDrainTime(0),
+    longestDrainTime(0),
+    running(false),
+    idleTimeout(WAIT_TIMEOUT),
+    recorder(Q_NULLPTR),
+    player(Q_NULLPTR),
+    replayReceiver(Q_NULLPTR)
+{
+}
+
+TDLibReceiver::Loop *TDLibReceiver::Loop::instance()
+{
+    // Never deleted, td_receive is global anyway
+    static Loop *loop = Q_NULLPTR;
+    if (!loop) {
+        loop = new Loop;
+    }
+    return loop;
+}
+
+void TDLibReceiver::Loop::attach(TDLibReceiver *receiver)
+{
+    QMutexLocker locker(&mutex);
+    receivers.insert(receiver->clientId, receiver);
+    if (!running) {
+        // The previous run may still be on its way out
+        locker.unlock();
+        wait();
+        locker.relock();
+        running = true;
+        start();
+    }
+}
+
+void TDLibReceiver::Loop::detach(TDLibReceiver *receiver)
+{
+    QMutexLocker locker(&mutex);
+    receivers.remove(receiver->clientId);
+    if (replayReceiver == receiver) {
+        replayReceiver = Q_NULLPTR;
+    }
+    if (!player && (receivers.isEmpty() || idleTimeout > WAIT_TIMEOUT)) {
+        // Don't keep anyone waiting for the backed off timeout to expire.
+        // Even a closed client responds (with an error).
+        td_send(receiver->clientId, WAKEUP_REQUEST);
+    }
+}
+
+bool TDLibReceiver::Loop::setRecordingFile(const QString &path)
 {
-    this->tdLibClient = tdLibClient;
-    this->isActive = true;
+    QMutexLocker locker(&mutex);
+    if (running) {
+        WARN("Can't start recording, already receiving");
+        return false;
+    }
+    delete recorder;
+    recorder = new TDLibRecorder(path);
+    if (recorder->isOpen()) {
+        WARN("Recorded updates contain private data, handle" << path << "with care");
+        return true;
+    }
+    delete recorder;
+    recorder = Q_NULLPTR;
+    return false;
+}
+
+bool TDLibReceiver::Loop::setReplayFile(TDLibReceiver *receiver, const QString &path, double speed)
+{
+    QMutexLocker locker(&mutex);
+    if (running) {
+        WARN("Can't start replay, already receiving");
+        return false;
+    }
+    delete player;
+    player = new TDLibPlayer(path, speed);
+    if (player->isOpen()) {
+        // Everything goes to this receiver, whatever the client id
+        replayReceiver = receiver;
+        return true;
+    }
+    delete player;
+    player = Q_NULLPTR;
+    return false;
+}
+
+double TDLibReceiver::Loop::maxIdleTimeout() const
+{
+    double timeout = DISPLAY_OFF_MAX_WAIT_TIMEOUT;
+    for (const TDLibReceiver *receiver : receivers) {
+        timeout = qMin(timeout, receiver->maxIdleTimeout());
+    }
+    return timeout;
+}
+
+TDLibReceiver *TDLibReceiver::Loop::findReceiver(const QByteArray &json) const
+{
+    if (player) {
+        return replayReceiver;
+    }
+    TDLibReceiver *receiver = receivers.value(peekClientId(json));
+    if (!receiver) {
+        // E.g. the response to the wakeup request sent to a closed client
+        VERBOSE("No receiver for" << json.constData());
+    }
+    return receiver;
+}
+
+void TDLibReceiver::Loop::run()
+{
+    LOG("Starting receiver loop");
+    QElapsedTimer drainTimer;
+    bool draining = false;
+    const char *result = Q_NULLPTR;
+    QMutexLocker locker(&mutex);
+    while (!receivers.isEmpty()) {
+      // Drain the backlog as fast as we can but don't keep an open batch
+      // waiting for longer than its latency, nor the documents which the
+      // workers are done with. Once there's nothing left, block until
+      // something happens or the (backed off) timeout expires.
+      double timeout = (draining && result) ? 0 : idleTimeout;
+      for (const TDLibReceiver *receiver : receivers) {
+          const int batchTimeout = receiver->batchTimeout();
+          if (batchTimeout >= 0) {
+              timeout = qMin(timeout, batchTimeout / 1000.0);
+          }
+      }
+      locker.unlock();
+      result = receive(timeout);
+      locker.relock();
+      // Only a blocking receive is a wakeup, the drain passes aren't
+      const bool wakeup = (timeout > 0);
+      if (wakeup) {
+          this->wakeupCount.fetchAndAddRelaxed(1);
+      }
+      if (result) {
+          if (recorder) {
+              recorder->write(result);
+          }
+          if (!draining) {
+              draining = true;
+              drainTimer.start();
+          }
+          idleTimeout = WAIT_TIMEOUT;
+          // The buffer stays valid until the next td_receive call
+          const QByteArray json(QByteArray::fromRawData(result, qstrlen(result)));
+          TDLibReceiver *receiver = findReceiver(json);
+          if (receiver) {
+              receiver->processReceivedDocument(json);
+          }
+      } else if (draining) {
+          bool busy = false;
+          for (const TDLibReceiver *receiver : receivers) {
+              busy |= receiver->hasPendingDocuments() || receiver->hasOpenBatch();
+          }
+          if (!busy) {
+              draining = false;
+              const int drainTime = int(drainTimer.elapsed());
+              this->lastDrainTime.store(drainTime);
+              this->longestDrainTime.store(qMax(this->longestDrainTime.load(), drainTime));
+              VERBOSE("Backlog drained in" << drainTime << "ms");
+          }
+      } else {
+          if (wakeup) {
+              this->idleWakeupCount.fetchAndAddRelaxed(1);
+          }
+          idleTimeout = qMin(idleTimeout * 2, maxIdleTimeout());
+          VERBOSE("Idle, next timeout" << idleTimeout << "s");
+      }
+      if (recorder && !draining) {
+          // Don't keep what has been recorded in memory while it's quiet
+          recorder->idle();
+      }
+      for (TDLibReceiver *receiver : receivers) {
+          receiver->flushCurrentBatch(!result);
+      }
+    }
+    running = false;
+    // Recording and replay only cover one run
+    if (recorder) {
+        recorder->close();
+        delete recorder;
+        recorder = Q_NULLPTR;
+    }
+    delete player;
+    player = Q_NULLPTR;
+    replayReceiver = Q_NULLPTR;
+    LOG("Stopping receiver loop");
+}
+
+const char *TDLibReceiver::Loop::receive(double timeout)
+{
+    return player ? player->next(timeout) : td_receive(timeout);
+}
+
+thread_local QVector<TDLibReceiver::PendingSignal> *TDLibReceiver::emitTarget = Q_NULLPTR;
+
+TDLibReceiver::TDLibReceiver(int clientId, QObject *parent) : QObject(parent)
+{
+    this->clientId = clientId;
+    this->isActive = false;
+    this->powerSavingMode.store(false);
+    this->displayOn.store(true);
+    this->batchDelivery.store(true);
+    this->maxBatchSize.store(DEFAULT_MAX_BATCH_SIZE);
+    this->maxBatchLatency.store(DEFAULT_MAX_BATCH_LATENCY);
+    this->currentBatchUpdates = 0;
+    this->deliveryScheduled = false;
+    this->deliveredBatchCount.store(0);
+    this->deliveredUpdateCount.store(0);
+    this->lastBatchSize.store(0);
+    this->largestBatchSize.store(0);
+    this->coalescedUpdateCount.store(0);
+    this->parallelDecodeCount.store(0);
+    this->reorderedCount.store(0);
+
+    // Leave one core for the receiver thread and one for the UI
+    const int decodeThreads = qMin(QThread::idealThreadCount() - 2, MAX_DECODE_THREADS);
+    if (decodeThreads > 0) {
+        LOG("Decoding large documents on" << decodeThreads << "threads");
+        this->decodePool = new QThreadPool;
+        this->decodePool->setMaxThreadCount(decodeThreads);
+    } else {
+        this->decodePool = Q_NULLPTR;
+    }
 
     handlers.insert("updateOption", &TDLibReceiver::processUpdateOption);
     handlers.insert("updateAuthorizationState", &TDLibReceiver::processUpdateAuthorizationState);
@@ -188,55 +666,524 @@ TDLibReceiver::TDLibReceiver(void *tdLibClient, QObject *parent) : QThread(paren
     handlers.insert("updateChatUnreadMentionCount", &TDLibReceiver::processUpdateChatUnreadMentionCount);
     handlers.insert("updateChatUnreadReactionCount", &TDLibReceiver::processUpdateChatUnreadReactionCount);
     handlers.insert("updateActiveEmojiReactions", &TDLibReceiver::processUpdateActiveEmojiReactions);
+    handlers.insert(RESPONSE, &TDLibReceiver::processResponse);
+
+    const QStringList types(handlers.keys());
+    for (const QString &type : types) {
+        typeStatistics.insert(type, new TypeStatistics);
+    }
+    clock.start();
+}
+
+TDLibReceiver::~TDLibReceiver()
+{
+    setActive(false);
+    delete decodePool;
+    qDeleteAll(typeStatistics);
+}
+
+void TDLibReceiver::start()
+{
+    setActive(true);
 }
 
 void TDLibReceiver::setActive(bool active)
 {
-    if (active) {
-        LOG("Activating receiver loop...");
-    } else {
-        LOG("Deactivating receiver loop, this may take a while...");
+    this->powerSavingMode.store(false);
+    if (active && !this->isActive) {
+        LOG("Activating receiver for client" << this->clientId);
+        this->isActive = true;
+        Loop::instance()->attach(this);
+    } else if (!active && this->isActive) {
+        LOG("Deactivating receiver for client" << this->clientId);
+        this->isActive = false;
+        // The loop doesn't touch this receiver once it's detached
+        Loop::instance()->detach(this);
+        discardPendingUpdates();
+    }
+}
+
+bool TDLibReceiver::isClosed() const
+{
+    return this->closed.load();
+}
+
+bool TDLibReceiver::setRecordingFile(const QString &path)
+{
+    return Loop::instance()->setRecordingFile(path);
+}
+
+bool TDLibReceiver::setReplayFile(const QString &path, double speed)
+{
+    return Loop::instance()->setReplayFile(this, path, speed);
+}
+
+void TDLibReceiver::replayResponse(const QVariantMap &response)
+{
+    Handler handler = handlers.value(response.value(_TYPE).toString());
+    if (handler) {
+        QVector<PendingSignal> emitted;
+        emitTarget = &emitted;
+        (this->*handler)(response);
+        emitTarget = Q_NULLPTR;
+        for (const PendingSignal &pending : emitted) {
+            emitPendingSignal(pending);
+        }
     }
-    this->powerSavingMode = false;
-    this->isActive = active;
 }
 
 void TDLibReceiver::setPowerSavingMode(bool powerSavingMode)
 {
-    this->powerSavingMode = powerSavingMode;
+    LOG("Power saving mode" << powerSavingMode);
+    this->powerSavingMode.store(powerSavingMode);
 }
 
-void TDLibReceiver::receiverLoop()
+void TDLibReceiver::setDisplayOn(bool displayOn)
 {
-    LOG("Starting receiver loop");
-    const double WAIT_TIMEOUT = 5.0;
-    while (this->isActive) {
-      const char *result = td_json_client_receive(this->tdLibClient, WAIT_TIMEOUT);
-      if (result) {
-          QJsonDocument receivedJsonDocument = QJsonDocument::fromJson(QByteArray(result));
-          VERBOSE("Raw result:" << receivedJsonDocument.toJson(QJsonDocument::Indented).constData());
-          processReceivedDocument(receivedJsonDocument);
-      }
-      if(this->powerSavingMode) {
-          msleep(POWERSAVING_TDLIB_REQUEST_INTERVAL);
-      }
+    LOG("Display on" << displayOn);
+    this->displayOn.store(displayOn);
+}
+
+double TDLibReceiver::maxIdleTimeout() const
+{
+    return !this->powerSavingMode.load() ? WAIT_TIMEOUT :
+        this->displayOn.load() ? POWERSAVING_MAX_WAIT_TIMEOUT :
+        DISPLAY_OFF_MAX_WAIT_TIMEOUT;
+}
+
+int TDLibReceiver::batchTimeout() const
+{
+    // Milliseconds until the open batch has to go, -1 if there's none.
+    // Documents handed over to the workers are polled for.
+    int timeout = !currentBatch.isEmpty() ? qMax(0, batchLatency() - int(batchTimer.elapsed())) : -1;
+    if (!reorderBuffer.isEmpty()) {
+        timeout = (timeout < 0) ? DECODE_POLL_INTERVAL : qMin(timeout, DECODE_POLL_INTERVAL);
     }
-    LOG("Stopping receiver loop");
+    return timeout;
+}
+
+bool TDLibReceiver::hasOpenBatch() const
+{
+    return !currentBatch.isEmpty();
+}
+
+bool TDLibReceiver::hasPendingDocuments() const
+{
+    return !reorderBuffer.isEmpty();
 }
 
-void TDLibReceiver::processReceivedDocument(const QJsonDocument &receivedJsonDocument)
+int TDLibReceiver::batchLatency() const
 {
-    QVariantMap receivedInformation = receivedJsonDocument.object().toVariantMap();
-    QString objectTypeName = receivedInformation.value(_TYPE).toString();
+    // In the background there's no point in waking up the main thread
+    // every frame, let the updates pile up (and coalesce) for a while
+    const int maxLatency = this->maxBatchLatency.load();
+    return this->powerSavingMode.load() ? qMax(maxLatency, POWERSAVING_MAX_BATCH_LATENCY) : maxLatency;
+}
 
+void TDLibReceiver::setBatchDelivery(bool enabled)
+{
+    LOG("Batch delivery" << enabled);
+    this->batchDelivery.store(enabled);
+}
+
+void TDLibReceiver::setMaxBatchSize(int maxSize)
+{
+    LOG("Max batch size" << maxSize << "updates");
+    this->maxBatchSize.store(qMax(1, maxSize));
+}
+
+void TDLibReceiver::setMaxBatchLatency(int maxLatency)
+{
+    LOG("Max batch latency" << maxLatency << "ms");
+    this->maxBatchLatency.store(qMax(0, maxLatency));
+}
+
+int TDLibReceiver::getDeliveredBatchCount() const
+{
+    return this->deliveredBatchCount.load();
+}
+
+int TDLibReceiver::getDeliveredUpdateCount() const
+{
+    return this->deliveredUpdateCount.load();
+}
+
+int TDLibReceiver::getLastBatchSize() const
+{
+    return this->lastBatchSize.load();
+}
+
+int TDLibReceiver::getLargestBatchSize() const
+{
+    return this->largestBatchSize.load();
+}
+
+int TDLibReceiver::getCoalescedUpdateCount() const
+{
+    return this->coalescedUpdateCount.load();
+}
+
+int TDLibReceiver::getWakeupCount() const
+{
+    return Loop::instance()->wakeupCount.load();
+}
+
+int TDLibReceiver::getIdleWakeupCount() const
+{
+    return Loop::instance()->idleWakeupCount.load();
+}
+
+int TDLibReceiver::getLastDrainTime() const
+{
+    return Loop::instance()->lastDrainTime.load();
+}
+
+int TDLibReceiver::getLongestDrainTime() const
+{
+    return Loop::instance()->longestDrainTime.load();
+}
+
+int TDLibReceiver::getDecodeThreadCount() const
+{
+    return this->decodePool ? this->decodePool->maxThreadCount() : 0;
+}
+
+int TDLibReceiver::getParallelDecodeCount() const
+{
+    return this->parallelDecodeCount.load();
+}
+
+int TDLibReceiver::getReorderedCount() const
+{
+    return this->reorderedCount.load();
+}
+
+QVariantMap TDLibReceiver::statisticsToMap(const TypeStatistics &statistics)
+{
+    QVariantList parseHistogram;
+    QVariantList handlerHistogram;
+    QVariantList queueHistogram;
+    for (int i = 0; i < TypeStatistics::HistogramSize; i++) {
+        parseHistogram.append(statistics.parseHistogram[i].load());
+        handlerHistogram.append(statistics.handlerHistogram[i].load());
+        queueHistogram.append(statistics.queueHistogram[i].load());
+    }
+    QVariantMap map;
+    map.insert("count", statistics.count.load());
+    map.insert("parse_time", statistics.parseTime.load());
+    map.insert("handler_time", statistics.handlerTime.load());
+    map.insert("queue_time", statistics.queueTime.load());
+    map.insert("parse_histogram", parseHistogram);
+    map.insert("handler_histogram", handlerHistogram);
+    map.insert("queue_histogram", queueHistogram);
+    return map;
+}
+
+QVariantMap TDLibReceiver::getStatistics() const
+{
+    QVariantMap types;
+    QHashIterator<QString, TypeStatistics*> it(typeStatistics);
+    while (it.hasNext()) {
+        it.next();
+        if (it.value()->count.load()) {
+            types.insert(it.key(), statisticsToMap(*it.value()));
+        }
+    }
+    if (unhandledStatistics.count.load()) {
+        types.insert("unhandled", statisticsToMap(unhandledStatistics));
+    }
+
+    QVariantMap statistics;
+    statistics.insert("uptime", clock.elapsed());
+    statistics.insert("wakeups", getWakeupCount());
+    statistics.insert("idle_wakeups", getIdleWakeupCount());
+    statistics.insert("last_drain_time", getLastDrainTime());
+    statistics.insert("longest_drain_time", getLongestDrainTime());
+    statistics.insert("batches", getDeliveredBatchCount());
+    statistics.insert("batched_updates", getDeliveredUpdateCount());
+    statistics.insert("last_batch_size", getLastBatchSize());
+    statistics.insert("largest_batch_size", getLargestBatchSize());
+    statistics.insert("coalesced_updates", getCoalescedUpdateCount());
+    statistics.insert("decode_threads", getDecodeThreadCount());
+    statistics.insert("parallel_decodes", getParallelDecodeCount());
+    statistics.insert("reordered", getReorderedCount());
+    statistics.insert("types", types);
+    return statistics;
+}
+
+void TDLibReceiver::flushCurrentBatch(bool idle)
+{
+    if (!reorderBuffer.isEmpty()) {
+        releaseDecodedDocuments();
+    }
+    if (!currentBatch.isEmpty()) {
+        if (!batchTimer.isValid()) {
+            batchTimer.start();
+        }
+        if ((idle && reorderBuffer.isEmpty()) ||
+            this->currentBatchUpdates >= this->maxBatchSize.load() ||
+            batchTimer.elapsed() >= batchLatency()) {
+            queueCurrentBatch();
+            batchTimer.invalidate();
+        }
+    }
+}
+
+void TDLibReceiver::discardPendingUpdates()
+{
+    if (decodePool) {
+        decodePool->waitForDone();
+    }
+    qDeleteAll(reorderBuffer);
+    reorderBuffer.clear();
+    currentBatch.clear();
+    this->currentBatchUpdates = 0;
+    coalescingIndex.clear();
+    batchTimer.invalidate();
+}
+
+void TDLibReceiver::queueCurrentBatch()
+{
+    QMutexLocker locker(&pendingUpdatesMutex);
+    pendingUpdates += currentBatch;
+    currentBatch.clear();
+    this->currentBatchUpdates = 0;
+    coalescingIndex.clear();
+    if (!deliveryScheduled) {
+        // One event loop wakeup no matter how many batches pile up meanwhile
+        deliveryScheduled = true;
+        QMetaObject::invokeMethod(this, "deliverPendingUpdates", Qt::QueuedConnection);
+    }
+}
+
+void TDLibReceiver::deliverPendingUpdates()
+{
+    QVector<PendingSignal> updates;
+    pendingUpdatesMutex.lock();
+    updates.swap(pendingUpdates);
+    deliveryScheduled = false;
+    pendingUpdatesMutex.unlock();
+
+    const int count = updates.count();
+    int delivered = 0;
+
+    for (int i = 0; i < count && this->isActive; i++) {
+        const PendingSignal &pending = updates.at(i);
+        if (pending.signalIndex >= 0) {
+            if (pending.statistics) {
+                recordTime(pending.statistics->queueTime, pending.statistics->queueHistogram, clock.nsecsElapsed() - pending.received);
+                delivered++;
+            }
+            emitPendingSignal(pending);
+        }
+    }
+
+    this->deliveredBatchCount.fetchAndAddRelaxed(1);
+    this->deliveredUpdateCount.fetchAndAddRelaxed(delivered);
+    this->lastBatchSize.store(delivered);
+    this->largestBatchSize.store(qMax(this->largestBatchSize.load(), delivered));
+    VERBOSE("Delivered" << delivered << "updates in" << count << "signals");
+}
+
+void TDLibReceiver::emitPendingSignal(const PendingSignal &pending)
+{
+    // This object lives on the main thread, so the signal reaches
+    // TDLibWrapper directly rather than through the event queue
+    const QMetaMethod method(metaObject()->method(pending.signalIndex));
+    QGenericArgument arguments[MAX_SIGNAL_ARGUMENTS];
+    const int n = qMin(pending.arguments.count(), MAX_SIGNAL_ARGUMENTS);
+    for (int i = 0; i < n; i++) {
+        // QVariant::fromValue() doesn't wrap a QVariant into another one
+        const QVariant &argument = pending.arguments.at(i);
+        arguments[i] = (method.parameterType(i) == QMetaType::QVariant) ?
+            QGenericArgument("QVariant", &argument) :
+            QGenericArgument(argument.typeName(), argument.constData());
+    }
+    method.invoke(this, Qt::DirectConnection,
+        arguments[0], arguments[1], arguments[2], arguments[3], arguments[4],
+        arguments[5], arguments[6], arguments[7], arguments[8], arguments[9]);
+}
+
+void TDLibReceiver::recordTime(QAtomicInteger<qint64> &total, QAtomicInt *histogram, qint64 time)
+{
+    const quint32 us = quint32(qMin(time / 1000, qint64(0xffffffff)));
+    const int bucket = us ? qMin(31 - qCountLeadingZeroBits(us), int(TypeStatistics::HistogramSize - 1)) : 0;
+    total.fetchAndAddRelaxed(us);
+    histogram[bucket].fetchAndAddRelaxed(1);
+}
+
+void TDLibReceiver::callHandler(Handler handler, const QVariantMap &data, TypeStatistics *statistics, DecodeJob *job)
+{
+    const qint64 start = clock.nsecsElapsed();
+    emitTarget = &job->emitted;
+    (this->*handler)(data);
+    emitTarget = Q_NULLPTR;
+    if (!job->emitted.isEmpty()) {
+        PendingSignal &first = job->emitted.first();
+        first.statistics = statistics;
+        first.received = job->received;
+    }
+    recordTime(statistics->handlerTime, statistics->handlerHistogram, clock.nsecsElapsed() - start);
+}
+
+static QVariantMap decodeDocument(const QByteArray &receivedJson)
+{
+    QJsonDocument receivedJsonDocument = QJsonDocument::fromJson(receivedJson);
+    VERBOSE("Raw result:" << receivedJsonDocument.toJson(QJsonDocument::Indented).constData());
+    return receivedJsonDocument.object().toVariantMap();
+}
+
+void TDLibReceiver::processReceivedDocument(const QByteArray &receivedJson)
+{
+    const qint64 receivedAt = clock.nsecsElapsed();
+    // Peek at the type first, there's no point in building the whole
+    // variant tree for objects that nobody is going to look at.
+    const QString peekedTypeName(QString::fromUtf8(peekTopLevelValue(receivedJson, "@type")));
+    // Responses to queued requests have to be untagged and those with
+    // a TDLibResponse handle are handled whatever their type is
+    const QString peekedExtra(QString::fromUtf8(peekTopLevelValue(receivedJson, "@extra")));
+    if (!peekedTypeName.isEmpty() && !handlers.contains(peekedTypeName) &&
+        !TDLibRequestQueue::isTagged(peekedExtra) && !TDLibResponse::isResponseExtra(peekedExtra)) {
+        VERBOSE("Raw result:" << receivedJson.constData());
+        LOG("Unhandled object type" << peekedTypeName);
+        unhandledStatistics.count.fetchAndAddRelaxed(1);
+        recordTime(unhandledStatistics.parseTime, unhandledStatistics.parseHistogram, clock.nsecsElapsed() - receivedAt);
+        return;
+    }
+    if (peekedTypeName == TYPE_UPDATE_AUTHORIZATION_STATE && peekValue(receivedJson, "@type", 2) == "authorizationStateClosed") {
+        // This client id is done for good
+        this->closed.store(1);
+    }
+
+    const bool large = receivedJson.size() >= PARALLEL_DECODE_THRESHOLD;
+    if (decodePool && (large || !reorderBuffer.isEmpty())) {
+        DecodeJob *job = new DecodeJob(getOrderingKey(peekedTypeName, receivedJson), receivedAt);
+        reorderBuffer.append(job);
+        if (large) {
+            // The receive buffer only stays valid until the next call
+            VERBOSE("Decoding" << peekedTypeName << "in parallel," << receivedJson.size() << "bytes");
+            job->json = QByteArray(receivedJson.constData(), receivedJson.size());
+            this->parallelDecodeCount.fetchAndAddRelaxed(1);
+            decodePool->start(new DecodeTask(this, job));
+        } else {
+            const QVariantMap receivedInformation(decodeDocument(receivedJson));
+            job->decodedAt = clock.nsecsElapsed();
+            processDecodedDocument(receivedInformation, job);
+            QMutexLocker locker(&decodeMutex);
+            job->decoded = true;
+        }
+    } else {
+        DecodeJob job(ORDERING_KEY_ANY, receivedAt);
+        const QVariantMap receivedInformation(decodeDocument(receivedJson));
+        job.decodedAt = clock.nsecsElapsed();
+        processDecodedDocument(receivedInformation, &job);
+        queueSignals(&job);
+    }
+}
+
+void TDLibReceiver::decodeJob(DecodeJob *job)
+{
+    // Runs on one of the worker threads. The handler runs here too, it's
+    // the handlers of the large documents which do most of the cleanup.
+    const QVariantMap data(decodeDocument(job->json));
+    job->json.clear();
+    job->decodedAt = clock.nsecsElapsed();
+    processDecodedDocument(data, job);
+    QMutexLocker locker(&decodeMutex);
+    job->decoded = true;
+}
+
+void TDLibReceiver::releaseDecodedDocuments()
+{
+    // A decoded document goes out as soon as nothing received before it
+    // and still sitting in the buffer has to be delivered first
+    QList<DecodeJob*> released;
+    decodeMutex.lock();
+    for (int i = 0; i < reorderBuffer.count(); ) {
+        DecodeJob *job = reorderBuffer.at(i);
+        bool blocked = !job->decoded;
+        for (int j = 0; j < i && !blocked; j++) {
+            blocked = mustFollow(job->key, reorderBuffer.at(j)->key);
+        }
+        if (blocked) {
+            if (job->key == ORDERING_KEY_ANY) {
+                // Nothing can overtake this one
+                break;
+            }
+            i++;
+        } else {
+            if (i > 0) {
+                VERBOSE("Delivering" << job->key << "ahead of" << i << "documents");
+                this->reorderedCount.fetchAndAddRelaxed(1);
+            }
+            released.append(reorderBuffer.takeAt(i));
+        }
+    }
+    decodeMutex.unlock();
+
+    for (DecodeJob *job : released) {
+        queueSignals(job);
+        delete job;
+    }
+}
+
+void TDLibReceiver::processDecodedDocument(const QVariantMap &document, DecodeJob *job)
+{
+    QVariantMap receivedInformation(document);
+    qlonglong requestId;
+    if (TDLibRequestQueue::untag(receivedInformation, &requestId)) {
+        // Goes with the batch, ahead of whatever the handler emits, so that
+        // the main thread sees it in order with the updates which follow
+        emitTarget = &job->emitted;
+        // A file which is no longer downloading won't be followed by any
+        // updateFile, so only an active download may keep its slot
+        emitLater(&TDLibReceiver::queuedRequestCompleted, requestId, FileUpdate(receivedInformation).isDownloadingActive);
+        emitTarget = Q_NULLPTR;
+    }
+    // Responses to requests with a TDLibResponse handle bypass the type
+    // specific handlers, whatever their type is
+    const QString objectTypeName = TDLibResponse::isResponseExtra(receivedInformation.value(_EXTRA).toString()) ?
+        RESPONSE : receivedInformation.value(_TYPE).toString();
     Handler handler = handlers.value(objectTypeName);
+    TypeStatistics *statistics = handler ? typeStatistics.value(objectTypeName) : &unhandledStatistics;
+    statistics->count.fetchAndAddRelaxed(1);
+    recordTime(statistics->parseTime, statistics->parseHistogram, job->decodedAt - job->received);
     if (handler) {
-        (this->*handler)(receivedInformation);
+        job->coalescingKey = getCoalescingKey(objectTypeName, receivedInformation);
+        callHandler(handler, receivedInformation, statistics, job);
     } else {
         LOG("Unhandled object type" << objectTypeName);
     }
 }
 
+void TDLibReceiver::queueSignals(DecodeJob *job)
+{
+    if (job->emitted.isEmpty()) {
+        return;
+    }
+    const QString &key = job->coalescingKey;
+    if (!key.isEmpty()) {
+        // Drop the older update rather than overwriting it in place,
+        // that way the new state still arrives after whatever came
+        // in between (e.g. updateNewMessage)
+        const QPair<int,int> previous(coalescingIndex.value(key, qMakePair(-1, 0)));
+        if (previous.first >= 0) {
+            VERBOSE("Coalescing" << key);
+            for (int i = previous.first; i < previous.first + previous.second; i++) {
+                currentBatch[i].signalIndex = -1;
+                currentBatch[i].arguments.clear();
+            }
+            this->coalescedUpdateCount.fetchAndAddRelaxed(1);
+        }
+        coalescingIndex.insert(key, qMakePair(currentBatch.count(), job->emitted.count()));
+    }
+    currentBatch += job->emitted;
+    this->currentBatchUpdates++;
+    if (!this->batchDelivery.load()) {
+        queueCurrentBatch();
+    }
+}
+
 void TDLibReceiver::processUpdateOption(const QVariantMap &receivedInformation)
 {
     const QString currentOption = receivedInformation.value(NAME).toString();
@@ -244,10 +1191,10 @@ void TDLibReceiver::processUpdateOption(const QVariantMap &receivedInformation)
     if (currentOption == "version") {
         QString detectedVersion = value.toString();
         LOG("TD Lib version detected: " << detectedVersion);
-        emit versionDetected(detectedVersion);
+        emitLater(&TDLibReceiver::versionDetected, detectedVersion);
     } else {
         LOG("Option updated: " << currentOption << value);
-        emit optionUpdated(currentOption, value);
+        emitLater(&TDLibReceiver::optionUpdated, currentOption, value);
     }
 }
 
@@ -255,49 +1202,53 @@ void TDLibReceiver::processUpdateAuthorizationState(const QVariantMap &receivedI
 {
     QString authorizationState = receivedInformation.value("authorization_state").toMap().value(_TYPE).toString();
     LOG("Authorization state changed: " << authorizationState);
-    emit authorizationStateChanged(authorizationState, receivedInformation);
+    emitLater(&TDLibReceiver::authorizationStateChanged, authorizationState, receivedInformation);
 }
 
 void TDLibReceiver::processUpdateConnectionState(const QVariantMap &receivedInformation)
 {
     QString connectionState = receivedInformation.value("state").toMap().value(_TYPE).toString();
     LOG("Connection state changed: " << connectionState);
-    emit connectionStateChanged(connectionState);
+    emitLater(&TDLibReceiver::connectionStateChanged, connectionState);
 }
 
 void TDLibReceiver::processUpdateUser(const QVariantMap &receivedInformation)
 {
     QVariantMap userInformation = receivedInformation.value("user").toMap();
     VERBOSE("User was updated: " << userInformation.value("username").toString() << userInformation.value("first_name").toString() << userInformation.value("last_name").toString());
-    emit userUpdated(userInformation);
+    emitLater(&TDLibReceiver::userUpdated, userInformation);
 }
 
 void TDLibReceiver::processUpdateUserStatus(const QVariantMap &receivedInformation)
 {
-    const QString userId = receivedInformation.value(USER_ID).toString();
-    QVariantMap userStatusInformation = receivedInformation.value("status").toMap();
-    VERBOSE("User status was updated: " << receivedInformation.value(USER_ID).toString() << userStatusInformation.value(_TYPE).toString());
-    emit userStatusUpdated(userId, userStatusInformation);
+    UserStatusUpdate update;
+    update.userId = receivedInformation.value(USER_ID).toLongLong();
+    update.status = receivedInformation.value("status").toMap();
+    update.type = update.status.value(_TYPE).toString();
+    update.wasOnline = update.status.value("was_online").toLongLong();
+    VERBOSE("User status was updated: " << update.userId << update.type);
+    emitLater(&TDLibReceiver::userStatusUpdated, update);
 }
 
 void TDLibReceiver::processUpdateFile(const QVariantMap &receivedInformation)
 {
-    const QVariantMap fileInformation = receivedInformation.value("file").toMap();
-    LOG("File was updated: " << fileInformation.value(ID).toString());
-    emit fileUpdated(fileInformation);
+    const FileUpdate update(receivedInformation.value("file").toMap());
+    LOG("File was updated: " << update.id);
+    emitLater(&TDLibReceiver::fileUpdated, update);
 }
 
 void TDLibReceiver::processFile(const QVariantMap &receivedInformation)
 {
-    LOG("File was updated: " << receivedInformation.value(ID).toString());
-    emit fileUpdated(receivedInformation);
+    const FileUpdate update(receivedInformation);
+    LOG("File was updated: " << update.id);
+    emitLater(&TDLibReceiver::fileUpdated, update);
 }
 
 void TDLibReceiver::processUpdateNewChat(const QVariantMap &receivedInformation)
 {
     const QVariantMap chatInformation = receivedInformation.value("chat").toMap();
     LOG("New chat discovered: " << chatInformation.value(ID).toString() << chatInformation.value(TITLE).toString());
-    emit newChatDiscovered(chatInformation);
+    emitLater(&TDLibReceiver::newChatDiscovered, chatInformation);
 }
 
 void TDLibReceiver::processUpdateUnreadMessageCount(const QVariantMap &receivedInformation)
@@ -307,7 +1258,7 @@ void TDLibReceiver::processUpdateUnreadMessageCount(const QVariantMap &receivedI
     messageCountInformation.insert(UNREAD_COUNT, receivedInformation.value(UNREAD_COUNT));
     messageCountInformation.insert("unread_unmuted_count", receivedInformation.value("unread_unmuted_count"));
     LOG("Unread message count updated: " << messageCountInformation.value("chat_list_type").toString() << messageCountInformation.value(UNREAD_COUNT).toString());
-    emit unreadMessageCountUpdated(messageCountInformation);
+    emitLater(&TDLibReceiver::unreadMessageCountUpdated, messageCountInformation);
 }
 
 void TDLibReceiver::processUpdateUnreadChatCount(const QVariantMap &receivedInformation)
@@ -320,7 +1271,7 @@ void TDLibReceiver::processUpdateUnreadChatCount(const QVariantMap &receivedInfo
     chatCountInformation.insert(UNREAD_COUNT, receivedInformation.value(UNREAD_COUNT));
     chatCountInformation.insert("unread_unmuted_count", receivedInformation.value("unread_unmuted_count"));
     LOG("Unread chat count updated: " << chatCountInformation.value("chat_list_type").toString() << chatCountInformation.value(UNREAD_COUNT).toString());
-    emit unreadChatCountUpdated(chatCountInformation);
+    emitLater(&TDLibReceiver::unreadChatCountUpdated, chatCountInformation);
 }
 
 void TDLibReceiver::processUpdateChatFolders(const QVariantMap &receivedInformation)
@@ -328,27 +1279,32 @@ void TDLibReceiver::processUpdateChatFolders(const QVariantMap &receivedInformat
     const qlonglong mainChatPosition = receivedInformation.value(MAIN_CHAT_LIST_POSITION_IN_FOLDERS).toLongLong();
     const QVariantList folders(receivedInformation.value(CHAT_FOLDERS).toList());
     LOG("Received folder:" << folders.count() << ", main chat list position: " << mainChatPosition);
-    emit updateChatFolders(folders, mainChatPosition);
+    emitLater(&TDLibReceiver::updateChatFolders, folders, mainChatPosition);
 }
 
 void TDLibReceiver::processChatFolder(const QVariantMap &chatFolderInformation)
 {
     LOG("Received chatFolder information");
-    emit gotChatFolder(chatFolderInformation);
+    emitLater(&TDLibReceiver::gotChatFolder, chatFolderInformation);
 }
 
 void TDLibReceiver::processUpdateChatLastMessage(const QVariantMap &receivedInformation)
 {
-    const QString chat_id(receivedInformation.value(CHAT_ID).toString());
+    ChatLastMessageUpdate update;
+    update.chatId = receivedInformation.value(CHAT_ID).toLongLong();
     QString order;
     if (receivedInformation.contains(POSITIONS)) {
         order = findChatPositionOrder(receivedInformation.value(POSITIONS).toList());
     } else {
         order = receivedInformation.value(ORDER).toString();
     }
+    if (!order.isEmpty()) {
+        update.order = order.toLongLong();
+    }
     const QVariantMap lastMessage = receivedInformation.value(LAST_MESSAGE).toMap();
-    LOG("Last message of chat" << chat_id << "updated, order" << order << "type" << lastMessage.value(_TYPE).toString());
-    emit chatLastMessageUpdated(chat_id, order, cleanupMap(lastMessage));
+    LOG("Last message of chat" << update.chatId << "updated, order" << order << "type" << lastMessage.value(_TYPE).toString());
+    update.lastMessage = cleanupMap(lastMessage);
+    emitLater(&TDLibReceiver::chatLastMessageUpdated, update);
 }
 
 void TDLibReceiver::processUpdateChatOrder(const QVariantMap &receivedInformation)
@@ -356,42 +1312,35 @@ void TDLibReceiver::processUpdateChatOrder(const QVariantMap &receivedInformatio
     const QString chat_id(receivedInformation.value(CHAT_ID).toString());
     const QString order(receivedInformation.value(ORDER).toString());
     LOG("Chat order updated for ID" << chat_id << "to" << order);
-    emit chatOrderUpdated(chat_id, order);
+    emitLater(&TDLibReceiver::chatOrderUpdated, chat_id, order);
 }
 
 void TDLibReceiver::processUpdateChatPosition(const QVariantMap &receivedInformation)
 {
-    const QString chat_id(receivedInformation.value(CHAT_ID).toString());
-    QVariantMap positionMap = receivedInformation.value(POSITION).toMap();
-
-    QString updateForChatList = positionMap.value(LIST).toMap().value(_TYPE).toString();
-    const QString order(positionMap.value(ORDER).toString());
-    bool is_pinned = positionMap.value(IS_PINNED).toBool();
-
-    // We are only processing main chat list updates at the moment...
-    if (updateForChatList == "chatListMain") {
-        LOG("Chat position updated for ID" << chat_id << "new order" << order << "is pinned" << is_pinned);
-        emit chatOrderUpdated(chat_id, order);
-        emit chatPinnedUpdated(chat_id.toLongLong(), is_pinned);
-    } else {
-        LOG("Received chat position update for uninteresting list" << updateForChatList << "ID" << chat_id << "new order" << order << "is pinned" << is_pinned);
-    }
+    // Archive and chat folder positions are passed on too, the receivers
+    // which only care about the main list check chatListId
+    const ChatPositionUpdate update(receivedInformation.value(CHAT_ID).toLongLong(), receivedInformation.value(POSITION).toMap());
+    LOG("Chat position updated for ID" << update.chatId << "in list" << update.chatListId << "new order" << update.order << "is pinned" << update.isPinned);
+    emitLater(&TDLibReceiver::chatPositionUpdated, update);
 }
 
 void TDLibReceiver::processUpdateChatReadInbox(const QVariantMap &receivedInformation)
 {
-    const QString chat_id(receivedInformation.value(CHAT_ID).toString());
-    const QString unread_count(receivedInformation.value(UNREAD_COUNT).toString());
-    LOG("Chat read information updated for" << chat_id << "unread count:" << unread_count);
-    emit chatReadInboxUpdated(chat_id, receivedInformation.value(LAST_READ_INBOX_MESSAGE_ID).toString(), unread_count.toInt());
+    ChatReadInboxUpdate update;
+    update.chatId = receivedInformation.value(CHAT_ID).toLongLong();
+    update.lastReadInboxMessageId = receivedInformation.value(LAST_READ_INBOX_MESSAGE_ID).toLongLong();
+    update.unreadCount = receivedInformation.value(UNREAD_COUNT).toInt();
+    LOG("Chat read information updated for" << update.chatId << "unread count:" << update.unreadCount);
+    emitLater(&TDLibReceiver::chatReadInboxUpdated, update);
 }
 
 void TDLibReceiver::processUpdateChatReadOutbox(const QVariantMap &receivedInformation)
 {
-    const QString chat_id(receivedInformation.value(CHAT_ID).toString());
-    const QString last_read_outbox_message_id(receivedInformation.value(LAST_READ_OUTBOX_MESSAGE_ID).toString());
-    LOG("Sent messages read information updated for" << chat_id << "last read message ID:" << last_read_outbox_message_id);
-    emit chatReadOutboxUpdated(chat_id, last_read_outbox_message_id);
+    ChatReadOutboxUpdate update;
+    update.chatId = receivedInformation.value(CHAT_ID).toLongLong();
+    update.lastReadOutboxMessageId = receivedInformation.value(LAST_READ_OUTBOX_MESSAGE_ID).toLongLong();
+    LOG("Sent messages read information updated for" << update.chatId << "last read message ID:" << update.lastReadOutboxMessageId);
+    emitLater(&TDLibReceiver::chatReadOutboxUpdated, update);
 }
 
 void TDLibReceiver::processUpdateChatAvailableReactions(const QVariantMap &receivedInformation)
@@ -399,7 +1348,7 @@ void TDLibReceiver::processUpdateChatAvailableReactions(const QVariantMap &recei
     const qlonglong chat_id(receivedInformation.value(CHAT_ID).toLongLong());
     const QVariantMap available_reactions(receivedInformation.value(AVAILABLE_REACTIONS).toMap());
     LOG("Available reactions updated for" << chat_id << "new information:" << available_reactions);
-    emit chatAvailableReactionsUpdated(chat_id, available_reactions);
+    emitLater(&TDLibReceiver::chatAvailableReactionsUpdated, chat_id, available_reactions);
 }
 
 void TDLibReceiver::processUpdateBasicGroup(const QVariantMap &receivedInformation)
@@ -407,7 +1356,7 @@ void TDLibReceiver::processUpdateBasicGroup(const QVariantMap &receivedInformati
     const QVariantMap basicGroup(receivedInformation.value(BASIC_GROUP).toMap());
     const qlonglong basicGroupId = basicGroup.value(ID).toLongLong();
     LOG("Basic group information updated for " << basicGroupId);
-    emit basicGroupUpdated(basicGroupId, basicGroup);
+    emitLater(&TDLibReceiver::basicGroupUpdated, basicGroupId, basicGroup);
 }
 
 void TDLibReceiver::processUpdateSuperGroup(const QVariantMap &receivedInformation)
@@ -415,28 +1364,28 @@ void TDLibReceiver::processUpdateSuperGroup(const QVariantMap &receivedInformati
     const QVariantMap supergroup(receivedInformation.value(SUPERGROUP).toMap());
     const qlonglong superGroupId = supergroup.value(ID).toLongLong();
     LOG("Super group information updated for " << superGroupId);
-    emit superGroupUpdated(superGroupId, supergroup);
+    emitLater(&TDLibReceiver::superGroupUpdated, superGroupId, supergroup);
 }
 
 void TDLibReceiver::processChatOnlineMemberCountUpdated(const QVariantMap &receivedInformation)
 {
     const QString chatId = receivedInformation.value(CHAT_ID).toString();
     LOG("Online member count updated for chat " << chatId);
-    emit chatOnlineMemberCountUpdated(chatId, receivedInformation.value("online_member_count").toInt());
+    emitLater(&TDLibReceiver::chatOnlineMemberCountUpdated, chatId, receivedInformation.value("online_member_count").toInt());
 }
 
 void TDLibReceiver::processMessages(const QVariantMap &receivedInformation)
 {
     const int total_count = receivedInformation.value(TOTAL_COUNT).toInt();
     LOG("Received new messages, amount: " << total_count);
-    emit messagesReceived(cleanupList(receivedInformation.value(MESSAGES).toList()), total_count);
+    emitLater(&TDLibReceiver::messagesReceived, cleanupList(receivedInformation.value(MESSAGES).toList()), total_count);
 }
 
 void TDLibReceiver::processFoundChatMessages(const QVariantMap &receivedInformation)
 {
     const int total_count = receivedInformation.value(TOTAL_COUNT).toInt();
     LOG("Received found chat messages, amount: " << total_count);
-    emit messagesReceived(cleanupList(receivedInformation.value(MESSAGES).toList()), total_count);
+    emitLater(&TDLibReceiver::messagesReceived, cleanupList(receivedInformation.value(MESSAGES).toList()), total_count);
 }
 
 void TDLibReceiver::processSponsoredMessage(const QVariantMap &receivedInformation)
@@ -444,7 +1393,7 @@ void TDLibReceiver::processSponsoredMessage(const QVariantMap &receivedInformati
     // TdLib <= 1.8.7
     const qlonglong chatId = receivedInformation.value(_EXTRA).toLongLong(); // See TDLibWrapper::getChatSponsoredMessage
     LOG("Received sponsored message for chat" << chatId);
-    emit sponsoredMessageReceived(chatId, receivedInformation);
+    emitLater(&TDLibReceiver::sponsoredMessageReceived, chatId, receivedInformation);
 }
 
 void TDLibReceiver::processSponsoredMessages(const QVariantMap &receivedInformation)
@@ -455,7 +1404,7 @@ void TDLibReceiver::processSponsoredMessages(const QVariantMap &receivedInformat
     LOG("Received" << messages.count() << "sponsored messages for chat" << chatId);
     QListIterator<QVariant> it(messages);
     while (it.hasNext()) {
-        emit sponsoredMessageReceived(chatId, it.next().toMap());
+        emitLater(&TDLibReceiver::sponsoredMessageReceived, chatId, it.next().toMap());
     }
 }
 
@@ -464,7 +1413,7 @@ void TDLibReceiver::processUpdateNewMessage(const QVariantMap &receivedInformati
     const QVariantMap message = receivedInformation.value(MESSAGE).toMap();
     const qlonglong chatId = message.value(CHAT_ID).toLongLong();
     LOG("Received new message for chat" << chatId);
-    emit newMessageReceived(chatId, cleanupMap(message));
+    emitLater(&TDLibReceiver::newMessageReceived, chatId, cleanupMap(message));
 }
 
 void TDLibReceiver::processMessage(const QVariantMap &receivedInformation)
@@ -472,7 +1421,7 @@ void TDLibReceiver::processMessage(const QVariantMap &receivedInformation)
     const qlonglong chatId = receivedInformation.value(CHAT_ID).toLongLong();
     const qlonglong messageId = receivedInformation.value(ID).toLongLong();
     LOG("Received message " << chatId << messageId);
-    emit messageInformation(chatId, messageId, cleanupMap(receivedInformation));
+    emitLater(&TDLibReceiver::messageInformation, chatId, messageId, cleanupMap(receivedInformation));
 }
 
 void TDLibReceiver::processMessageLinkInfo(const QVariantMap &receivedInformation)
@@ -488,7 +1437,7 @@ void TDLibReceiver::processMessageLinkInfo(const QVariantMap &receivedInformatio
     } else {
         url = oldExtra;
     }
-    emit messageLinkInfoReceived(url, receivedInformation, extra);
+    emitLater(&TDLibReceiver::messageLinkInfoReceived, url, receivedInformation, extra);
 }
 
 void TDLibReceiver::processMessageSendSucceeded(const QVariantMap &receivedInformation)
@@ -497,32 +1446,32 @@ void TDLibReceiver::processMessageSendSucceeded(const QVariantMap &receivedInfor
     const QVariantMap message = receivedInformation.value(MESSAGE).toMap();
     const qlonglong messageId = message.value(ID).toLongLong();
     LOG("Message send succeeded" << messageId << oldMessageId);
-    emit messageSendSucceeded(messageId, oldMessageId, cleanupMap(message));
+    emitLater(&TDLibReceiver::messageSendSucceeded, messageId, oldMessageId, cleanupMap(message));
 }
 
 void TDLibReceiver::processUpdateActiveNotifications(const QVariantMap &receivedInformation)
 {
     LOG("Received active notification groups");
-    emit activeNotificationsUpdated(receivedInformation.value("groups").toList());
+    emitLater(&TDLibReceiver::activeNotificationsUpdated, receivedInformation.value("groups").toList());
 }
 
 void TDLibReceiver::processUpdateNotificationGroup(const QVariantMap &receivedInformation)
 {
     LOG("Received updated notification group");
-    emit notificationGroupUpdated(receivedInformation);
+    emitLater(&TDLibReceiver::notificationGroupUpdated, receivedInformation);
 }
 
 void TDLibReceiver::processUpdateNotification(const QVariantMap &receivedInformation)
 {
     LOG("Received notification update");
-    emit notificationUpdated(receivedInformation);
+    emitLater(&TDLibReceiver::notificationUpdated, receivedInformation);
 }
 
 void TDLibReceiver::processUpdateChatNotificationSettings(const QVariantMap &receivedInformation)
 {
     const QString chatId = receivedInformation.value(CHAT_ID).toString();
     LOG("Received new notification settings for chat " << chatId);
-    emit chatNotificationSettingsUpdated(chatId, receivedInformation.value("notification_settings").toMap());
+    emitLater(&TDLibReceiver::chatNotificationSettingsUpdated, chatId, receivedInformation.value("notification_settings").toMap());
 }
 
 void TDLibReceiver::processUpdateMessageContent(const QVariantMap &receivedInformation)
@@ -530,7 +1479,7 @@ void TDLibReceiver::processUpdateMessageContent(const QVariantMap &receivedInfor
     const qlonglong chatId = receivedInformation.value(CHAT_ID).toLongLong();
     const qlonglong messageId = receivedInformation.value(MESSAGE_ID).toLongLong();
     LOG("Message content updated" << chatId << messageId);
-    emit messageContentUpdated(chatId, messageId, cleanupMap(receivedInformation.value(NEW_CONTENT).toMap()));
+    emitLater(&TDLibReceiver::messageContentUpdated, chatId, messageId, cleanupMap(receivedInformation.value(NEW_CONTENT).toMap()));
 }
 
 void TDLibReceiver::processUpdateDeleteMessages(const QVariantMap &receivedInformation)
@@ -544,167 +1493,174 @@ void TDLibReceiver::processUpdateDeleteMessages(const QVariantMap &receivedInfor
         ids.append(messageIds.at(i).toLongLong());
     }
     LOG(n << "messages were deleted from chat" << chatId);
-    emit messagesDeleted(chatId, ids);
+    emitLater(&TDLibReceiver::messagesDeleted, chatId, ids);
 }
 
 void TDLibReceiver::processChats(const QVariantMap &receivedInformation)
 {
-    emit chats(receivedInformation);
+    emitLater(&TDLibReceiver::chats, receivedInformation);
 }
 
 void TDLibReceiver::processChat(const QVariantMap &receivedInformation)
 {
-    emit chat(receivedInformation);
+    emitLater(&TDLibReceiver::chat, receivedInformation);
 }
 
 void TDLibReceiver::processUpdateRecentStickers(const QVariantMap &receivedInformation)
 {
     LOG("Recent stickers updated");
-    emit recentStickersUpdated(receivedInformation.value("sticker_ids").toList());
+    emitLater(&TDLibReceiver::recentStickersUpdated, receivedInformation.value("sticker_ids").toList());
 }
 
 void TDLibReceiver::processStickers(const QVariantMap &receivedInformation)
 {
     LOG("Received some stickers...");
-    emit stickers(cleanupList(receivedInformation.value(STICKERS).toList()));
+    emitLater(&TDLibReceiver::stickers, cleanupList(receivedInformation.value(STICKERS).toList()));
 }
 
 void TDLibReceiver::processUpdateInstalledStickerSets(const QVariantMap &receivedInformation)
 {
     LOG("Recent sticker sets updated");
-    emit installedStickerSetsUpdated(receivedInformation.value("sticker_set_ids").toList());
+    emitLater(&TDLibReceiver::installedStickerSetsUpdated, receivedInformation.value("sticker_set_ids").toList());
 }
 
 void TDLibReceiver::processStickerSets(const QVariantMap &receivedInformation)
 {
     LOG("Received some sticker sets...");
-    emit stickerSets(cleanupList(receivedInformation.value(SETS).toList()));
+    emitLater(&TDLibReceiver::stickerSets, cleanupList(receivedInformation.value(SETS).toList()));
 }
 
 void TDLibReceiver::processStickerSet(const QVariantMap &receivedInformation)
 {
     LOG("Received a sticker set...");
-    emit stickerSet(cleanupMap(receivedInformation));
+    emitLater(&TDLibReceiver::stickerSet, cleanupMap(receivedInformation));
 }
 void TDLibReceiver::processChatMembers(const QVariantMap &receivedInformation)
 {
     LOG("Received super group members");
     const QString extra = receivedInformation.value(_EXTRA).toString();
-    emit chatMembers(extra, receivedInformation.value("members").toList(), receivedInformation.value(TOTAL_COUNT).toInt());
+    emitLater(&TDLibReceiver::chatMembers, extra, receivedInformation.value("members").toList(), receivedInformation.value(TOTAL_COUNT).toInt());
 }
 
 void TDLibReceiver::processUserFullInfo(const QVariantMap &receivedInformation)
 {
     LOG("Received UserFullInfo");
-    emit userFullInfo(receivedInformation);
+    emitLater(&TDLibReceiver::userFullInfo, receivedInformation);
 }
 
 void TDLibReceiver::processUpdateUserFullInfo(const QVariantMap &receivedInformation)
 {
     LOG("Received UserFullInfoUpdate");
-    emit userFullInfoUpdated(receivedInformation.value(USER_ID).toString(), receivedInformation.value("user_full_info").toMap());
+    emitLater(&TDLibReceiver::userFullInfoUpdated, receivedInformation.value(USER_ID).toString(), receivedInformation.value("user_full_info").toMap());
 }
 
 void TDLibReceiver::processBasicGroupFullInfo(const QVariantMap &receivedInformation)
 {
     LOG("Received BasicGroupFullInfo");
     const QString groupId = receivedInformation.value(_EXTRA).toString();
-    emit basicGroupFullInfo(groupId, receivedInformation);
+    emitLater(&TDLibReceiver::basicGroupFullInfo, groupId, receivedInformation);
 }
 void TDLibReceiver::processUpdateBasicGroupFullInfo(const QVariantMap &receivedInformation)
 {
     LOG("Received BasicGroupFullInfoUpdate");
     const QString groupId = receivedInformation.value("basic_group_id").toString();
-    emit basicGroupFullInfoUpdated(groupId, receivedInformation.value("basic_group_full_info").toMap());
+    emitLater(&TDLibReceiver::basicGroupFullInfoUpdated, groupId, receivedInformation.value("basic_group_full_info").toMap());
 }
 
 void TDLibReceiver::processSupergroupFullInfo(const QVariantMap &receivedInformation)
 {
     LOG("Received SuperGroupFullInfoUpdate");
     const QString groupId = receivedInformation.value(_EXTRA).toString();
-    emit supergroupFullInfo(groupId, receivedInformation);
+    emitLater(&TDLibReceiver::supergroupFullInfo, groupId, receivedInformation);
 }
 
 void TDLibReceiver::processUpdateSupergroupFullInfo(const QVariantMap &receivedInformation)
 {
     LOG("Received SuperGroupFullInfoUpdate");
     const QString groupId = receivedInformation.value("supergroup_id").toString();
-    emit supergroupFullInfoUpdated(groupId, receivedInformation.value("supergroup_full_info").toMap());
+    emitLater(&TDLibReceiver::supergroupFullInfoUpdated, groupId, receivedInformation.value("supergroup_full_info").toMap());
 }
 
 void TDLibReceiver::processUserProfilePhotos(const QVariantMap &receivedInformation)
 {
     const QString extra = receivedInformation.value(_EXTRA).toString();
-    emit userProfilePhotos(extra, receivedInformation.value("photos").toList(), receivedInformation.value(TOTAL_COUNT).toInt());
+    emitLater(&TDLibReceiver::userProfilePhotos, extra, receivedInformation.value("photos").toList(), receivedInformation.value(TOTAL_COUNT).toInt());
 }
 
 void TDLibReceiver::processUpdateChatPermissions(const QVariantMap &receivedInformation)
 {
-    emit chatPermissionsUpdated(receivedInformation.value(CHAT_ID).toString(), receivedInformation.value("permissions").toMap());
+    emitLater(&TDLibReceiver::chatPermissionsUpdated, receivedInformation.value(CHAT_ID).toString(), receivedInformation.value("permissions").toMap());
 }
 
 void TDLibReceiver::processUpdateChatPhoto(const QVariantMap &receivedInformation)
 {
     const qlonglong chatId = receivedInformation.value(CHAT_ID).toLongLong();
     LOG("Photo updated for chat" << chatId);
-    emit chatPhotoUpdated(chatId, receivedInformation.value(PHOTO).toMap());
+    emitLater(&TDLibReceiver::chatPhotoUpdated, chatId, receivedInformation.value(PHOTO).toMap());
 }
 
 void TDLibReceiver::processUpdateChatTitle(const QVariantMap &receivedInformation)
 {
     LOG("Received UpdateChatTitle");
-    emit chatTitleUpdated(receivedInformation.value(CHAT_ID).toString(), receivedInformation.value(TITLE).toString());
+    emitLater(&TDLibReceiver::chatTitleUpdated, receivedInformation.value(CHAT_ID).toString(), receivedInformation.value(TITLE).toString());
 }
 
 void TDLibReceiver::processUpdateChatPinnedMessage(const QVariantMap &receivedInformation)
 {
     LOG("Received UpdateChatPinnedMessage");
-    emit chatPinnedMessageUpdated(receivedInformation.value(CHAT_ID).toLongLong(), receivedInformation.value("pinned_message_id").toLongLong());
+    emitLater(&TDLibReceiver::chatPinnedMessageUpdated, receivedInformation.value(CHAT_ID).toLongLong(), receivedInformation.value("pinned_message_id").toLongLong());
 }
 
 void TDLibReceiver::processUpdateMessageIsPinned(const QVariantMap &receivedInformation)
 {
     LOG("Received UpdateMessageIsPinned");
-    emit messageIsPinnedUpdated(receivedInformation.value(CHAT_ID).toLongLong(), receivedInformation.value(MESSAGE_ID).toLongLong(), receivedInformation.value("is_pinned").toBool());
+    emitLater(&TDLibReceiver::messageIsPinnedUpdated, receivedInformation.value(CHAT_ID).toLongLong(), receivedInformation.value(MESSAGE_ID).toLongLong(), receivedInformation.value("is_pinned").toBool());
 }
 
 void TDLibReceiver::processUsers(const QVariantMap &receivedInformation)
 {
     LOG("Received Users");
-    emit usersReceived(receivedInformation.value(_EXTRA).toString(), receivedInformation.value("user_ids").toList(), receivedInformation.value(TOTAL_COUNT).toInt());
+    emitLater(&TDLibReceiver::usersReceived, receivedInformation.value(_EXTRA).toString(), receivedInformation.value("user_ids").toList(), receivedInformation.value(TOTAL_COUNT).toInt());
 }
 
 void TDLibReceiver::processMessageSenders(const QVariantMap &receivedInformation)
 {
     LOG("Received Message Senders");
-    emit messageSendersReceived(receivedInformation.value(_EXTRA).toString(), receivedInformation.value("senders").toList(), receivedInformation.value(TOTAL_COUNT).toInt());
+    emitLater(&TDLibReceiver::messageSendersReceived, receivedInformation.value(_EXTRA).toString(), receivedInformation.value("senders").toList(), receivedInformation.value(TOTAL_COUNT).toInt());
 }
 
 void TDLibReceiver::processError(const QVariantMap &receivedInformation)
 {
     LOG("Received an error");
-    emit errorReceived(receivedInformation.value("code").toInt(), receivedInformation.value(MESSAGE).toString(), receivedInformation.value(_EXTRA).toString());
+    emitLater(&TDLibReceiver::errorReceived, receivedInformation.value("code").toInt(), receivedInformation.value(MESSAGE).toString(), receivedInformation.value(_EXTRA).toString());
+}
+
+void TDLibReceiver::processResponse(const QVariantMap &receivedInformation)
+{
+    const QString extra = receivedInformation.value(_EXTRA).toString();
+    VERBOSE("Received response" << extra << receivedInformation.value(_TYPE).toString());
+    emitLater(&TDLibReceiver::responseReceived, extra, receivedInformation);
 }
 
 void TDLibReceiver::ok(const QVariantMap &receivedInformation)
 {
     LOG("Received an OK");
     if (receivedInformation.contains(_EXTRA)) {
-        emit okReceived(receivedInformation.value(_EXTRA).toString());
+        emitLater(&TDLibReceiver::okReceived, receivedInformation.value(_EXTRA).toString());
     }
 }
 
 void TDLibReceiver::processSecretChat(const QVariantMap &receivedInformation)
 {
     LOG("Received a secret chat");
-    emit secretChat(receivedInformation.value(ID).toLongLong(), receivedInformation);
+    emitLater(&TDLibReceiver::secretChat, receivedInformation.value(ID).toLongLong(), receivedInformation);
 }
 
 void TDLibReceiver::processUpdateSecretChat(const QVariantMap &receivedInformation)
 {
     LOG("A secret chat was updated");
     QVariantMap updatedSecretChat = receivedInformation.value(SECRET_CHAT).toMap();
-    emit secretChatUpdated(updatedSecretChat.value(ID).toLongLong(), updatedSecretChat);
+    emitLater(&TDLibReceiver::secretChatUpdated, updatedSecretChat.value(ID).toLongLong(), updatedSecretChat);
 }
 
 void TDLibReceiver::processUpdateMessageEdited(const QVariantMap &receivedInformation)
@@ -712,49 +1668,49 @@ void TDLibReceiver::processUpdateMessageEdited(const QVariantMap &receivedInform
     const qlonglong chatId = receivedInformation.value(CHAT_ID).toLongLong();
     const qlonglong messageId = receivedInformation.value(MESSAGE_ID).toLongLong();
     LOG("Message was edited" << chatId << messageId);
-    emit messageEditedUpdated(chatId, messageId, receivedInformation.value("reply_markup").toMap());
+    emitLater(&TDLibReceiver::messageEditedUpdated, chatId, messageId, receivedInformation.value("reply_markup").toMap());
 }
 
 void TDLibReceiver::processImportedContacts(const QVariantMap &receivedInformation)
 {
     LOG("Contacts were imported");
-    emit contactsImported(receivedInformation.value("importer_count").toList(), receivedInformation.value("user_ids").toList());
+    emitLater(&TDLibReceiver::contactsImported, receivedInformation.value("importer_count").toList(), receivedInformation.value("user_ids").toList());
 }
 
 void TDLibReceiver::processUpdateChatIsMarkedAsUnread(const QVariantMap &receivedInformation)
 {
     LOG("The unread state of a chat was updated");
-    emit chatIsMarkedAsUnreadUpdated(receivedInformation.value(CHAT_ID).toLongLong(), receivedInformation.value("is_marked_as_unread").toBool());
+    emitLater(&TDLibReceiver::chatIsMarkedAsUnreadUpdated, receivedInformation.value(CHAT_ID).toLongLong(), receivedInformation.value("is_marked_as_unread").toBool());
 }
 
 void TDLibReceiver::processUpdateChatDraftMessage(const QVariantMap &receivedInformation)
 {
     LOG("Draft message was updated");
-    emit chatDraftMessageUpdated(receivedInformation.value(CHAT_ID).toLongLong(), cleanupMap(receivedInformation.value(DRAFT_MESSAGE).toMap()), findChatPositionOrder(receivedInformation.value(POSITIONS).toList()));
+    emitLater(&TDLibReceiver::chatDraftMessageUpdated, receivedInformation.value(CHAT_ID).toLongLong(), cleanupMap(receivedInformation.value(DRAFT_MESSAGE).toMap()), findChatPositionOrder(receivedInformation.value(POSITIONS).toList()));
 }
 
 void TDLibReceiver::processInlineQueryResults(const QVariantMap &receivedInformation)
 {
     LOG("Inline Query results");
-    emit inlineQueryResults(receivedInformation.value("inline_query_id").toString(), receivedInformation.value("next_offset").toString(), receivedInformation.value("results").toList(), receivedInformation.value("switch_pm_text").toString(), receivedInformation.value("switch_pm_parameter").toString(), receivedInformation.value(_EXTRA).toString());
+    emitLater(&TDLibReceiver::inlineQueryResults, receivedInformation.value("inline_query_id").toString(), receivedInformation.value("next_offset").toString(), receivedInformation.value("results").toList(), receivedInformation.value("switch_pm_text").toString(), receivedInformation.value("switch_pm_parameter").toString(), receivedInformation.value(_EXTRA).toString());
 }
 
 void TDLibReceiver::processCallbackQueryAnswer(const QVariantMap &receivedInformation)
 {
     LOG("Callback Query answer");
-    emit callbackQueryAnswer(receivedInformation.value(TEXT).toString(), receivedInformation.value("alert").toBool(), receivedInformation.value("url").toString());
+    emitLater(&TDLibReceiver::callbackQueryAnswer, receivedInformation.value(TEXT).toString(), receivedInformation.value("alert").toBool(), receivedInformation.value("url").toString());
 }
 
 void TDLibReceiver::processUserPrivacySettingRules(const QVariantMap &receivedInformation)
 {
     LOG("User privacy setting rules");
-    emit userPrivacySettingRules(receivedInformation);
+    emitLater(&TDLibReceiver::userPrivacySettingRules, receivedInformation);
 }
 
 void TDLibReceiver::processUpdateUserPrivacySettingRules(const QVariantMap &receivedInformation)
 {
     LOG("User privacy setting rules updated");
-    emit userPrivacySettingRulesUpdated(receivedInformation);
+    emitLater(&TDLibReceiver::userPrivacySettingRulesUpdated, receivedInformation);
 }
 
 void TDLibReceiver::processUpdateMessageInteractionInfo(const QVariantMap &receivedInformation)
@@ -762,14 +1718,14 @@ void TDLibReceiver::processUpdateMessageInteractionInfo(const QVariantMap &recei
     const qlonglong chatId = receivedInformation.value(CHAT_ID).toLongLong();
     const qlonglong messageId = receivedInformation.value(MESSAGE_ID).toLongLong();
     LOG("Message interaction info updated" << chatId << messageId);
-    emit messageInteractionInfoUpdated(chatId, messageId, receivedInformation.value(INTERACTION_INFO).toMap());
+    emitLater(&TDLibReceiver::messageInteractionInfoUpdated, chatId, messageId, receivedInformation.value(INTERACTION_INFO).toMap());
 }
 
 void TDLibReceiver::processSessions(const QVariantMap &receivedInformation)
 {
     int inactive_session_ttl_days = receivedInformation.value("inactive_session_ttl_days").toInt();
     QVariantList sessions = receivedInformation.value("sessions").toList();
-    emit sessionsReceived(inactive_session_ttl_days, sessions);
+    emitLater(&TDLibReceiver::sessionsReceived, inactive_session_ttl_days, sessions);
 }
 
 void TDLibReceiver::processAvailableReactions(const QVariantMap &receivedInformation)
@@ -777,7 +1733,7 @@ void TDLibReceiver::processAvailableReactions(const QVariantMap &receivedInforma
     const qlonglong messageId = receivedInformation.value(_EXTRA).toLongLong();
     const QStringList reactions = receivedInformation.value("reactions").toStringList();
     if (!reactions.isEmpty()) {
-        emit availableReactionsReceived(messageId, reactions);
+        emitLater(&TDLibReceiver::availableReactionsReceived, messageId, reactions);
     }
 }
 
@@ -788,7 +1744,7 @@ void TDLibReceiver::processUpdateChatUnreadMentionCount(const QVariantMap &recei
     const qlonglong chatId = receivedInformation.value(CHAT_ID).toLongLong();
     const int unreadMentionCount = receivedInformation.value(UNREAD_MENTION_COUNT).toInt();
     LOG("Chat unread mention count updated" << chatId << unreadMentionCount);
-    emit chatUnreadMentionCountUpdated(chatId, unreadMentionCount);
+    emitLater(&TDLibReceiver::chatUnreadMentionCountUpdated, chatId, unreadMentionCount);
 }
 
 void TDLibReceiver::processUpdateChatUnreadReactionCount(const QVariantMap &receivedInformation)
@@ -796,14 +1752,14 @@ void TDLibReceiver::processUpdateChatUnreadReactionCount(const QVariantMap &rece
     const qlonglong chatId = receivedInformation.value(CHAT_ID).toLongLong();
     const int unreadReactionCount = receivedInformation.value(UNREAD_REACTION_COUNT).toInt();
     LOG("Chat unread reaction count updated" << chatId << unreadReactionCount);
-    emit chatUnreadReactionCountUpdated(chatId, unreadReactionCount);
+    emitLater(&TDLibReceiver::chatUnreadReactionCountUpdated, chatId, unreadReactionCount);
 }
 
 void TDLibReceiver::processUpdateActiveEmojiReactions(const QVariantMap &receivedInformation)
 {
     // updateActiveEmojiReactions was introduced between 1.8.5 and 1.8.6
     // See https://github.com/tdlib/td/commit/d29d367
-    emit activeEmojiReactionsUpdated(receivedInformation.value(EMOJIS).toStringList());
+    emitLater(&TDLibReceiver::activeEmojiReactionsUpdated, receivedInformation.value(EMOJIS).toStringList());
 }
 
 // Recursively removes (some) unused entries from QVariantMaps to reduce
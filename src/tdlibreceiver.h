@@ -20,22 +20,60 @@
 #define TDLIBRECEIVER_H
 
 #include <QHash>
+#include <QAtomicInteger>
 #include <QVariantMap>
-#include <QThread>
+#include <QVector>
+#include <QMutex>
+#include <QElapsedTimer>
+#include <QObject>
 #include <QJsonDocument>
 #include <QJsonObject>
+#include <QMetaMethod>
+#include <type_traits>
 #include <td/telegram/td_json_client.h>
 
-class TDLibReceiver : public QThread
+#include "tdlibupdates.h"
+
+class QThreadPool;
+
+// Handles the responses and updates of one TDLib client. All receivers
+// share a single thread which calls td_receive and hands the documents
+// over to the receiver of the client they belong to.
+class TDLibReceiver : public QObject
 {
     Q_OBJECT
-    void run() Q_DECL_OVERRIDE {
-        receiverLoop();
-    }
 public:
-    explicit TDLibReceiver(void *tdLibClient, QObject *parent = nullptr);
+    explicit TDLibReceiver(int clientId, QObject *parent = nullptr);
+    ~TDLibReceiver() Q_DECL_OVERRIDE;
+    void start();
     void setActive(bool active);
+    bool isClosed() const;
     void setPowerSavingMode(bool active);
+    void setDisplayOn(bool displayOn);
+    void setBatchDelivery(bool enabled);
+    void setMaxBatchSize(int maxSize);
+    void setMaxBatchLatency(int maxLatency);
+    bool setRecordingFile(const QString &path);
+    bool setReplayFile(const QString &path, double speed);
+    // Runs the type specific handler on the main thread, for a recorded
+    // response which no TDLibResponse is waiting for
+    void replayResponse(const QVariantMap &response);
+
+    int getDeliveredBatchCount() const;
+    int getDeliveredUpdateCount() const;
+    int getLastBatchSize() const;
+    int getLargestBatchSize() const;
+    int getCoalescedUpdateCount() const;
+    int getWakeupCount() const;
+    int getIdleWakeupCount() const;
+    int getLastDrainTime() const;
+    int getLongestDrainTime() const;
+    int getDecodeThreadCount() const;
+    int getParallelDecodeCount() const;
+    int getReorderedCount() const;
+    QVariantMap getStatistics() const;
+
+    static const QVariantMap cleanupMap(const QVariantMap& data, bool *updated = Q_NULLPTR);
 
 signals:
     void versionDetected(const QString &version);
@@ -43,18 +81,18 @@ signals:
     void optionUpdated(const QString &optionName, const QVariant &optionValue);
     void connectionStateChanged(const QString &connectionState);
     void userUpdated(const QVariantMap &userInformation);
-    void userStatusUpdated(const QString &userId, const QVariantMap &userStatusInformation);
-    void fileUpdated(const QVariantMap &fileInformation);
+    void userStatusUpdated(const UserStatusUpdate &update);
+    void fileUpdated(const FileUpdate &update);
     void newChatDiscovered(const QVariantMap &chatInformation);
     void updateChatFolders(const QVariantList &foldersInformation, qlonglong mainChatlistPosition);
     void gotChatFolder(const QVariantMap &chatFolderInformation);
     void unreadMessageCountUpdated(const QVariantMap &messageCountInformation);
     void unreadChatCountUpdated(const QVariantMap &chatCountInformation);
-    void chatLastMessageUpdated(const QString &chatId, const QString &order, const QVariantMap &lastMessage);
+    void chatLastMessageUpdated(const ChatLastMessageUpdate &update);
     void chatOrderUpdated(const QString &chatId, const QString &order);
-    void chatPinnedUpdated(qlonglong chatId, bool isPinned);
-    void chatReadInboxUpdated(const QString &chatId, const QString &lastReadInboxMessageId, int unreadCount);
-    void chatReadOutboxUpdated(const QString &chatId, const QString &lastReadOutboxMessageId);
+    void chatPositionUpdated(const ChatPositionUpdate &update);
+    void chatReadInboxUpdated(const ChatReadInboxUpdate &update);
+    void chatReadOutboxUpdated(const ChatReadOutboxUpdate &update);
     void chatAvailableReactionsUpdated(const qlonglong &chatId, const QVariantMap &availableReactions);
     void basicGroupUpdated(qlonglong groupId, const QVariantMap &groupInformation);
     void superGroupUpdated(qlonglong groupId, const QVariantMap &groupInformation);
@@ -111,21 +149,120 @@ signals:
     void chatUnreadMentionCountUpdated(qlonglong chatId, int unreadMentionCount);
     void chatUnreadReactionCountUpdated(qlonglong chatId, int unreadReactionCount);
     void activeEmojiReactionsUpdated(const QStringList& emojis);
+    void responseReceived(const QString &extra, const QVariantMap &response);
+    void queuedRequestCompleted(qlonglong requestId, bool active);
+
+private slots:
+    void deliverPendingUpdates();
 
 private:
     typedef void (TDLibReceiver::*Handler)(const QVariantMap &);
 
+    // Updated with relaxed atomic operations so that they can stay
+    // enabled in release builds. Times are in microseconds.
+    struct TypeStatistics {
+        enum { HistogramSize = 16 }; // Power of 2 buckets, the last one is open
+        QAtomicInt count;
+        QAtomicInteger<qint64> parseTime;
+        QAtomicInteger<qint64> handlerTime;
+        QAtomicInteger<qint64> queueTime;
+        QAtomicInt parseHistogram[HistogramSize];
+        QAtomicInt handlerHistogram[HistogramSize];
+        QAtomicInt queueHistogram[HistogramSize];
+    };
+
+    // A signal emitted by a handler off the main thread, see emitLater()
+    struct PendingSignal {
+        PendingSignal() : signalIndex(-1), statistics(Q_NULLPTR), received(0) {}
+        int signalIndex; // -1 if it has been coalesced
+        QVector<QVariant> arguments;
+        TypeStatistics *statistics; // Only set for the first signal of an update
+        qint64 received;
+    };
+
+    // A document on its way through the reorder buffer. Handled either
+    // inline or by the worker pool, in which case it owns a copy of the JSON.
+    struct DecodeJob {
+        DecodeJob(const QString &k, qint64 r) : key(k), received(r), decodedAt(0), decoded(false) {}
+        QByteArray json;
+        QString key;
+        qint64 received;
+        qint64 decodedAt;
+        QString coalescingKey;
+        QVector<PendingSignal> emitted;
+        bool decoded; // Protected by decodeMutex
+    };
+
+    class DecodeTask;
+    class Loop;
+
+    // Where emitLater() puts the signals of the handler running on this thread
+    static thread_local QVector<PendingSignal> *emitTarget;
+
     QHash<QString, Handler> handlers;
-    void *tdLibClient;
+    // Filled in the constructor and never modified afterwards, so it's
+    // safe to look things up from any thread
+    QHash<QString, TypeStatistics*> typeStatistics;
+    TypeStatistics unhandledStatistics;
+    QElapsedTimer clock;
+    int clientId;
+    QAtomicInt closed;
     bool isActive;
-    bool powerSavingMode;
+    // The settings are changed on the main thread and read by the
+    // receiver thread, the statistics go the other way
+    QAtomicInt powerSavingMode;
+    QAtomicInt displayOn;
+
+    // Updates are decoded and handled on the receiver thread, the signals
+    // emitted by the handlers are handed over to the main thread in batches,
+    // see queueCurrentBatch()
+    QAtomicInt batchDelivery;
+    QAtomicInt maxBatchSize;
+    QAtomicInt maxBatchLatency;
+    QVector<PendingSignal> currentBatch;
+    int currentBatchUpdates;
+    QElapsedTimer batchTimer;
+    QHash<QString, QPair<int,int> > coalescingIndex; // First signal and count
+    QMutex pendingUpdatesMutex;
+    QVector<PendingSignal> pendingUpdates;
+    bool deliveryScheduled;
+    QAtomicInt deliveredBatchCount;
+    QAtomicInt deliveredUpdateCount;
+    QAtomicInt lastBatchSize;
+    QAtomicInt largestBatchSize;
+    QAtomicInt coalescedUpdateCount;
+
+    // Large documents are decoded and handled in parallel while the
+    // receiver thread keeps pulling the small ones, see processReceivedDocument()
+    QThreadPool *decodePool;
+    QMutex decodeMutex;
+    QList<DecodeJob*> reorderBuffer;
+    QAtomicInt parallelDecodeCount;
+    QAtomicInt reorderedCount;
 
 private:
     static const QVariantList cleanupList(const QVariantList& list, bool *updated = Q_NULLPTR);
-    static const QVariantMap cleanupMap(const QVariantMap& data, bool *updated = Q_NULLPTR);
-    void receiverLoop();
+    double maxIdleTimeout() const;
+    int batchLatency() const;
+    int batchTimeout() const;
+    bool hasOpenBatch() const;
+    bool hasPendingDocuments() const;
+    void flushCurrentBatch(bool idle);
+    void queueCurrentBatch();
+    void discardPendingUpdates();
+    template <typename... Args, typename... Values>
+    void emitLater(void (TDLibReceiver::*signal)(Args...), const Values&... values);
+    void emitPendingSignal(const PendingSignal &pending);
     void ok(const QVariantMap &receivedInformation);
-    void processReceivedDocument(const QJsonDocument &receivedJsonDocument);
+    void processResponse(const QVariantMap &receivedInformation);
+    void processReceivedDocument(const QByteArray &receivedJson);
+    void processDecodedDocument(const QVariantMap &document, DecodeJob *job);
+    void queueSignals(DecodeJob *job);
+    void decodeJob(DecodeJob *job);
+    void releaseDecodedDocuments();
+    void callHandler(Handler handler, const QVariantMap &data, TypeStatistics *statistics, DecodeJob *job);
+    static void recordTime(QAtomicInteger<qint64> &total, QAtomicInt *histogram, qint64 time);
+    static QVariantMap statisticsToMap(const TypeStatistics &statistics);
     void processUpdateOption(const QVariantMap &receivedInformation);
     void processUpdateAuthorizationState(const QVariantMap &receivedInformation);
     void processUpdateConnectionState(const QVariantMap &receivedInformation);
@@ -202,4 +339,16 @@ private:
     void processUpdateActiveEmojiReactions(const QVariantMap &receivedInformation);
 };
 
+// Handlers don't emit their signals directly, they may be running on any
+// thread. The signals are collected and emitted on the main thread when
+// the batch they belong to gets delivered.
+template <typename... Args, typename... Values>
+inline void TDLibReceiver::emitLater(void (TDLibReceiver::*signal)(Args...), const Values&... values)
+{
+    PendingSignal pending;
+    pending.signalIndex = QMetaMethod::fromSignal(signal).methodIndex();
+    pending.arguments = { QVariant::fromValue<typename std::decay<Args>::type>(values)... };
+    emitTarget->append(pending);
+}
+
 #endif // TDLIBRECEIVER_H
@@ -0,0 +1,196 @@
+/*
+    Copyright (C) 2020 Sebastian J. Wolf and other contributors
+
+    This file is part of Fernschreiber.
+
+    Fernschreiber is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Fernschreiber is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Fernschreiber. If not, see <http://www.gnu.org/licenses/>.
+*/
+#include "tdlibrecording.h"
+
+#include <QThread>
+#include <QtEndian>
+
+#define DEBUG_MODULE TDLibRecording
+#include "debuglog.h"
+
+namespace {
+    const char FILE_MAGIC[] = "FSREC001";
+    const int FILE_MAGIC_SIZE = 8;
+    const int MAX_BLOCK_SIZE = 0x10000;
+    const int MAX_BLOCK_AGE = 5000; // ms
+    const int MAX_REPLAY_WAIT = 100; // ms
+
+    void appendUInt32(QByteArray &data, quint32 value)
+    {
+        uchar bytes[4];
+        qToBigEndian(value, bytes);
+        data.append((const char*)bytes, 4);
+    }
+}
+
+TDLibRecorder::TDLibRecorder(const QString &path) :
+    file(path),
+    lastTimestamp(0),
+    blockTimestamp(0)
+{
+    if (file.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+        LOG("Recording TDLib updates to" << path);
+        file.write(FILE_MAGIC, FILE_MAGIC_SIZE);
+        timer.start();
+    } else {
+        WARN("Failed to open" << path << file.errorString());
+    }
+}
+
+TDLibRecorder::~TDLibRecorder()
+{
+    close();
+}
+
+bool TDLibRecorder::isOpen() const
+{
+    return file.isOpen();
+}
+
+void TDLibRecorder::write(const char *json)
+{
+    if (file.isOpen()) {
+        const qint64 now = timer.elapsed();
+        const quint32 length = qstrlen(json);
+        if (block.isEmpty()) {
+            blockTimestamp = now;
+        }
+        appendUInt32(block, quint32(now - lastTimestamp));
+        appendUInt32(block, length);
+        block.append(json, length);
+        // Don't keep the data around for too long, the process may
+        // get killed at any moment
+        if (block.size() >= MAX_BLOCK_SIZE || (now - blockTimestamp) >= MAX_BLOCK_AGE) {
+            flush();
+        }
+        lastTimestamp = now;
+    }
+}
+
+void TDLibRecorder::idle()
+{
+    if (file.isOpen()) {
+        flush();
+    }
+}
+
+void TDLibRecorder::flush()
+{
+    if (!block.isEmpty()) {
+        const QByteArray compressed(qCompress(block));
+        QByteArray size;
+        appendUInt32(size, compressed.size());
+        file.write(size);
+        file.write(compressed);
+        file.flush();
+        block.clear();
+    }
+}
+
+void TDLibRecorder::close()
+{
+    if (file.isOpen()) {
+        flush();
+        LOG("Recording finished," << file.size() << "bytes");
+        file.close();
+    }
+}
+
+TDLibPlayer::TDLibPlayer(const QString &path, double replaySpeed) :
+    file(path),
+    speed(replaySpeed),
+    nextTimestamp(0),
+    blockPos(0),
+    count(0),
+    finished(false)
+{
+    if (file.open(QIODevice::ReadOnly) && file.read(FILE_MAGIC_SIZE) == QByteArray(FILE_MAGIC, FILE_MAGIC_SIZE)) {
+        LOG("Replaying TDLib updates from" << path << "speed" << speed);
+        timer.start();
+    } else {
+        WARN("Not a valid recording" << path << file.errorString());
+        file.close();
+        finished = true;
+    }
+}
+
+bool TDLibPlayer::isOpen() const
+{
+    return file.isOpen();
+}
+
+bool TDLibPlayer::atEnd() const
+{
+    return finished;
+}
+
+int TDLibPlayer::recordCount() const
+{
+    return count;
+}
+
+bool TDLibPlayer::readBlock()
+{
+    const QByteArray size(file.read(4));
+    if (size.size() == 4) {
+        const quint32 compressedSize = qFromBigEndian<quint32>((const uchar*)size.constData());
+        block = qUncompress(file.read(compressedSize));
+        blockPos = 0;
+        return !block.isEmpty();
+    }
+    return false;
+}
+
+const char *TDLibPlayer::next(double timeout)
+{
+    if (finished) {
+        // Just like td_receive when there's nothing to do
+        QThread::msleep(qMin(int(timeout * 1000), MAX_REPLAY_WAIT));
+        return Q_NULLPTR;
+    }
+
+    if (blockPos + 8 > block.size() && !readBlock()) {
+        LOG("Replay finished," << count << "records in" << timer.elapsed() << "ms");
+        finished = true;
+        file.close();
+        return Q_NULLPTR;
+    }
+
+    const uchar *header = (const uchar*)block.constData() + blockPos;
+    const quint32 delay = qFromBigEndian<quint32>(header);
+    const quint32 length = qFromBigEndian<quint32>(header + 4);
+
+    if (speed > 0) {
+        const qint64 due = nextTimestamp + qint64(delay / speed);
+        const qint64 wait = due - timer.elapsed();
+        if (wait > 0) {
+            // Not yet, behave like a receive call which has timed out
+            QThread::msleep(qMin(wait, qint64(qMin(int(timeout * 1000), MAX_REPLAY_WAIT))));
+            if (due > timer.elapsed()) {
+                return Q_NULLPTR;
+            }
+        }
+        nextTimestamp = due;
+    }
+
+    current = block.mid(blockPos + 8, length);
+    blockPos += 8 + length;
+    count++;
+    return current.constData();
+}
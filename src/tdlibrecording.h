@@ -0,0 +1,84 @@
+/*
+    Copyright (C) 2020 Sebastian J. Wolf and other contributors
+
+    This file is part of Fernschreiber.
+
+    Fernschreiber is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Fernschreiber is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Fernschreiber. If not, see <http://www.gnu.org/licenses/>.
+*/
+#ifndef TDLIBRECORDING_H
+#define TDLIBRECORDING_H
+
+#include <QByteArray>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QString>
+
+// Recording of the raw TDLib update stream, see TDLibReceiver.
+//
+// The file starts with a small header followed by zlib compressed blocks,
+// each one prefixed with its compressed size (quint32, big endian). Once
+// uncompressed, a block is a sequence of records: milliseconds since the
+// previous record, JSON length (both quint32, big endian) and the JSON
+// itself, exactly as returned by td_receive.
+
+class TDLibRecorder
+{
+public:
+    TDLibRecorder(const QString &path);
+    ~TDLibRecorder();
+
+    bool isOpen() const;
+    void write(const char *json);
+    // Nothing is coming in, writes out whatever has been recorded so far
+    void idle();
+    void close();
+
+private:
+    void flush();
+
+private:
+    QFile file;
+    QElapsedTimer timer;
+    qint64 lastTimestamp;
+    qint64 blockTimestamp; // When the first record of the block came in
+    QByteArray block;
+};
+
+class TDLibPlayer
+{
+public:
+    // speed 1.0 is real time, zero or negative means as fast as possible
+    TDLibPlayer(const QString &path, double speed);
+
+    bool isOpen() const;
+    bool atEnd() const;
+    int recordCount() const;
+    const char *next(double timeout);
+
+private:
+    bool readBlock();
+
+private:
+    QFile file;
+    double speed;
+    QElapsedTimer timer;
+    qint64 nextTimestamp;
+    QByteArray block;
+    int blockPos;
+    QByteArray current;
+    int count;
+    bool finished;
+};
+
+#endif // TDLIBRECORDING_H
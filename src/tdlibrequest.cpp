@@ -0,0 +1,217 @@
+/*
+    Copyright (C) 2020 Sebastian J. Wolf and other contributors
+
+    This file is part of Fernschreiber.
+
+    Fernschreiber is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Fernschreiber is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Fernschreiber. If not, see <http://www.gnu.org/licenses/>.
+*/
+#include "tdlibrequest.h"
+#include "tdlibresponse.h"
+
+#include <QElapsedTimer>
+#include <QJsonDocument>
+#include <QVariantList>
+
+#define DEBUG_MODULE TDLibRequest
+#include "debuglog.h"
+
+TDLibRequest::TDLibRequest(QByteArray &data, const char *type) :
+    buffer(data),
+    requestType(type)
+{
+    // Keeps the capacity, unlike clear()
+    buffer.resize(0);
+    buffer.append("{\"@type\":\"");
+    buffer.append(type);
+    buffer.append('"');
+}
+
+void TDLibRequest::appendKey(const char *key)
+{
+    buffer.append(",\"");
+    buffer.append(key);
+    buffer.append("\":");
+}
+
+void TDLibRequest::appendString(const QByteArray &utf8)
+{
+    appendString(buffer, utf8);
+}
+
+void TDLibRequest::appendString(QByteArray &out, const QByteArray &utf8)
+{
+    static const char hex[] = "0123456789abcdef";
+    out.append('"');
+    const int n = utf8.size();
+    for (int i = 0; i < n; i++) {
+        const char c = utf8.at(i);
+        if (c == '"' || c == '\\') {
+            out.append('\\');
+            out.append(c);
+        } else if (uchar(c) < 0x20) {
+            out.append("\\u00");
+            out.append(hex[uchar(c) >> 4]);
+            out.append(hex[uchar(c) & 0xf]);
+        } else {
+            out.append(c);
+        }
+    }
+    out.append('"');
+}
+
+TDLibRequest &TDLibRequest::add(const char *key, int value)
+{
+    appendKey(key);
+    buffer.append(QByteArray::number(value));
+    return *this;
+}
+
+TDLibRequest &TDLibRequest::add(const char *key, qlonglong value)
+{
+    // Unlike QJsonDocument, doesn't squeeze 64-bit ids through a double
+    appendKey(key);
+    buffer.append(QByteArray::number(value));
+    return *this;
+}
+
+TDLibRequest &TDLibRequest::add(const char *key, bool value)
+{
+    appendKey(key);
+    buffer.append(value ? "true" : "false");
+    return *this;
+}
+
+TDLibRequest &TDLibRequest::add(const char *key, const char *value)
+{
+    appendKey(key);
+    appendString(QByteArray::fromRawData(value, qstrlen(value)));
+    return *this;
+}
+
+TDLibRequest &TDLibRequest::add(const char *key, const QString &value)
+{
+    appendKey(key);
+    appendString(value.toUtf8());
+    return *this;
+}
+
+TDLibRequest &TDLibRequest::add(const char *key, const QList<qlonglong> &values)
+{
+    appendKey(key);
+    buffer.append('[');
+    const int n = values.count();
+    for (int i = 0; i < n; i++) {
+        if (i > 0) {
+            buffer.append(',');
+        }
+        buffer.append(QByteArray::number(values.at(i)));
+    }
+    buffer.append(']');
+    return *this;
+}
+
+const char *TDLibRequest::type() const
+{
+    return requestType;
+}
+
+const QByteArray &TDLibRequest::finish()
+{
+    buffer.append('}');
+    return buffer;
+}
+
+QVariantMap TDLibRequest::benchmark(int iterations)
+{
+    // Same requests as TDLibWrapper sends, built both ways but not sent.
+    // Times are in nanoseconds per request.
+    const qlonglong chatId = -1001234567890LL;
+    const qlonglong messageId = 123456789012LL;
+    const int fileId = 4321;
+    const int n = qMax(iterations, 1);
+    const int variantMapIndex = 0;
+    const int builderIndex = 1;
+    static const char* const types[] = { "viewMessages", "downloadFile", "getChatHistory", "getMessage" };
+    const int typeCount = sizeof(types) / sizeof(types[0]);
+    QByteArray buffer;
+    qint64 total = 0; // Keeps the compiler from optimizing the work away
+    QVariantMap result;
+
+    for (int t = 0; t < typeCount; t++) {
+        qint64 elapsed[2];
+        for (int path = variantMapIndex; path <= builderIndex; path++) {
+            QElapsedTimer timer;
+            timer.start();
+            for (int i = 0; i < n; i++) {
+                if (path == variantMapIndex) {
+                    QVariantMap requestObject;
+                    requestObject.insert("@type", types[t]);
+                    switch (t) {
+                    case 0:
+                        requestObject.insert("chat_id", chatId);
+                        requestObject.insert("force_read", false);
+                        requestObject.insert("message_ids", QVariantList() << messageId);
+                        break;
+                    case 1:
+                        requestObject.insert("file_id", fileId);
+                        requestObject.insert("synchronous", false);
+                        requestObject.insert("offset", 0);
+                        requestObject.insert("limit", 0);
+                        requestObject.insert("priority", 1);
+                        break;
+                    case 2:
+                        requestObject.insert("chat_id", chatId);
+                        requestObject.insert("from_message_id", messageId);
+                        requestObject.insert("offset", 0);
+                        requestObject.insert("limit", 50);
+                        requestObject.insert("only_local", false);
+                        break;
+                    default:
+                        requestObject.insert("chat_id", chatId);
+                        requestObject.insert("message_id", messageId);
+                        requestObject.insert("@extra", TDLibResponse::makeExtra(i));
+                        break;
+                    }
+                    total += QJsonDocument::fromVariant(requestObject).toJson(QJsonDocument::Compact).size();
+                } else {
+                    TDLibRequest request(buffer, types[t]);
+                    switch (t) {
+                    case 0:
+                        request.add("chat_id", chatId).add("force_read", false).add("message_ids", QList<qlonglong>() << messageId);
+                        break;
+                    case 1:
+                        request.add("file_id", fileId).add("synchronous", false).add("offset", 0).add("limit", 0).add("priority", 1);
+                        break;
+                    case 2:
+                        request.add("chat_id", chatId).add("from_message_id", messageId).add("offset", 0).add("limit", 50).add("only_local", false);
+                        break;
+                    default:
+                        request.add("chat_id", chatId).add("message_id", messageId).add("@extra", TDLibResponse::makeExtra(i));
+                        break;
+                    }
+                    total += request.finish().size();
+                }
+            }
+            elapsed[path] = timer.nsecsElapsed() / n;
+        }
+        LOG(types[t] << "variant map" << elapsed[variantMapIndex] << "ns, builder" << elapsed[builderIndex] << "ns");
+        QVariantMap typeResult;
+        typeResult.insert("variant_map", elapsed[variantMapIndex]);
+        typeResult.insert("builder", elapsed[builderIndex]);
+        result.insert(types[t], typeResult);
+    }
+    VERBOSE("Benchmark produced" << total << "bytes");
+    Q_UNUSED(total)
+    return result;
+}
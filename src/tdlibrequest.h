@@ -0,0 +1,62 @@
+/*
+    Copyright (C) 2020 Sebastian J. Wolf and other contributors
+
+    This file is part of Fernschreiber.
+
+    Fernschreiber is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Fernschreiber is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Fernschreiber. If not, see <http://www.gnu.org/licenses/>.
+*/
+#ifndef TDLIBREQUEST_H
+#define TDLIBREQUEST_H
+
+#include <QByteArray>
+#include <QList>
+#include <QString>
+#include <QVariantMap>
+
+// Writes a TDLib request straight into a JSON buffer, without going through
+// QVariantMap and QJsonDocument. Meant for the requests which are sent over
+// and over again. The type and the keys are plain ASCII literals, values are
+// escaped as needed. The buffer is reused, so one request at a time.
+
+class TDLibRequest
+{
+public:
+    TDLibRequest(QByteArray &buffer, const char *type);
+
+    TDLibRequest &add(const char *key, int value);
+    TDLibRequest &add(const char *key, qlonglong value);
+    TDLibRequest &add(const char *key, bool value);
+    TDLibRequest &add(const char *key, const char *value);
+    TDLibRequest &add(const char *key, const QString &value);
+    TDLibRequest &add(const char *key, const QList<qlonglong> &values);
+
+    const char *type() const;
+    const QByteArray &finish();
+
+    // Compares this with the QVariantMap path for the most frequent requests
+    static QVariantMap benchmark(int iterations);
+
+    // Appends a quoted and escaped JSON string
+    static void appendString(QByteArray &out, const QByteArray &utf8);
+
+private:
+    void appendKey(const char *key);
+    void appendString(const QByteArray &utf8);
+
+private:
+    QByteArray &buffer;
+    const char *requestType;
+};
+
+#endif // TDLIBREQUEST_H
@@ -0,0 +1,167 @@
+/*
+    Copyright (C) 2020 Sebastian J. Wolf and other contributors
+
+    This file is part of Fernschreiber.
+
+    Fernschreiber is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Fernschreiber is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Fernschreiber. If not, see <http://www.gnu.org/licenses/>.
+*/
+#include "tdlibrequestqueue.h"
+#include "tdlibrequest.h"
+
+#define DEBUG_MODULE TDLibRequestQueue
+#include "debuglog.h"
+
+namespace {
+    const QString _EXTRA("@extra");
+    const QString TAG_PREFIX("#q:");
+    const QChar TAG_SEPARATOR(':');
+}
+
+TDLibRequestQueue::TDLibRequestQueue(int priorityCount) :
+    classes(priorityCount),
+    lastId(0)
+{
+}
+
+void TDLibRequestQueue::setLimit(int priority, int limit)
+{
+    classes[priority].limit = limit;
+}
+
+bool TDLibRequestQueue::enqueue(int priority, const QByteArray &json, const QString &extra, const QString &holdKey)
+{
+    PriorityClass &priorityClass = classes[priority];
+    Request request;
+    request.json = json;
+    request.extra = extra;
+    request.holdKey = holdKey;
+    request.key = json;
+    if (!extra.isEmpty()) {
+        request.key.append('\0').append(extra.toUtf8());
+    }
+    if (knownRequests.contains(request.key)) {
+        VERBOSE("Dropping duplicate request" << json.constData());
+        priorityClass.deduplicated++;
+        return false;
+    }
+    knownRequests.insert(request.key);
+    priorityClass.waiting.enqueue(request);
+    priorityClass.largestBacklog = qMax(priorityClass.largestBacklog, priorityClass.waiting.count());
+    return true;
+}
+
+bool TDLibRequestQueue::takeNext(QByteArray *json)
+{
+    const int n = classes.count();
+    for (int priority = 0; priority < n; priority++) {
+        PriorityClass &priorityClass = classes[priority];
+        if (!priorityClass.waiting.isEmpty() && (!priorityClass.limit || priorityClass.inFlight < priorityClass.limit)) {
+            const Request request(priorityClass.waiting.dequeue());
+            const qlonglong id = ++lastId;
+            QString tag(TAG_PREFIX + QString::number(id));
+            if (!request.extra.isEmpty()) {
+                tag.append(TAG_SEPARATOR).append(request.extra);
+            }
+            // Replace the closing brace with the tag
+            json->resize(0);
+            json->append(request.json.constData(), request.json.size() - 1);
+            json->append(",\"@extra\":");
+            TDLibRequest::appendString(*json, tag.toUtf8());
+            json->append('}');
+            inFlight.insert(id, request);
+            inFlightPriority.insert(id, priority);
+            priorityClass.inFlight++;
+            priorityClass.sent++;
+            return true;
+        }
+    }
+    return false;
+}
+
+void TDLibRequestQueue::complete(qlonglong id, bool active)
+{
+    if (inFlight.contains(id)) {
+        const Request &request = inFlight[id];
+        if (active && !request.holdKey.isEmpty()) {
+            if (!held.contains(request.holdKey, id)) {
+                VERBOSE("Holding request" << id << request.holdKey);
+                held.insert(request.holdKey, id);
+            }
+        } else {
+            classes[inFlightPriority.take(id)].inFlight--;
+            knownRequests.remove(request.key);
+            inFlight.remove(id);
+        }
+    }
+}
+
+bool TDLibRequestQueue::release(const QString &holdKey)
+{
+    const QList<qlonglong> ids(held.values(holdKey));
+    for (const qlonglong id : ids) {
+        VERBOSE("Releasing request" << id << holdKey);
+        classes[inFlightPriority.take(id)].inFlight--;
+        knownRequests.remove(inFlight.take(id).key);
+    }
+    held.remove(holdKey);
+    return !ids.isEmpty();
+}
+
+void TDLibRequestQueue::clear()
+{
+    const int n = classes.count();
+    for (int priority = 0; priority < n; priority++) {
+        classes[priority].waiting.clear();
+        classes[priority].inFlight = 0;
+    }
+    inFlight.clear();
+    inFlightPriority.clear();
+    held.clear();
+    knownRequests.clear();
+}
+
+QVariantMap TDLibRequestQueue::getStatistics(int priority) const
+{
+    const PriorityClass &priorityClass = classes.at(priority);
+    QVariantMap statistics;
+    statistics.insert("limit", priorityClass.limit);
+    statistics.insert("waiting", priorityClass.waiting.count());
+    statistics.insert("in_flight", priorityClass.inFlight);
+    statistics.insert("largest_backlog", priorityClass.largestBacklog);
+    statistics.insert("sent", priorityClass.sent);
+    statistics.insert("deduplicated", priorityClass.deduplicated);
+    return statistics;
+}
+
+bool TDLibRequestQueue::isTagged(const QString &extra)
+{
+    return extra.startsWith(TAG_PREFIX);
+}
+
+bool TDLibRequestQueue::untag(QVariantMap &response, qlonglong *id)
+{
+    const QString tag(response.value(_EXTRA).toString());
+    if (tag.startsWith(TAG_PREFIX)) {
+        const int separator = tag.indexOf(TAG_SEPARATOR, TAG_PREFIX.length());
+        if (separator < 0) {
+            *id = tag.mid(TAG_PREFIX.length()).toLongLong();
+            response.remove(_EXTRA);
+        } else {
+            *id = tag.mid(TAG_PREFIX.length(), separator - TAG_PREFIX.length()).toLongLong();
+            response.insert(_EXTRA, tag.mid(separator + 1));
+        }
+        return true;
+    }
+    return false;
+}
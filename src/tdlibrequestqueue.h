@@ -0,0 +1,96 @@
+/*
+    Copyright (C) 2020 Sebastian J. Wolf and other contributors
+
+    This file is part of Fernschreiber.
+
+    Fernschreiber is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Fernschreiber is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Fernschreiber. If not, see <http://www.gnu.org/licenses/>.
+*/
+#ifndef TDLIBREQUESTQUEUE_H
+#define TDLIBREQUESTQUEUE_H
+
+#include <QByteArray>
+#include <QHash>
+#include <QPair>
+#include <QQueue>
+#include <QSet>
+#include <QString>
+#include <QVariantMap>
+#include <QVector>
+
+// Holds back the requests which shouldn't compete with whatever the user is
+// waiting for. Every priority class has its own limit of requests in flight
+// (zero means no limit), everything else waits in order. A request which is
+// identical to one already waiting or in flight is dropped, the response is
+// broadcast anyway.
+//
+// Requests are sent with an @extra of the form "#q:<id>:<original extra>",
+// untag() turns it back into the original one when the response arrives.
+//
+// Some requests keep working after the response, e.g. downloadFile returns
+// right away. Those are enqueued with a hold key. If the response says that
+// the work is still going on, they keep their slot until release() is
+// called with that key.
+
+class TDLibRequestQueue
+{
+public:
+    TDLibRequestQueue(int priorityCount);
+
+    void setLimit(int priority, int limit);
+
+    // The JSON must not contain @extra, pass it separately. Returns false
+    // if the request is a duplicate.
+    bool enqueue(int priority, const QByteArray &json, const QString &extra, const QString &holdKey = QString());
+    // Takes the next request which may be sent now, tagged and ready to go
+    bool takeNext(QByteArray *json);
+    // The response has arrived, the request is held only if it's still
+    // active, e.g. the file is being downloaded
+    void complete(qlonglong id, bool active);
+    bool release(const QString &holdKey);
+    void clear();
+
+    QVariantMap getStatistics(int priority) const;
+
+    // Called from the receiver thread
+    static bool untag(QVariantMap &response, qlonglong *id);
+    static bool isTagged(const QString &extra);
+
+private:
+    struct Request {
+        QByteArray json;
+        QString extra;
+        QByteArray key;
+        QString holdKey;
+    };
+
+    struct PriorityClass {
+        PriorityClass() : limit(0), inFlight(0), largestBacklog(0), sent(0), deduplicated(0) {}
+        int limit;
+        int inFlight;
+        int largestBacklog;
+        int sent;
+        int deduplicated;
+        QQueue<Request> waiting;
+    };
+
+private:
+    QVector<PriorityClass> classes;
+    QHash<qlonglong, Request> inFlight;
+    QHash<qlonglong, int> inFlightPriority;
+    QMultiHash<QString, qlonglong> held; // Ids by hold key
+    QSet<QByteArray> knownRequests;
+    qlonglong lastId;
+};
+
+#endif // TDLIBREQUESTQUEUE_H
@@ -0,0 +1,135 @@
+/*
+    Copyright (C) 2020 Sebastian J. Wolf and other contributors
+
+    This file is part of Fernschreiber.
+
+    Fernschreiber is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Fernschreiber is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Fernschreiber. If not, see <http://www.gnu.org/licenses/>.
+*/
+#include "tdlibresponse.h"
+
+#define DEBUG_MODULE TDLibResponse
+#include "debuglog.h"
+
+namespace {
+    const QString _TYPE("@type");
+    const QString ERROR("error");
+    const QString CODE("code");
+    const QString MESSAGE("message");
+    // Doesn't clash with the ad-hoc @extra strings used elsewhere
+    const QString EXTRA_PREFIX("#fs:");
+    const int TIMEOUT_CODE = 408;
+}
+
+TDLibResponse::TDLibResponse(const QString &id, int timeout, QObject *parent) :
+    QObject(parent),
+    extra(id),
+    state(Pending),
+    errorCode(TIMEOUT_CODE),
+    errorMessage("Request timed out")
+{
+    timer.setSingleShot(true);
+    connect(&timer, SIGNAL(timeout()), this, SLOT(handleFailure()));
+    if (timeout > 0) {
+        timer.start(timeout);
+    }
+}
+
+const QString &TDLibResponse::getExtra() const
+{
+    return this->extra;
+}
+
+TDLibResponse::State TDLibResponse::getState() const
+{
+    return this->state;
+}
+
+bool TDLibResponse::isPending() const
+{
+    return this->state == Pending;
+}
+
+const QVariantMap &TDLibResponse::getResult() const
+{
+    return this->result;
+}
+
+void TDLibResponse::setContext(const QVariant &context)
+{
+    this->context = context;
+}
+
+const QVariant &TDLibResponse::getContext() const
+{
+    return this->context;
+}
+
+QString TDLibResponse::makeExtra(quint64 id)
+{
+    return EXTRA_PREFIX + QString::number(id);
+}
+
+bool TDLibResponse::isResponseExtra(const QString &extra)
+{
+    return extra.startsWith(EXTRA_PREFIX);
+}
+
+void TDLibResponse::cancel()
+{
+    if (this->state == Pending) {
+        LOG("Request" << this->extra << "cancelled");
+        release(Cancelled);
+    }
+}
+
+void TDLibResponse::complete(const QVariantMap &response)
+{
+    if (this->state == Pending) {
+        this->result = response;
+        if (response.value(_TYPE).toString() == ERROR) {
+            this->errorCode = response.value(CODE).toInt();
+            this->errorMessage = response.value(MESSAGE).toString();
+            release(Failed);
+            emit failed(this->errorCode, this->errorMessage);
+        } else {
+            release(Finished);
+            emit finished(response);
+        }
+    }
+}
+
+void TDLibResponse::failLater(int code, const QString &message)
+{
+    // Gives the caller a chance to connect the signals first
+    this->errorCode = code;
+    this->errorMessage = message;
+    timer.start(0);
+}
+
+void TDLibResponse::handleFailure()
+{
+    if (this->state == Pending) {
+        LOG("Request" << this->extra << "failed:" << this->errorCode << this->errorMessage);
+        release(Failed);
+        emit failed(this->errorCode, this->errorMessage);
+    }
+}
+
+void TDLibResponse::release(State newState)
+{
+    this->state = newState;
+    timer.stop();
+    emit released(this->extra);
+    deleteLater();
+}
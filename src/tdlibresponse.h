@@ -0,0 +1,86 @@
+/*
+    Copyright (C) 2020 Sebastian J. Wolf and other contributors
+
+    This file is part of Fernschreiber.
+
+    Fernschreiber is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Fernschreiber is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Fernschreiber. If not, see <http://www.gnu.org/licenses/>.
+*/
+#ifndef TDLIBRESPONSE_H
+#define TDLIBRESPONSE_H
+
+#include <QObject>
+#include <QTimer>
+#include <QVariant>
+#include <QVariantMap>
+
+// Handle of a request sent through TDLibWrapper::sendRequest() with a
+// timeout. The request is tagged with a unique @extra id and its response
+// is routed straight to this object instead of being broadcast. Exactly one
+// of finished() and failed() is emitted, unless the request is cancelled.
+// The handle deletes itself once it's done, so it must not be kept around
+// past that point.
+
+class TDLibResponse : public QObject
+{
+    Q_OBJECT
+public:
+    enum State {
+        Pending,
+        Finished,
+        Failed,
+        Cancelled
+    };
+
+    TDLibResponse(const QString &extra, int timeout, QObject *parent);
+
+    const QString &getExtra() const;
+    State getState() const;
+    bool isPending() const;
+    const QVariantMap &getResult() const;
+
+    // Arbitrary data for whoever handles the result
+    void setContext(const QVariant &context);
+    const QVariant &getContext() const;
+
+    static QString makeExtra(quint64 id);
+    static bool isResponseExtra(const QString &extra);
+
+public slots:
+    void cancel();
+
+signals:
+    void finished(const QVariantMap &result);
+    void failed(int code, const QString &message);
+    void released(const QString &extra);
+
+private slots:
+    void handleFailure();
+
+private:
+    friend class TDLibWrapper;
+    void complete(const QVariantMap &response);
+    void failLater(int code, const QString &message);
+    void release(State newState);
+
+private:
+    const QString extra;
+    State state;
+    QTimer timer;
+    QVariantMap result;
+    QVariant context;
+    int errorCode;
+    QString errorMessage;
+};
+
+#endif // TDLIBRESPONSE_H
@@ -0,0 +1,890 @@
+/*
+    Copyright (C) 2020 Sebastian J. Wolf and other contributors
+
+    This file is part of Fernschreiber.
+
+    Fernschreiber is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Fernschreiber is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Fernschreiber. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+// Stand-in for the TDLib JSON interface, see the tdlibsimulator option in
+// the project file. Each client pretends to be an authorized account and produces
+// synthetic load which can be tuned with environment variables:
+//
+//   FERNSCHREIBER_SIM_CHATS      number of chats (500)
+//   FERNSCHREIBER_SIM_MESSAGES   incoming messages per second (2)
+//   FERNSCHREIBER_SIM_STATUSES   user status changes per second (5)
+//   FERNSCHREIBER_SIM_FILES      file download progress updates per second (10)
+//   FERNSCHREIBER_SIM_FOLDERS    seconds between folder changes, 0 to disable (60)
+//   FERNSCHREIBER_SIM_HISTORY    messages in each chat history (1000)
+//   FERNSCHREIBER_SIM_SEED       random seed, the same seed produces the same load
+//
+// Nothing leaves the device and nothing is stored.
+
+#include <td/telegram/td_json_client.h>
+
+#include <algorithm>
+
+#include <QDateTime>
+#include <QElapsedTimer>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QMutex>
+#include <QMutexLocker>
+#include <QHash>
+#include <QQueue>
+#include <QVector>
+#include <QWaitCondition>
+
+#define DEBUG_MODULE TDLibSimulator
+#include "debuglog.h"
+
+namespace {
+    const QString _TYPE("@type");
+    const QString _EXTRA("@extra");
+    const QString _CLIENT_ID("@client_id");
+    const QString ID("id");
+    const QString CHAT_ID("chat_id");
+    const QString USER_ID("user_id");
+    const QString CHAT_LIST("chat_list");
+    const QString CHAT_FOLDER_ID("chat_folder_id");
+    const QString FILE_ID("file_id");
+    const QString LIMIT("limit");
+    const QString OFFSET("offset");
+    const QString FROM_MESSAGE_ID("from_message_id");
+    const QString NAME("name");
+    const QString VALUE("value");
+    const QString TITLE("title");
+    const QString ORDER("order");
+    const QString IS_PINNED("is_pinned");
+    const QString LIST("list");
+    const QString POSITION("position");
+    const QString POSITIONS("positions");
+    const QString TYPE_CHAT_LIST_MAIN("chatListMain");
+    const QString TYPE_CHAT_LIST_FOLDER("chatListFolder");
+
+    const char TDLIB_VERSION[] = "1.8.21";
+    const qint64 SELF_USER_ID = 1;
+    const qint64 FIRST_USER_ID = 1000;
+    const int GROUP_CHAT_INTERVAL = 5; // Every 5th chat is a group
+    const int FOLDER_COUNT = 3;
+    const qint64 MESSAGE_ID_STEP = 0x100000; // Server message ids are shifted by 20 bits
+    const int MAX_BURST = 1000; // Skip the rest if the client doesn't keep up
+    const int FILE_COUNT = 16;
+    const int FILE_SIZE = 0x100000;
+    const int FILE_PROGRESS_STEPS = 20;
+
+    int envInt(const char *name, int defaultValue)
+    {
+        bool ok;
+        const int value = qgetenv(name).toInt(&ok);
+        return ok ? value : defaultValue;
+    }
+
+    double envDouble(const char *name, double defaultValue)
+    {
+        bool ok;
+        const double value = qgetenv(name).toDouble(&ok);
+        return ok ? value : defaultValue;
+    }
+
+    double envRate(const char *intervalName, double defaultInterval)
+    {
+        const double interval = envDouble(intervalName, defaultInterval);
+        return (interval > 0) ? (1 / interval) : 0;
+    }
+
+    QJsonObject typed(const QString &type)
+    {
+        QJsonObject object;
+        object.insert(_TYPE, type);
+        return object;
+    }
+}
+
+class TDLibSimulator
+{
+public:
+    TDLibSimulator(int clientId);
+
+    void send(const char *request);
+    QByteArray takeResult();
+    qint64 nextEventTime() const;
+
+private:
+    // Generates synthetic events at a fixed rate
+    struct Source {
+        Source(double r) : rate(r), generated(0) {}
+        int due(qint64 now);
+        qint64 next() const;
+        double rate;
+        qint64 generated;
+    };
+
+    struct Chat {
+        qint64 id;
+        qint64 userId;
+        qint64 order;
+        qint64 lastMessageId;
+        qint64 lastMessageDate; // Seconds since epoch
+        int unreadCount;
+    };
+
+    struct Download {
+        int fileId;
+        int downloadedSize;
+        bool requested; // By downloadFile, dropped once complete
+    };
+
+    quint32 random();
+    void post(QJsonObject object, const QJsonValue &extra = QJsonValue());
+    void postAuthorizationState(const QString &state);
+    void postOk(const QJsonValue &extra);
+    void postError(int code, const QString &message, const QJsonValue &extra);
+    void login();
+    void generateLoad();
+    void newMessage();
+    void statusChange();
+    void downloadProgress();
+    void folderChange();
+    void loadChats(const QJsonObject &request);
+    void getChatHistory(const QJsonObject &request);
+
+    QJsonObject user(qint64 userId) const;
+    QJsonObject chat(const Chat &chat) const;
+    QJsonObject message(const Chat &chat, qint64 messageId) const;
+    QJsonObject file(int fileId, int downloadedSize) const;
+    QJsonObject folderInfo(int folderId) const;
+    QJsonObject chatPosition(const QJsonObject &list, qint64 order) const;
+    QJsonObject folderList(int folderId) const;
+    bool isInFolder(int chatIndex, int folderId) const;
+    int findChat(qint64 chatId) const;
+    int findDownload(int fileId) const;
+
+private:
+    const int clientId;
+    QQueue<QByteArray> queue;
+    QElapsedTimer timer;
+    quint32 seed;
+    bool ready;
+    bool closed;
+    int historySize;
+    qint64 startTime;
+    qint64 nextOrder;
+    QVector<Chat> chats;
+    int loadedChats;
+    QVector<int> loadedFolderChats;
+    int folderCount;
+    QVector<Download> downloads;
+    Source messages;
+    Source statuses;
+    Source fileProgress;
+    Source folders;
+};
+
+namespace {
+    // All simulated clients, protected by the mutex. Just like TDLib
+    // clients they are never destroyed.
+    QMutex simulatorMutex;
+    QWaitCondition simulatorCondition;
+    QHash<int, TDLibSimulator*> simulators;
+    int lastClientId = 0;
+    int lastServedClientId = 0;
+    QByteArray currentResult;
+}
+
+int TDLibSimulator::Source::due(qint64 now)
+{
+    if (rate <= 0) {
+        return 0;
+    }
+    const qint64 target = qint64(now * rate / 1000);
+    const int count = int(qMin(target - generated, qint64(MAX_BURST)));
+    generated = target;
+    return count;
+}
+
+qint64 TDLibSimulator::Source::next() const
+{
+    return (rate > 0) ? qint64((generated + 1) * 1000 / rate) : -1;
+}
+
+TDLibSimulator::TDLibSimulator(int id) :
+    clientId(id),
+    seed(quint32(envInt("FERNSCHREIBER_SIM_SEED", 1))),
+    ready(false),
+    closed(false),
+    historySize(qMax(envInt("FERNSCHREIBER_SIM_HISTORY", 1000), 1)),
+    startTime(QDateTime::currentMSecsSinceEpoch() / 1000),
+    loadedChats(0),
+    loadedFolderChats(FOLDER_COUNT, 0),
+    folderCount(FOLDER_COUNT),
+    messages(envDouble("FERNSCHREIBER_SIM_MESSAGES", 2)),
+    statuses(envDouble("FERNSCHREIBER_SIM_STATUSES", 5)),
+    fileProgress(envDouble("FERNSCHREIBER_SIM_FILES", 10)),
+    folders(envRate("FERNSCHREIBER_SIM_FOLDERS", 60))
+{
+    if (!seed) {
+        seed = 1; // xorshift gets stuck at zero
+    }
+    const int chatCount = qMax(envInt("FERNSCHREIBER_SIM_CHATS", 500), 1);
+    chats.resize(chatCount);
+    for (int i = 0; i < chatCount; i++) {
+        Chat &chat = chats[i];
+        const bool group = (i % GROUP_CHAT_INTERVAL) == GROUP_CHAT_INTERVAL - 1;
+        chat.userId = FIRST_USER_ID + i;
+        chat.id = group ? -(i + 1) : chat.userId;
+        chat.order = (qint64(chatCount - i) << 32);
+        chat.lastMessageId = historySize * MESSAGE_ID_STEP;
+        chat.lastMessageDate = startTime;
+        chat.unreadCount = (i % 7 == 0) ? (i % 13) : 0;
+    }
+    nextOrder = qint64(chatCount + 1) << 32;
+    for (int i = 0; i < FILE_COUNT; i++) {
+        Download download;
+        download.fileId = i + 1;
+        download.downloadedSize = (FILE_SIZE / FILE_COUNT) * i;
+        download.requested = false;
+        downloads.append(download);
+    }
+    LOG("Simulating" << chatCount << "chats," << messages.rate << "messages/s," << statuses.rate << "statuses/s,"
+        << fileProgress.rate << "file updates/s, folder change every" << (folders.rate > 0 ? 1 / folders.rate : 0) << "s");
+
+    QJsonObject version(typed("updateOption"));
+    QJsonObject versionValue(typed("optionValueString"));
+    versionValue.insert(VALUE, QString(TDLIB_VERSION));
+    version.insert(NAME, QString("version"));
+    version.insert(VALUE, versionValue);
+    post(version);
+    postAuthorizationState("authorizationStateWaitTdlibParameters");
+}
+
+quint32 TDLibSimulator::random()
+{
+    seed ^= seed << 13;
+    seed ^= seed >> 17;
+    seed ^= seed << 5;
+    return seed;
+}
+
+void TDLibSimulator::post(QJsonObject object, const QJsonValue &extra)
+{
+    if (!extra.isUndefined() && !extra.isNull()) {
+        object.insert(_EXTRA, extra);
+    }
+    object.insert(_CLIENT_ID, clientId);
+    queue.enqueue(QJsonDocument(object).toJson(QJsonDocument::Compact));
+}
+
+void TDLibSimulator::postAuthorizationState(const QString &state)
+{
+    QJsonObject update(typed("updateAuthorizationState"));
+    update.insert("authorization_state", typed(state));
+    post(update);
+}
+
+void TDLibSimulator::postOk(const QJsonValue &extra)
+{
+    post(typed("ok"), extra);
+}
+
+void TDLibSimulator::postError(int code, const QString &text, const QJsonValue &extra)
+{
+    QJsonObject error(typed("error"));
+    error.insert("code", code);
+    error.insert("message", text);
+    post(error, extra);
+}
+
+void TDLibSimulator::send(const char *request)
+{
+    const QJsonObject object(QJsonDocument::fromJson(QByteArray(request)).object());
+    const QString type(object.value(_TYPE).toString());
+    const QJsonValue extra(object.value(_EXTRA));
+    VERBOSE(clientId << type);
+    if (closed) {
+        postError(500, "Request aborted", extra);
+    } else if (type == "setTdlibParameters") {
+        postOk(extra);
+        login();
+    } else if (type == "checkDatabaseEncryptionKey" || type == "setLogVerbosityLevel" || type == "setOption") {
+        postOk(extra);
+    } else if (type == "getOption") {
+        post(typed("optionValueEmpty"), extra);
+    } else if (type == "getMe") {
+        post(user(SELF_USER_ID), extra);
+    } else if (type == "getUser") {
+        post(user(qint64(object.value(USER_ID).toDouble())), extra);
+    } else if (type == "getChat" || type == "openChat" || type == "closeChat") {
+        const int index = findChat(qint64(object.value(CHAT_ID).toDouble()));
+        if (index < 0) {
+            postError(400, "Chat not found", extra);
+        } else if (type == "getChat") {
+            post(chat(chats.at(index)), extra);
+        } else {
+            postOk(extra);
+        }
+    } else if (type == "loadChats") {
+        loadChats(object);
+    } else if (type == "getChatHistory") {
+        getChatHistory(object);
+    } else if (type == "getChatFolder") {
+        const int folderId = object.value(CHAT_FOLDER_ID).toInt();
+        QJsonObject folder(typed("chatFolder"));
+        folder.insert(TITLE, folderInfo(folderId).value(TITLE));
+        folder.insert("pinned_chat_ids", QJsonArray());
+        QJsonArray included;
+        for (int i = 0; i < chats.count(); i++) {
+            if (isInFolder(i, folderId)) {
+                included.append(double(chats.at(i).id));
+            }
+        }
+        folder.insert("included_chat_ids", included);
+        folder.insert("excluded_chat_ids", QJsonArray());
+        post(folder, extra);
+    } else if (type == "downloadFile") {
+        const int fileId = object.value(FILE_ID).toInt();
+        const int index = findDownload(fileId);
+        int downloadedSize = 0;
+        if (index >= 0) {
+            // Already being downloaded
+            downloadedSize = downloads.at(index).downloadedSize;
+        } else {
+            Download download;
+            download.fileId = fileId;
+            download.downloadedSize = 0;
+            download.requested = true;
+            downloads.append(download);
+        }
+        post(file(fileId, downloadedSize), extra);
+    } else if (type == "viewMessages") {
+        const int index = findChat(qint64(object.value(CHAT_ID).toDouble()));
+        if (index >= 0) {
+            Chat &chat = chats[index];
+            chat.unreadCount = 0;
+            QJsonObject update(typed("updateChatReadInbox"));
+            update.insert(CHAT_ID, double(chat.id));
+            update.insert("last_read_inbox_message_id", double(chat.lastMessageId));
+            update.insert("unread_count", 0);
+            post(update);
+        }
+        postOk(extra);
+    } else if (type == "close" || type == "logOut") {
+        if (type == "logOut") {
+            postAuthorizationState("authorizationStateLoggingOut");
+        }
+        ready = false;
+        closed = true;
+        postOk(extra);
+        postAuthorizationState("authorizationStateClosing");
+        postAuthorizationState("authorizationStateClosed");
+    } else {
+        // Pretend that everything else has worked
+        postOk(extra);
+    }
+}
+
+QByteArray TDLibSimulator::takeResult()
+{
+    generateLoad();
+    return queue.isEmpty() ? QByteArray() : queue.dequeue();
+}
+
+qint64 TDLibSimulator::nextEventTime() const
+{
+    // Milliseconds until the next synthetic event, -1 if none is coming
+    qint64 wait = -1;
+    if (ready) {
+        const qint64 now = timer.elapsed();
+        const qint64 next[] = { messages.next(), statuses.next(), fileProgress.next(), folders.next() };
+        for (uint i = 0; i < sizeof(next)/sizeof(next[0]); i++) {
+            if (next[i] >= 0) {
+                const qint64 remaining = qMax(next[i] - now, qint64(0));
+                wait = (wait < 0) ? remaining : qMin(wait, remaining);
+            }
+        }
+    }
+    return wait;
+}
+
+static QByteArray takeSimulatorResult()
+{
+    // Take turns so that a busy client doesn't starve the others
+    QList<int> ids(simulators.keys());
+    std::sort(ids.begin(), ids.end());
+    const int n = ids.count();
+    const int start = std::upper_bound(ids.begin(), ids.end(), lastServedClientId) - ids.begin();
+    for (int i = 0; i < n; i++) {
+        const int id = ids.at((start + i) % n);
+        const QByteArray result(simulators.value(id)->takeResult());
+        if (!result.isEmpty()) {
+            lastServedClientId = id;
+            return result;
+        }
+    }
+    return QByteArray();
+}
+
+void TDLibSimulator::login()
+{
+    LOG("Logging in");
+    QJsonObject myId(typed("updateOption"));
+    QJsonObject myIdValue(typed("optionValueInteger"));
+    myIdValue.insert(VALUE, QString::number(SELF_USER_ID));
+    myId.insert(NAME, QString("my_id"));
+    myId.insert(VALUE, myIdValue);
+    post(myId);
+    postAuthorizationState("authorizationStateReady");
+
+    QJsonObject selfUpdate(typed("updateUser"));
+    selfUpdate.insert("user", user(SELF_USER_ID));
+    post(selfUpdate);
+
+    for (int i = 0; i < chats.count(); i++) {
+        const Chat &chat = chats.at(i);
+        QJsonObject userUpdate(typed("updateUser"));
+        userUpdate.insert("user", user(chat.userId));
+        post(userUpdate);
+        if (chat.id < 0) {
+            QJsonObject group(typed("basicGroup"));
+            group.insert(ID, double(-chat.id));
+            group.insert("member_count", 2 + i % 50);
+            group.insert("status", typed("chatMemberStatusMember"));
+            group.insert("is_active", true);
+            group.insert("upgraded_to_supergroup_id", 0);
+            QJsonObject groupUpdate(typed("updateBasicGroup"));
+            groupUpdate.insert("basic_group", group);
+            post(groupUpdate);
+        }
+        QJsonObject chatUpdate(typed("updateNewChat"));
+        QJsonObject chatObject(this->chat(chat));
+        // Positions arrive with loadChats
+        chatObject.insert(POSITIONS, QJsonArray());
+        chatUpdate.insert("chat", chatObject);
+        post(chatUpdate);
+    }
+
+    folderChange();
+    ready = true;
+    timer.start();
+}
+
+void TDLibSimulator::generateLoad()
+{
+    if (ready) {
+        const qint64 now = timer.elapsed();
+        for (int n = messages.due(now); n > 0; n--) {
+            newMessage();
+        }
+        for (int n = statuses.due(now); n > 0; n--) {
+            statusChange();
+        }
+        for (int n = fileProgress.due(now); n > 0; n--) {
+            downloadProgress();
+        }
+        for (int n = folders.due(now); n > 0; n--) {
+            folderChange();
+        }
+    }
+}
+
+void TDLibSimulator::newMessage()
+{
+    // Recently active chats are more likely to get more messages
+    const int count = chats.count();
+    const int index = (random() % 2) ? int(random() % qMin(count, 20)) : int(random() % count);
+    Chat &chat = chats[index];
+    chat.lastMessageId += MESSAGE_ID_STEP;
+    chat.lastMessageDate = QDateTime::currentMSecsSinceEpoch() / 1000;
+    chat.order = nextOrder++;
+    chat.unreadCount++;
+
+    const QJsonObject lastMessage(message(chat, chat.lastMessageId));
+    QJsonObject newMessage(typed("updateNewMessage"));
+    newMessage.insert("message", lastMessage);
+    post(newMessage);
+
+    QJsonArray positions;
+    positions.append(chatPosition(typed(TYPE_CHAT_LIST_MAIN), chat.order));
+    for (int folderId = 0; folderId < folderCount; folderId++) {
+        if (isInFolder(index, folderId)) {
+            positions.append(chatPosition(folderList(folderId), chat.order));
+        }
+    }
+    QJsonObject lastMessageUpdate(typed("updateChatLastMessage"));
+    lastMessageUpdate.insert(CHAT_ID, double(chat.id));
+    lastMessageUpdate.insert("last_message", lastMessage);
+    lastMessageUpdate.insert(POSITIONS, positions);
+    post(lastMessageUpdate);
+
+    QJsonObject readInbox(typed("updateChatReadInbox"));
+    readInbox.insert(CHAT_ID, double(chat.id));
+    readInbox.insert("last_read_inbox_message_id", double(chat.lastMessageId - chat.unreadCount * MESSAGE_ID_STEP));
+    readInbox.insert("unread_count", chat.unreadCount);
+    post(readInbox);
+}
+
+void TDLibSimulator::statusChange()
+{
+    const qint64 userId = FIRST_USER_ID + random() % chats.count();
+    const qint64 now = QDateTime::currentMSecsSinceEpoch() / 1000;
+    QJsonObject status;
+    if (random() % 2) {
+        status = typed("userStatusOnline");
+        status.insert("expires", double(now + 300));
+    } else {
+        status = typed("userStatusOffline");
+        status.insert("was_online", double(now));
+    }
+    QJsonObject update(typed("updateUserStatus"));
+    update.insert(USER_ID, double(userId));
+    update.insert("status", status);
+    post(update);
+}
+
+void TDLibSimulator::downloadProgress()
+{
+    if (!downloads.isEmpty()) {
+        const int index = int(random() % downloads.count());
+        Download &download = downloads[index];
+        download.downloadedSize = qMin(download.downloadedSize + FILE_SIZE / FILE_PROGRESS_STEPS, FILE_SIZE);
+        QJsonObject update(typed("updateFile"));
+        update.insert("file", file(download.fileId, download.downloadedSize));
+        post(update);
+        if (download.downloadedSize == FILE_SIZE) {
+            if (download.requested) {
+                downloads.remove(index);
+            } else {
+                // Start over, there's always something being downloaded
+                download.downloadedSize = 0;
+            }
+        }
+    }
+}
+
+void TDLibSimulator::folderChange()
+{
+    // The last folder comes and goes
+    const int lastFolderId = FOLDER_COUNT - 1;
+    if (ready) {
+        folderCount = (folderCount == FOLDER_COUNT) ? (FOLDER_COUNT - 1) : FOLDER_COUNT;
+        LOG("Folder count" << folderCount);
+    }
+    QJsonArray folderInfos;
+    for (int folderId = 0; folderId < folderCount; folderId++) {
+        folderInfos.append(folderInfo(folderId));
+    }
+    QJsonObject update(typed("updateChatFolders"));
+    update.insert("chat_folders", folderInfos);
+    update.insert("main_chat_list_position", 0);
+    post(update);
+
+    if (ready && folderCount < FOLDER_COUNT) {
+        // Chats get removed from the folder which is gone
+        for (int i = 0; i < chats.count() && i < loadedFolderChats.at(lastFolderId); i++) {
+            if (isInFolder(i, lastFolderId)) {
+                QJsonObject positionUpdate(typed("updateChatPosition"));
+                positionUpdate.insert(CHAT_ID, double(chats.at(i).id));
+                positionUpdate.insert(POSITION, chatPosition(folderList(lastFolderId), 0));
+                post(positionUpdate);
+            }
+        }
+        loadedFolderChats[lastFolderId] = 0;
+    }
+}
+
+void TDLibSimulator::loadChats(const QJsonObject &request)
+{
+    const QJsonValue extra(request.value(_EXTRA));
+    const QJsonObject list(request.value(CHAT_LIST).toObject());
+    const int limit = qMax(request.value(LIMIT).toInt(), 1);
+    const bool folder = (list.value(_TYPE).toString() == TYPE_CHAT_LIST_FOLDER);
+    const int folderId = list.value(CHAT_FOLDER_ID).toInt();
+    if (folder && (folderId < 0 || folderId >= folderCount)) {
+        postError(400, "Chat list not found", extra);
+        return;
+    }
+
+    int &loaded = folder ? loadedFolderChats[folderId] : loadedChats;
+    if (loaded >= chats.count()) {
+        // That's how TDLib says that all chats have been loaded
+        postError(404, "Not Found", extra);
+        return;
+    }
+
+    const QJsonObject positionList(folder ? folderList(folderId) : typed(TYPE_CHAT_LIST_MAIN));
+    int count = 0;
+    for (; loaded < chats.count() && count < limit; loaded++) {
+        if (!folder || isInFolder(loaded, folderId)) {
+            const Chat &chat = chats.at(loaded);
+            QJsonObject update(typed("updateChatPosition"));
+            update.insert(CHAT_ID, double(chat.id));
+            update.insert(POSITION, chatPosition(positionList, chat.order));
+            post(update);
+            count++;
+        }
+    }
+    postOk(extra);
+}
+
+void TDLibSimulator::getChatHistory(const QJsonObject &request)
+{
+    const QJsonValue extra(request.value(_EXTRA));
+    const int index = findChat(qint64(request.value(CHAT_ID).toDouble()));
+    if (index < 0) {
+        postError(400, "Chat not found", extra);
+        return;
+    }
+
+    // Messages are returned newest first, starting with from_message_id
+    // (or the last message) moved by the (usually negative) offset
+    const Chat &chat = chats.at(index);
+    const qint64 fromMessageId = qint64(request.value(FROM_MESSAGE_ID).toDouble());
+    const int offset = request.value(OFFSET).toInt();
+    const int limit = qBound(1, request.value(LIMIT).toInt(), 100);
+    qint64 messageId = qMin(fromMessageId ? (fromMessageId + offset * MESSAGE_ID_STEP) : chat.lastMessageId, chat.lastMessageId);
+    QJsonArray messageList;
+    for (; messageId >= MESSAGE_ID_STEP && messageList.count() < limit; messageId -= MESSAGE_ID_STEP) {
+        messageList.append(message(chat, messageId));
+    }
+    QJsonObject result(typed("messages"));
+    result.insert("total_count", messageList.count());
+    result.insert("messages", messageList);
+    post(result, extra);
+}
+
+QJsonObject TDLibSimulator::user(qint64 userId) const
+{
+    QJsonObject user(typed("user"));
+    user.insert(ID, double(userId));
+    user.insert("first_name", (userId == SELF_USER_ID) ? QString("Simulated") : QString("User"));
+    user.insert("last_name", QString::number(userId));
+    QJsonObject usernames(typed("usernames"));
+    const QString username(QString("user%1").arg(userId));
+    usernames.insert("active_usernames", QJsonArray() << username);
+    usernames.insert("disabled_usernames", QJsonArray());
+    usernames.insert("editable_username", username);
+    user.insert("usernames", usernames);
+    user.insert("phone_number", QString::number(10000000000LL + userId));
+    QJsonObject status(typed("userStatusOffline"));
+    status.insert("was_online", double(startTime - userId % 86400));
+    user.insert("status", status);
+    user.insert("is_contact", userId % 3 == 0);
+    user.insert("have_access", true);
+    user.insert("type", typed("userTypeRegular"));
+    user.insert("language_code", QString("en"));
+    return user;
+}
+
+QJsonObject TDLibSimulator::chat(const Chat &chat) const
+{
+    QJsonObject object(typed("chat"));
+    object.insert(ID, double(chat.id));
+    if (chat.id < 0) {
+        QJsonObject type(typed("chatTypeBasicGroup"));
+        type.insert("basic_group_id", double(-chat.id));
+        object.insert("type", type);
+        object.insert(TITLE, QString("Group %1").arg(-chat.id));
+    } else {
+        QJsonObject type(typed("chatTypePrivate"));
+        type.insert(USER_ID, double(chat.userId));
+        object.insert("type", type);
+        object.insert(TITLE, QString("User %1").arg(chat.userId));
+    }
+    QJsonObject permissions(typed("chatPermissions"));
+    permissions.insert("can_send_basic_messages", true);
+    permissions.insert("can_send_other_messages", true);
+    permissions.insert("can_add_web_page_previews", true);
+    object.insert("permissions", permissions);
+    object.insert("last_message", message(chat, chat.lastMessageId));
+    QJsonArray positions;
+    positions.append(chatPosition(typed(TYPE_CHAT_LIST_MAIN), chat.order));
+    object.insert(POSITIONS, positions);
+    object.insert("unread_count", chat.unreadCount);
+    object.insert("last_read_inbox_message_id", double(chat.lastMessageId - chat.unreadCount * MESSAGE_ID_STEP));
+    object.insert("last_read_outbox_message_id", double(chat.lastMessageId));
+    object.insert("unread_mention_count", 0);
+    object.insert("unread_reaction_count", 0);
+    QJsonObject notificationSettings(typed("chatNotificationSettings"));
+    notificationSettings.insert("use_default_mute_for", true);
+    notificationSettings.insert("mute_for", 0);
+    object.insert("notification_settings", notificationSettings);
+    object.insert("available_reactions", typed("chatAvailableReactionsAll"));
+    object.insert("reply_markup_message_id", 0);
+    object.insert("draft_message", QJsonValue());
+    object.insert("client_data", QString());
+    return object;
+}
+
+QJsonObject TDLibSimulator::message(const Chat &chat, qint64 messageId) const
+{
+    const qint64 number = messageId / MESSAGE_ID_STEP;
+    const bool outgoing = (number % 4) == 0;
+    QJsonObject sender(typed("messageSenderUser"));
+    sender.insert(USER_ID, double(outgoing ? SELF_USER_ID : chat.userId));
+    QJsonObject text(typed("formattedText"));
+    text.insert("text", QString("Message %1 in chat %2").arg(number).arg(chat.id));
+    text.insert("entities", QJsonArray());
+    QJsonObject content(typed("messageText"));
+    content.insert("text", text);
+
+    QJsonObject message(typed("message"));
+    message.insert(ID, double(messageId));
+    message.insert(CHAT_ID, double(chat.id));
+    message.insert("sender_id", sender);
+    message.insert("is_outgoing", outgoing);
+    message.insert("can_be_edited", outgoing);
+    message.insert("can_be_deleted_only_for_self", true);
+    message.insert("can_be_deleted_for_all_users", outgoing);
+    // The history is a message a minute up to the start, messages generated
+    // since then are dated when they were generated. Only the date of the
+    // last one is known, the ones before it get a second less each.
+    const qint64 historyEnd = historySize * MESSAGE_ID_STEP;
+    const qint64 date = (messageId <= historyEnd) ?
+        (startTime - (historyEnd - messageId) / MESSAGE_ID_STEP * 60) :
+        qMax(startTime, chat.lastMessageDate - (chat.lastMessageId - messageId) / MESSAGE_ID_STEP);
+    message.insert("date", double(date));
+    message.insert("edit_date", 0);
+    message.insert("content", content);
+    return message;
+}
+
+QJsonObject TDLibSimulator::file(int fileId, int downloadedSize) const
+{
+    const bool completed = (downloadedSize >= FILE_SIZE);
+    QJsonObject local(typed("localFile"));
+    local.insert("path", completed ? QString("/tmp/fernschreiber-simulator/%1").arg(fileId) : QString());
+    local.insert("can_be_downloaded", true);
+    local.insert("can_be_deleted", completed);
+    local.insert("is_downloading_active", !completed);
+    local.insert("is_downloading_completed", completed);
+    local.insert("download_offset", 0);
+    local.insert("downloaded_prefix_size", downloadedSize);
+    local.insert("downloaded_size", downloadedSize);
+    QJsonObject remote(typed("remoteFile"));
+    remote.insert(ID, QString("simulated%1").arg(fileId));
+    remote.insert("unique_id", QString("unique%1").arg(fileId));
+    remote.insert("is_uploading_active", false);
+    remote.insert("is_uploading_completed", true);
+    remote.insert("uploaded_size", FILE_SIZE);
+    QJsonObject file(typed("file"));
+    file.insert(ID, fileId);
+    file.insert("size", FILE_SIZE);
+    file.insert("expected_size", FILE_SIZE);
+    file.insert("local", local);
+    file.insert("remote", remote);
+    return file;
+}
+
+QJsonObject TDLibSimulator::folderInfo(int folderId) const
+{
+    static const char* const titles[FOLDER_COUNT] = { "Even", "Thirds", "Fifths" };
+    QJsonObject info(typed("chatFolderInfo"));
+    info.insert(ID, folderId);
+    info.insert(TITLE, QString(titles[folderId % FOLDER_COUNT]));
+    info.insert("icon", typed("chatFolderIcon"));
+    return info;
+}
+
+QJsonObject TDLibSimulator::chatPosition(const QJsonObject &list, qint64 order) const
+{
+    QJsonObject position(typed("chatPosition"));
+    position.insert(LIST, list);
+    // int64 values are strings in TDLib JSON
+    position.insert(ORDER, QString::number(order));
+    position.insert(IS_PINNED, false);
+    return position;
+}
+
+QJsonObject TDLibSimulator::folderList(int folderId) const
+{
+    QJsonObject list(typed(TYPE_CHAT_LIST_FOLDER));
+    list.insert(CHAT_FOLDER_ID, folderId);
+    return list;
+}
+
+bool TDLibSimulator::isInFolder(int chatIndex, int folderId) const
+{
+    // Folder 0 has every 2nd chat, folder 1 every 3rd and so on
+    return folderId < folderCount && (chatIndex % (folderId + 2)) == 0;
+}
+
+int TDLibSimulator::findChat(qint64 chatId) const
+{
+    // Private chat ids are user ids, group chat ids are negative indices
+    const int index = (chatId < 0) ? int(-chatId - 1) : int(chatId - FIRST_USER_ID);
+    return (index >= 0 && index < chats.count() && chats.at(index).id == chatId) ? index : -1;
+}
+
+int TDLibSimulator::findDownload(int fileId) const
+{
+    // There are only a few of them
+    const int n = downloads.count();
+    for (int i = 0; i < n; i++) {
+        if (downloads.at(i).fileId == fileId) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+int td_create_client_id()
+{
+    QMutexLocker locker(&simulatorMutex);
+    const int clientId = ++lastClientId;
+    LOG("Creating simulated TDLib client" << clientId);
+    simulators.insert(clientId, new TDLibSimulator(clientId));
+    simulatorCondition.wakeAll();
+    return clientId;
+}
+
+void td_send(int clientId, const char *request)
+{
+    QMutexLocker locker(&simulatorMutex);
+    TDLibSimulator *simulator = simulators.value(clientId);
+    if (simulator) {
+        simulator->send(request);
+        simulatorCondition.wakeAll();
+    } else {
+        WARN("Invalid client id" << clientId);
+    }
+}
+
+const char *td_receive(double timeout)
+{
+    QMutexLocker locker(&simulatorMutex);
+    QByteArray result(takeSimulatorResult());
+    if (result.isEmpty() && timeout > 0) {
+        qint64 wait = qint64(timeout * 1000);
+        for (const TDLibSimulator *simulator : simulators) {
+            const qint64 next = simulator->nextEventTime();
+            if (next >= 0) {
+                wait = qMin(wait, next);
+            }
+        }
+        simulatorCondition.wait(&simulatorMutex, ulong(wait));
+        result = takeSimulatorResult();
+    }
+    if (result.isEmpty()) {
+        return Q_NULLPTR;
+    }
+    // Stays valid until the next call, just like with the real thing
+    currentResult = result;
+    return currentResult.constData();
+}
+
+const char *td_execute(const char *)
+{
+    return Q_NULLPTR;
+}
@@ -0,0 +1,131 @@
+/*
+    Copyright (C) 2020 Sebastian J. Wolf and other contributors
+
+    This file is part of Fernschreiber.
+
+    Fernschreiber is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Fernschreiber is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Fernschreiber. If not, see <http://www.gnu.org/licenses/>.
+*/
+#include "tdlibupdates.h"
+
+namespace {
+    const QString ID("id");
+    const QString EXPECTED_SIZE("expected_size");
+    const QString SIZE("size");
+    const QString LOCAL("local");
+    const QString CAN_BE_DELETED("can_be_deleted");
+    const QString CAN_BE_DOWNLOADED("can_be_downloaded");
+    const QString DOWNLOAD_OFFSET("download_offset");
+    const QString DOWNLOADED_PREFIX_SIZE("downloaded_prefix_size");
+    const QString DOWNLOADED_SIZE("downloaded_size");
+    const QString IS_DOWNLODING_ACTIVE("is_downloading_active");
+    const QString IS_DOWNLODING_COMPELETED("is_downloading_completed");
+    const QString PATH("path");
+    const QString REMOTE("remote");
+    const QString IS_UPLOADING_ACTIVE("is_uploading_active");
+    const QString IS_UPLOADING_COMPLETED("is_uploading_completed");
+    const QString UNIQUE_ID("unique_id");
+    const QString UPLOADED_SIZE("uploaded_size");
+    const QString LIST("list");
+    const QString ORDER("order");
+    const QString IS_PINNED("is_pinned");
+    const QString CHAT_FOLDER_ID("chat_folder_id");
+
+    const QString _TYPE("@type");
+    const QString TYPE_FILE("file");
+    const QString TYPE_LOCAL_FILE("localFile");
+    const QString TYPE_REMOTE_FILE("remoteFile");
+    const QString TYPE_CHAT_LIST_MAIN("chatListMain");
+    const QString TYPE_CHAT_LIST_ARCHIVE("chatListArchive");
+}
+
+ChatPositionUpdate::ChatPositionUpdate(qlonglong id, const QVariantMap &position) :
+    chatId(id),
+    chatListId(chatListIdFromMap(position.value(LIST).toMap())),
+    order(position.value(ORDER).toLongLong()),
+    isPinned(position.value(IS_PINNED).toBool())
+{
+}
+
+qlonglong ChatPositionUpdate::chatListIdFromMap(const QVariantMap &list)
+{
+    const QString type(list.value(_TYPE).toString());
+    return (type == TYPE_CHAT_LIST_MAIN) ? ChatListMain :
+        (type == TYPE_CHAT_LIST_ARCHIVE) ? ChatListArchive :
+        list.value(CHAT_FOLDER_ID).toLongLong();
+}
+
+FileUpdate::FileUpdate() :
+    isValid(false),
+    id(0),
+    expectedSize(0),
+    size(0),
+    hasLocal(false),
+    downloadOffset(0),
+    downloadedPrefixSize(0),
+    downloadedSize(0),
+    canBeDeleted(false),
+    canBeDownloaded(false),
+    isDownloadingActive(false),
+    isDownloadingCompleted(false),
+    hasRemote(false),
+    uploadedSize(0),
+    isUploadingActive(false),
+    isUploadingCompleted(false)
+{
+}
+
+FileUpdate::FileUpdate(const QVariantMap &fileInfo) : FileUpdate()
+{
+    if (fileInfo.value(_TYPE).toString() == TYPE_FILE) {
+        isValid = true;
+        file = fileInfo;
+        id = fileInfo.value(ID).toInt();
+        expectedSize = fileInfo.value(EXPECTED_SIZE).toLongLong();
+        size = fileInfo.value(SIZE).toLongLong();
+
+        const QVariantMap local(fileInfo.value(LOCAL).toMap());
+        if (local.value(_TYPE).toString() == TYPE_LOCAL_FILE) {
+            hasLocal = true;
+            path = local.value(PATH).toString();
+            downloadOffset = local.value(DOWNLOAD_OFFSET).toLongLong();
+            downloadedPrefixSize = local.value(DOWNLOADED_PREFIX_SIZE).toLongLong();
+            downloadedSize = local.value(DOWNLOADED_SIZE).toLongLong();
+            canBeDeleted = local.value(CAN_BE_DELETED).toBool();
+            canBeDownloaded = local.value(CAN_BE_DOWNLOADED).toBool();
+            isDownloadingActive = local.value(IS_DOWNLODING_ACTIVE).toBool();
+            isDownloadingCompleted = local.value(IS_DOWNLODING_COMPELETED).toBool();
+        }
+
+        const QVariantMap remote(fileInfo.value(REMOTE).toMap());
+        if (remote.value(_TYPE).toString() == TYPE_REMOTE_FILE) {
+            hasRemote = true;
+            remoteId = remote.value(ID).toString();
+            uniqueId = remote.value(UNIQUE_ID).toString();
+            uploadedSize = remote.value(UPLOADED_SIZE).toLongLong();
+            isUploadingActive = remote.value(IS_UPLOADING_ACTIVE).toBool();
+            isUploadingCompleted = remote.value(IS_UPLOADING_COMPLETED).toBool();
+        }
+    }
+}
+
+void registerTDLibUpdateTypes()
+{
+    // Needed for queued connections and string based connect()
+    qRegisterMetaType<ChatPositionUpdate>("ChatPositionUpdate");
+    qRegisterMetaType<ChatLastMessageUpdate>("ChatLastMessageUpdate");
+    qRegisterMetaType<ChatReadInboxUpdate>("ChatReadInboxUpdate");
+    qRegisterMetaType<ChatReadOutboxUpdate>("ChatReadOutboxUpdate");
+    qRegisterMetaType<UserStatusUpdate>("UserStatusUpdate");
+    qRegisterMetaType<FileUpdate>("FileUpdate");
+}
@@ -0,0 +1,111 @@
+/*
+    Copyright (C) 2020 Sebastian J. Wolf and other contributors
+
+    This file is part of Fernschreiber.
+
+    Fernschreiber is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Fernschreiber is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Fernschreiber. If not, see <http://www.gnu.org/licenses/>.
+*/
+#ifndef TDLIBUPDATES_H
+#define TDLIBUPDATES_H
+
+#include <QMetaType>
+#include <QString>
+#include <QVariantMap>
+
+// Compact representations of the most frequent TDLib updates. These are
+// filled once by the TDLibReceiver handlers, off the main thread, so that
+// the models don't have to dig the same values out of nested QVariantMaps
+// over and over again. The main thread only gets the finished structs.
+// Where QML needs the original object, it's kept as a map next to the
+// typed fields.
+
+struct ChatPositionUpdate {
+    // Chat list ids, the positive ones are chat folder ids
+    enum { ChatListMain = 0, ChatListArchive = -1 };
+    ChatPositionUpdate() : chatId(0), chatListId(ChatListMain), order(0), isPinned(false) {}
+    ChatPositionUpdate(qlonglong chatId, const QVariantMap &position);
+    static qlonglong chatListIdFromMap(const QVariantMap &list);
+    qlonglong chatId;
+    qlonglong chatListId;
+    qlonglong order; // Zero if the chat has been removed from the list
+    bool isPinned;
+};
+
+struct ChatLastMessageUpdate {
+    ChatLastMessageUpdate() : chatId(0), order(-1) {}
+    qlonglong chatId;
+    qlonglong order; // Negative if the update has no main list position
+    QVariantMap lastMessage;
+};
+
+struct ChatReadInboxUpdate {
+    ChatReadInboxUpdate() : chatId(0), lastReadInboxMessageId(0), unreadCount(0) {}
+    qlonglong chatId;
+    qlonglong lastReadInboxMessageId;
+    int unreadCount;
+};
+
+struct ChatReadOutboxUpdate {
+    ChatReadOutboxUpdate() : chatId(0), lastReadOutboxMessageId(0) {}
+    qlonglong chatId;
+    qlonglong lastReadOutboxMessageId;
+};
+
+struct UserStatusUpdate {
+    UserStatusUpdate() : userId(0), wasOnline(0) {}
+    qlonglong userId;
+    QString type;
+    qlonglong wasOnline;
+    QVariantMap status;
+};
+
+struct FileUpdate {
+    FileUpdate();
+    explicit FileUpdate(const QVariantMap &file);
+
+    bool isValid;
+    int id;
+    qlonglong expectedSize;
+    qlonglong size;
+    // localFile
+    bool hasLocal;
+    QString path;
+    qlonglong downloadOffset;
+    qlonglong downloadedPrefixSize;
+    qlonglong downloadedSize;
+    bool canBeDeleted;
+    bool canBeDownloaded;
+    bool isDownloadingActive;
+    bool isDownloadingCompleted;
+    // remoteFile
+    bool hasRemote;
+    QString remoteId;
+    QString uniqueId;
+    qlonglong uploadedSize;
+    bool isUploadingActive;
+    bool isUploadingCompleted;
+    // The whole thing, for QML
+    QVariantMap file;
+};
+
+Q_DECLARE_METATYPE(ChatPositionUpdate)
+Q_DECLARE_METATYPE(ChatLastMessageUpdate)
+Q_DECLARE_METATYPE(ChatReadInboxUpdate)
+Q_DECLARE_METATYPE(ChatReadOutboxUpdate)
+Q_DECLARE_METATYPE(UserStatusUpdate)
+Q_DECLARE_METATYPE(FileUpdate)
+
+void registerTDLibUpdateTypes();
+
+#endif // TDLIBUPDATES_H
@@ -20,12 +20,15 @@
 #include "tdlibwrapper.h"
 #include "tdlibsecrets.h"
 #include <QDir>
+#include <QElapsedTimer>
 #include <QFile>
 #include <QFileInfo>
 #include <QGuiApplication>
 #include <QLocale>
 #include <QProcess>
 #include <QSysInfo>
+#include <QThread>
+#include <QTimer>
 #include <QJsonDocument>
 #include <QStandardPaths>
 #include <QDBusConnection>
@@ -67,13 +70,51 @@ namespace {
     const QString REACTION_TYPE("reaction_type");
     const QString REACTION_TYPE_EMOJI("reactionTypeEmoji");
     const QString EMOJI("emoji");
+    const QString PERMISSIONS("permissions");
+    const QString MEMBER_COUNT("member_count");
+    const QString IS_VERIFIED("is_verified");
     const QString TYPE_MESSAGE_REPLY_TO_MESSAGE("messageReplyToMessage");
     const QString TYPE_INPUT_MESSAGE_REPLY_TO_MESSAGE("inputMessageReplyToMessage");
+
+    // Record the raw update stream or replay a recording instead of talking to TDLib
+    const char ENV_RECORD[] = "FERNSCHREIBER_RECORD";
+    const char ENV_REPLAY[] = "FERNSCHREIBER_REPLAY";
+    const char ENV_REPLAY_SPEED[] = "FERNSCHREIBER_REPLAY_SPEED";
+
+    // Limits of the update batches handed over to the main thread,
+    // a batch size of zero delivers every update on its own
+    const char ENV_BATCH_SIZE[] = "FERNSCHREIBER_BATCH_SIZE";
+    const char ENV_BATCH_LATENCY[] = "FERNSCHREIBER_BATCH_LATENCY"; // ms
+
+    const char CLOSE_REQUEST[] = "{\"@type\":\"close\"}";
+    const int CLOSE_TIMEOUT = 5000; // ms
+
+    // Reported to TDLibResponse when there's no point in waiting
+    const int REQUEST_NOT_SENT_CODE = 500;
+    const int MESSAGE_REQUEST_TIMEOUT = 30000; // ms
+    const int MESSAGE_NOT_FOUND_CODE = 404;
+
+    // The chat list is loaded in growing pages, the first one is supposed
+    // to fill the screen. That's what we ask for when we don't know better.
+    const int CHAT_PAGE_SIZE_DEFAULT = 20;
+    const int CHAT_PAGE_SIZE_MAX = 400;
+    const int CHAT_PAGE_TIMEOUT = 60000; // ms
+    const int CHAT_LIST_NOT_FOUND_CODE = 404;
+    // A failed page is retried with exponential backoff (1, 2, 4... s)
+    const int CHAT_PAGE_RETRY_MAX = 5;
+    const int CHAT_PAGE_RETRY_DELAY = 1000; // ms
+
+    // Requests in flight per priority class, interactive ones are never held back
+    const int VISIBLE_MEDIA_REQUEST_LIMIT = 4;
+    const int BACKGROUND_REQUEST_LIMIT = 2;
+    const QString DOWNLOAD_HOLD_KEY("download:");
 }
 
 TDLibWrapper::TDLibWrapper(AppSettings *settings, MceInterface *mce, QObject *parent)
     : QObject(parent)
-    , tdLibClient(td_json_client_create())
+    , tdLibClientId(td_create_client_id())
+    , lastResponseId(0)
+    , requestQueue(PriorityBackground + 1)
     , manager(new QNetworkAccessManager(this))
     , networkConfigurationManager(new QNetworkConfigurationManager(this))
     , appSettings(settings)
@@ -82,9 +123,22 @@ TDLibWrapper::TDLibWrapper(AppSettings *settings, MceInterface *mce, QObject *pa
     , versionNumber(0)
     , joinChatRequested(false)
     , isLoggingOut(false)
+    , recordingFile(QString::fromLocal8Bit(qgetenv(ENV_RECORD)))
+    , replayFile(QString::fromLocal8Bit(qgetenv(ENV_REPLAY)))
+    , replayMode(false)
+    , chatListLoading(false)
+    , chatPageSize(0)
+    , chatPagesLoaded(0)
+    , chatPageRetries(0)
+    , chatListFirstPageTime(-1)
+    , chatListFirstPaintTime(-1)
+    , chatListCompleteTime(-1)
 {
     LOG("Initializing TD Lib...");
 
+    registerTDLibUpdateTypes();
+    requestQueue.setLimit(PriorityVisibleMedia, VISIBLE_MEDIA_REQUEST_LIMIT);
+    requestQueue.setLimit(PriorityBackground, BACKGROUND_REQUEST_LIMIT);
     initializeTDLibReceiver();
     QString tdLibDatabaseDirectoryPath = getApplicationDataPath() + "/tdlib";
     QDir tdLibDatabaseDirectory(tdLibDatabaseDirectoryPath);
@@ -93,6 +147,7 @@ TDLibWrapper::TDLibWrapper(AppSettings *settings, MceInterface *mce, QObject *pa
     }
 
     this->dbusInterface = new DBusInterface(this);
+    this->dbusInterface->getDBusAdaptor()->setTDLibWrapper(this);
     if (this->appSettings->getUseOpenWith()) {
         this->initializeOpenWith();
     } else {
@@ -104,6 +159,7 @@ TDLibWrapper::TDLibWrapper(AppSettings *settings, MceInterface *mce, QObject *pa
     connect(this->appSettings, SIGNAL(useOpenWithChanged()), this, SLOT(handleOpenWithChanged()));
     connect(this->appSettings, SIGNAL(storageOptimizerChanged()), this, SLOT(handleStorageOptimizerChanged()));
     connect(qGuiApp, SIGNAL(applicationStateChanged(Qt::ApplicationState)), this, SLOT(handleApplicationStateChanged(Qt::ApplicationState)));
+    QDBusConnection::systemBus().connect("com.nokia.mce", "/com/nokia/mce/signal", "com.nokia.mce.signal", "display_status_ind", this, SLOT(handleDisplayStatusChanged(QString)));
     connect(networkConfigurationManager, SIGNAL(configurationChanged(QNetworkConfiguration)), this, SLOT(handleNetworkConfigurationChanged(QNetworkConfiguration)));
 
     this->setLogVerbosityLevel();
@@ -113,32 +169,57 @@ TDLibWrapper::TDLibWrapper(AppSettings *settings, MceInterface *mce, QObject *pa
 TDLibWrapper::~TDLibWrapper()
 {
     LOG("Destroying TD Lib...");
-    this->tdLibReceiver->setActive(false);
-    while (this->tdLibReceiver->isRunning()) {
-        QCoreApplication::processEvents(QEventLoop::AllEvents, 1000);
+    if (!this->replayMode && !this->tdLibReceiver->isClosed()) {
+        // There's no such thing as destroying a client id, ask the client
+        // to close and give it some time to flush its databases
+        td_send(this->tdLibClientId, CLOSE_REQUEST);
+        QElapsedTimer closeTimer;
+        closeTimer.start();
+        while (!this->tdLibReceiver->isClosed() && closeTimer.elapsed() < CLOSE_TIMEOUT) {
+            QThread::msleep(10);
+        }
     }
+    this->tdLibReceiver->setActive(false);
     qDeleteAll(basicGroups.values());
     qDeleteAll(superGroups.values());
-    td_json_client_destroy(this->tdLibClient);
 }
 
 void TDLibWrapper::initializeTDLibReceiver() {
-    this->tdLibReceiver = new TDLibReceiver(this->tdLibClient, this);
+    this->tdLibReceiver = new TDLibReceiver(this->tdLibClientId, this);
+    // The chat store goes first, everything else expects it to be up to date
+    connect(this->tdLibReceiver, SIGNAL(newChatDiscovered(QVariantMap)), &this->chats, SLOT(handleNewChat(QVariantMap)));
+    connect(this->tdLibReceiver, SIGNAL(chatTitleUpdated(QString, QString)), &this->chats, SLOT(handleChatTitleUpdated(QString, QString)));
+    connect(this->tdLibReceiver, SIGNAL(chatPhotoUpdated(qlonglong, QVariantMap)), &this->chats, SLOT(handleChatPhotoUpdated(qlonglong, QVariantMap)));
+    connect(this->tdLibReceiver, SIGNAL(chatLastMessageUpdated(ChatLastMessageUpdate)), &this->chats, SLOT(handleChatLastMessageUpdated(ChatLastMessageUpdate)));
+    connect(this->tdLibReceiver, SIGNAL(chatPositionUpdated(ChatPositionUpdate)), &this->chats, SLOT(handleChatPositionUpdated(ChatPositionUpdate)));
+    connect(this->tdLibReceiver, SIGNAL(chatReadInboxUpdated(ChatReadInboxUpdate)), &this->chats, SLOT(handleChatReadInboxUpdated(ChatReadInboxUpdate)));
+    connect(this->tdLibReceiver, SIGNAL(chatReadOutboxUpdated(ChatReadOutboxUpdate)), &this->chats, SLOT(handleChatReadOutboxUpdated(ChatReadOutboxUpdate)));
+    connect(this->tdLibReceiver, SIGNAL(chatUnreadMentionCountUpdated(qlonglong, int)), &this->chats, SLOT(handleChatUnreadMentionCountUpdated(qlonglong, int)));
+    connect(this->tdLibReceiver, SIGNAL(chatUnreadReactionCountUpdated(qlonglong, int)), &this->chats, SLOT(handleChatUnreadReactionCountUpdated(qlonglong, int)));
+    connect(this->tdLibReceiver, SIGNAL(chatAvailableReactionsUpdated(qlonglong, QVariantMap)), &this->chats, SLOT(handleChatAvailableReactionsUpdated(qlonglong, QVariantMap)));
+    connect(this->tdLibReceiver, SIGNAL(chatNotificationSettingsUpdated(QString, QVariantMap)), &this->chats, SLOT(handleChatNotificationSettingsUpdated(QString, QVariantMap)));
+    connect(this->tdLibReceiver, SIGNAL(chatDraftMessageUpdated(qlonglong, QVariantMap, QString)), &this->chats, SLOT(handleChatDraftMessageUpdated(qlonglong, QVariantMap)));
+    connect(this->tdLibReceiver, SIGNAL(chatIsMarkedAsUnreadUpdated(qlonglong, bool)), &this->chats, SLOT(handleChatIsMarkedAsUnreadUpdated(qlonglong, bool)));
+    connect(this->tdLibReceiver, SIGNAL(chatPinnedMessageUpdated(qlonglong, qlonglong)), &this->chats, SLOT(handleChatPinnedMessageUpdated(qlonglong, qlonglong)));
+    connect(this->tdLibReceiver, SIGNAL(chatPermissionsUpdated(QString, QVariantMap)), &this->chats, SLOT(handleChatPermissionsUpdated(QString, QVariantMap)));
+    connect(this->tdLibReceiver, SIGNAL(messageSendSucceeded(qlonglong, qlonglong, QVariantMap)), &this->chats, SLOT(handleMessageSendSucceeded(qlonglong, qlonglong, QVariantMap)));
+
     connect(this->tdLibReceiver, SIGNAL(versionDetected(QString)), this, SLOT(handleVersionDetected(QString)));
     connect(this->tdLibReceiver, SIGNAL(authorizationStateChanged(QString, QVariantMap)), this, SLOT(handleAuthorizationStateChanged(QString, QVariantMap)));
     connect(this->tdLibReceiver, SIGNAL(optionUpdated(QString, QVariant)), this, SLOT(handleOptionUpdated(QString, QVariant)));
     connect(this->tdLibReceiver, SIGNAL(connectionStateChanged(QString)), this, SLOT(handleConnectionStateChanged(QString)));
     connect(this->tdLibReceiver, SIGNAL(userUpdated(QVariantMap)), this, SLOT(handleUserUpdated(QVariantMap)));
-    connect(this->tdLibReceiver, SIGNAL(userStatusUpdated(QString, QVariantMap)), this, SLOT(handleUserStatusUpdated(QString, QVariantMap)));
-    connect(this->tdLibReceiver, SIGNAL(fileUpdated(QVariantMap)), this, SLOT(handleFileUpdated(QVariantMap)));
+    connect(this->tdLibReceiver, SIGNAL(userStatusUpdated(UserStatusUpdate)), this, SLOT(handleUserStatusUpdated(UserStatusUpdate)));
+    connect(this->tdLibReceiver, SIGNAL(fileUpdated(FileUpdate)), this, SLOT(handleFileUpdated(FileUpdate)));
     connect(this->tdLibReceiver, SIGNAL(newChatDiscovered(QVariantMap)), this, SLOT(handleNewChatDiscovered(QVariantMap)));
     connect(this->tdLibReceiver, SIGNAL(updateChatFolders(QVariantList, qlonglong)), this, SLOT(handleChatFolders(QVariantList, qlonglong)));
     connect(this->tdLibReceiver, SIGNAL(unreadMessageCountUpdated(QVariantMap)), this, SLOT(handleUnreadMessageCountUpdated(QVariantMap)));
     connect(this->tdLibReceiver, SIGNAL(unreadChatCountUpdated(QVariantMap)), this, SLOT(handleUnreadChatCountUpdated(QVariantMap)));
-    connect(this->tdLibReceiver, SIGNAL(chatLastMessageUpdated(QString, QString, QVariantMap)), this, SIGNAL(chatLastMessageUpdated(QString, QString, QVariantMap)));
+    connect(this->tdLibReceiver, SIGNAL(chatLastMessageUpdated(ChatLastMessageUpdate)), this, SLOT(handleChatLastMessageUpdated(ChatLastMessageUpdate)));
     connect(this->tdLibReceiver, SIGNAL(chatOrderUpdated(QString, QString)), this, SIGNAL(chatOrderUpdated(QString, QString)));
-    connect(this->tdLibReceiver, SIGNAL(chatReadInboxUpdated(QString, QString, int)), this, SIGNAL(chatReadInboxUpdated(QString, QString, int)));
-    connect(this->tdLibReceiver, SIGNAL(chatReadOutboxUpdated(QString, QString)), this, SIGNAL(chatReadOutboxUpdated(QString, QString)));
+    connect(this->tdLibReceiver, SIGNAL(chatPositionUpdated(ChatPositionUpdate)), this, SLOT(handleChatPositionUpdated(ChatPositionUpdate)));
+    connect(this->tdLibReceiver, SIGNAL(chatReadInboxUpdated(ChatReadInboxUpdate)), this, SIGNAL(chatReadInboxUpdate(ChatReadInboxUpdate)));
+    connect(this->tdLibReceiver, SIGNAL(chatReadOutboxUpdated(ChatReadOutboxUpdate)), this, SIGNAL(chatReadOutboxUpdate(ChatReadOutboxUpdate)));
     connect(this->tdLibReceiver, SIGNAL(chatAvailableReactionsUpdated(qlonglong, QVariantMap)), this, SLOT(handleAvailableReactionsUpdated(qlonglong, QVariantMap)));
     connect(this->tdLibReceiver, SIGNAL(basicGroupUpdated(qlonglong, QVariantMap)), this, SLOT(handleBasicGroupUpdated(qlonglong, QVariantMap)));
     connect(this->tdLibReceiver, SIGNAL(superGroupUpdated(qlonglong, QVariantMap)), this, SLOT(handleSuperGroupUpdated(qlonglong, QVariantMap)));
@@ -175,7 +256,6 @@ void TDLibWrapper::initializeTDLibReceiver() {
     connect(this->tdLibReceiver, SIGNAL(chatPermissionsUpdated(QString, QVariantMap)), this, SIGNAL(chatPermissionsUpdated(QString, QVariantMap)));
     connect(this->tdLibReceiver, SIGNAL(chatPhotoUpdated(qlonglong, QVariantMap)), this, SIGNAL(chatPhotoUpdated(qlonglong, QVariantMap)));
     connect(this->tdLibReceiver, SIGNAL(chatTitleUpdated(QString, QString)), this, SIGNAL(chatTitleUpdated(QString, QString)));
-    connect(this->tdLibReceiver, SIGNAL(chatPinnedUpdated(qlonglong, bool)), this, SIGNAL(chatPinnedUpdated(qlonglong, bool)));
     connect(this->tdLibReceiver, SIGNAL(chatPinnedMessageUpdated(qlonglong, qlonglong)), this, SIGNAL(chatPinnedMessageUpdated(qlonglong, qlonglong)));
     connect(this->tdLibReceiver, SIGNAL(messageIsPinnedUpdated(qlonglong, qlonglong, bool)), this, SLOT(handleMessageIsPinnedUpdated(qlonglong, qlonglong, bool)));
     connect(this->tdLibReceiver, SIGNAL(usersReceived(QString, QVariantList, int)), this, SIGNAL(usersReceived(QString, QVariantList, int)));
@@ -196,7 +276,35 @@ void TDLibWrapper::initializeTDLibReceiver() {
     connect(this->tdLibReceiver, SIGNAL(chatUnreadMentionCountUpdated(qlonglong, int)), this, SIGNAL(chatUnreadMentionCountUpdated(qlonglong, int)));
     connect(this->tdLibReceiver, SIGNAL(chatUnreadReactionCountUpdated(qlonglong, int)), this, SIGNAL(chatUnreadReactionCountUpdated(qlonglong, int)));
     connect(this->tdLibReceiver, SIGNAL(activeEmojiReactionsUpdated(QStringList)), this, SLOT(handleActiveEmojiReactionsUpdated(QStringList)));
-    connect(this->tdLibReceiver, SIGNAL(gotChatFolder(QVarianMap)), this, SLOT(handleChatFolder(QVariantMap)));
+    connect(this->tdLibReceiver, SIGNAL(gotChatFolder(QVariantMap)), this, SLOT(handleChatFolder(QVariantMap)));
+    connect(this->tdLibReceiver, SIGNAL(responseReceived(QString, QVariantMap)), this, SLOT(handleResponseReceived(QString, QVariantMap)));
+    connect(this->tdLibReceiver, SIGNAL(queuedRequestCompleted(qlonglong, bool)), this, SLOT(handleQueuedRequestCompleted(qlonglong, bool)));
+
+    bool ok;
+    const int batchSize = qgetenv(ENV_BATCH_SIZE).toInt(&ok);
+    if (ok) {
+        this->tdLibReceiver->setBatchDelivery(batchSize > 0);
+        this->tdLibReceiver->setMaxBatchSize(batchSize);
+    }
+    const int batchLatency = qgetenv(ENV_BATCH_LATENCY).toInt(&ok);
+    if (ok) {
+        this->tdLibReceiver->setMaxBatchLatency(batchLatency);
+    }
+
+    // Both only apply to the first session, a reload starts from scratch
+    if (!this->replayFile.isEmpty()) {
+        const QByteArray speed(qgetenv(ENV_REPLAY_SPEED));
+        // "max" (or zero) replays the recording as fast as possible
+        const double replaySpeed = speed.isEmpty() ? 1.0 : (speed == "max") ? 0.0 : speed.toDouble();
+        this->replayMode = this->tdLibReceiver->setReplayFile(this->replayFile, replaySpeed);
+        this->replayFile.clear();
+    } else {
+        this->replayMode = false;
+        if (!this->recordingFile.isEmpty()) {
+            this->tdLibReceiver->setRecordingFile(this->recordingFile);
+            this->recordingFile.clear();
+        }
+    }
 
     this->tdLibReceiver->start();
 }
@@ -207,10 +315,118 @@ void TDLibWrapper::sendRequest(const QVariantMap &requestObject)
         LOG("Sending request to TD Lib skipped as logging out is in progress, object type name:" << requestObject.value(_TYPE).toString());
         return;
     }
+    if (this->replayMode) {
+        // Keep the replay offline and deterministic
+        LOG("Replaying, request not sent to TD Lib, object type name:" << requestObject.value(_TYPE).toString());
+        return;
+    }
     LOG("Sending request to TD Lib, object type name:" << requestObject.value(_TYPE).toString());
-    QJsonDocument requestDocument = QJsonDocument::fromVariant(requestObject);
-    VERBOSE(requestDocument.toJson().constData());
-    td_json_client_send(this->tdLibClient, requestDocument.toJson().constData());
+    const QByteArray requestJson(QJsonDocument::fromVariant(requestObject).toJson(QJsonDocument::Compact));
+    VERBOSE(requestJson.constData());
+    td_send(this->tdLibClientId, requestJson.constData());
+}
+
+void TDLibWrapper::sendRequest(TDLibRequest &request)
+{
+    if (this->isLoggingOut) {
+        LOG("Sending request to TD Lib skipped as logging out is in progress, object type name:" << request.type());
+        return;
+    }
+    if (this->replayMode) {
+        LOG("Replaying, request not sent to TD Lib, object type name:" << request.type());
+        return;
+    }
+    LOG("Sending request to TD Lib, object type name:" << request.type());
+    const QByteArray &requestJson = request.finish();
+    VERBOSE(requestJson.constData());
+    td_send(this->tdLibClientId, requestJson.constData());
+}
+
+TDLibResponse *TDLibWrapper::newResponse(int timeout)
+{
+    TDLibResponse *response = new TDLibResponse(TDLibResponse::makeExtra(++this->lastResponseId), timeout, this);
+    connect(response, SIGNAL(released(QString)), this, SLOT(handleResponseReleased(QString)));
+    this->pendingResponses.insert(response->getExtra(), response);
+    return response;
+}
+
+TDLibResponse *TDLibWrapper::sendRequest(const QVariantMap &requestObject, int timeout)
+{
+    // The replay runs at its own pace, see handleResponseReceived()
+    TDLibResponse *response = newResponse(this->replayMode ? 0 : timeout);
+    if (this->isLoggingOut) {
+        LOG("Request not sent to TD Lib, object type name:" << requestObject.value(_TYPE).toString());
+        response->failLater(REQUEST_NOT_SENT_CODE, "Request not sent");
+    } else if (this->replayMode) {
+        LOG("Replaying, waiting for the recorded response" << response->getExtra() << "object type name:" << requestObject.value(_TYPE).toString());
+    } else {
+        QVariantMap taggedRequest(requestObject);
+        taggedRequest.insert(_EXTRA, response->getExtra());
+        this->sendRequest(taggedRequest);
+    }
+    return response;
+}
+
+TDLibResponse *TDLibWrapper::sendRequest(TDLibRequest &request, int timeout)
+{
+    TDLibResponse *response = newResponse(this->replayMode ? 0 : timeout);
+    if (this->isLoggingOut) {
+        LOG("Request not sent to TD Lib, object type name:" << request.type());
+        response->failLater(REQUEST_NOT_SENT_CODE, "Request not sent");
+    } else if (this->replayMode) {
+        LOG("Replaying, waiting for the recorded response" << response->getExtra() << "object type name:" << request.type());
+    } else {
+        request.add("@extra", response->getExtra());
+        this->sendRequest(request);
+    }
+    return response;
+}
+
+void TDLibWrapper::queueRequest(const QVariantMap &requestObject, RequestPriority priority)
+{
+    if (priority == PriorityInteractive) {
+        this->sendRequest(requestObject);
+    } else if (this->isLoggingOut || this->replayMode) {
+        LOG("Request not queued, object type name:" << requestObject.value(_TYPE).toString());
+    } else {
+        // The queue adds its own @extra, the original one is passed along
+        QVariantMap untaggedRequest(requestObject);
+        const QString extra(untaggedRequest.take(_EXTRA).toString());
+        if (this->requestQueue.enqueue(priority, QJsonDocument::fromVariant(untaggedRequest).toJson(QJsonDocument::Compact), extra)) {
+            LOG("Queued request, object type name:" << requestObject.value(_TYPE).toString() << "priority" << priority);
+            sendQueuedRequests();
+        }
+    }
+}
+
+void TDLibWrapper::queueRequest(TDLibRequest &request, RequestPriority priority, const QString &holdKey)
+{
+    if (priority == PriorityInteractive) {
+        this->sendRequest(request);
+    } else if (this->isLoggingOut || this->replayMode) {
+        LOG("Request not queued, object type name:" << request.type());
+    } else if (this->requestQueue.enqueue(priority, request.finish(), QString(), holdKey)) {
+        LOG("Queued request, object type name:" << request.type() << "priority" << priority);
+        sendQueuedRequests();
+    }
+}
+
+void TDLibWrapper::sendQueuedRequests()
+{
+    QByteArray requestJson;
+    while (this->requestQueue.takeNext(&requestJson)) {
+        VERBOSE(requestJson.constData());
+        td_send(this->tdLibClientId, requestJson.constData());
+    }
+}
+
+void TDLibWrapper::failPendingResponses(int code, const QString &message)
+{
+    QHash<QString, TDLibResponse*> responses;
+    responses.swap(this->pendingResponses);
+    for (TDLibResponse *response : responses) {
+        response->failLater(code, message);
+    }
 }
 
 QString TDLibWrapper::getVersion()
@@ -284,26 +500,47 @@ void TDLibWrapper::logout()
 
 }
 
-void TDLibWrapper::getChats()
+void TDLibWrapper::getChats(int firstPageSize)
 {
-    LOG("Getting chats");
-    QVariantMap requestObject;
-    requestObject.insert(_TYPE, "loadChats");
-    requestObject.insert("limit", 5);
-    this->sendRequest(requestObject);
+    if (this->chatListLoading) {
+        LOG("Chat list is already being loaded");
+        return;
+    }
+    LOG("Getting chats, first page" << firstPageSize);
+    this->chatListLoading = true;
+    this->chatPageSize = (firstPageSize > 0) ? qMin(firstPageSize, CHAT_PAGE_SIZE_MAX) : CHAT_PAGE_SIZE_DEFAULT;
+    this->chatPagesLoaded = 0;
+    this->chatPageRetries = 0;
+    this->chatListFirstPageTime = -1;
+    this->chatListFirstPaintTime = -1;
+    this->chatListCompleteTime = -1;
+    this->chatListTimer.start();
+    this->loadNextChatPage();
 }
 
-void TDLibWrapper::downloadFile(int fileId)
+void TDLibWrapper::loadNextChatPage()
 {
-    LOG("Downloading file " << fileId);
-    QVariantMap requestObject;
-    requestObject.insert(_TYPE, "downloadFile");
-    requestObject.insert("file_id", fileId);
-    requestObject.insert("synchronous", false);
-    requestObject.insert("offset", 0);
-    requestObject.insert("limit", 0);
-    requestObject.insert("priority", 1);
-    this->sendRequest(requestObject);
+    LOG("Loading" << this->chatPageSize << "chats");
+    TDLibRequest request(this->requestBuffer, "loadChats");
+    request.add("limit", this->chatPageSize);
+    TDLibResponse *response = this->sendRequest(request, CHAT_PAGE_TIMEOUT);
+    connect(response, SIGNAL(finished(QVariantMap)), this, SLOT(handleChatPageLoaded()));
+    connect(response, SIGNAL(failed(int, QString)), this, SLOT(handleChatPageFailed(int, QString)));
+}
+
+void TDLibWrapper::downloadFile(int fileId, RequestPriority priority)
+{
+    LOG("Downloading file " << fileId << "priority" << priority);
+    TDLibRequest request(this->requestBuffer, "downloadFile");
+    request.add("file_id", fileId)
+        .add("synchronous", false)
+        .add("offset", 0)
+        .add("limit", 0)
+        .add("priority", 1);
+    // The response comes right away, a queued download counts against the
+    // limit until it's no longer active, see handleFileUpdated(). Downloads
+    // started by the user are sent right away and don't count at all.
+    this->queueRequest(request, priority, DOWNLOAD_HOLD_KEY + QString::number(fileId));
 }
 
 void TDLibWrapper::openChat(const QString &chatId)
@@ -364,27 +601,23 @@ void TDLibWrapper::getChatFolder(qlonglong folderID)
 void TDLibWrapper::getChatHistory(qlonglong chatId, qlonglong fromMessageId, int offset, int limit, bool onlyLocal)
 {
     LOG("Retrieving chat history" << chatId << fromMessageId << offset << limit << onlyLocal);
-    QVariantMap requestObject;
-    requestObject.insert(_TYPE, "getChatHistory");
-    requestObject.insert(CHAT_ID, chatId);
-    requestObject.insert("from_message_id", fromMessageId);
-    requestObject.insert("offset", offset);
-    requestObject.insert("limit", limit);
-    requestObject.insert("only_local", onlyLocal);
-    this->sendRequest(requestObject);
+    TDLibRequest request(this->requestBuffer, "getChatHistory");
+    request.add("chat_id", chatId)
+        .add("from_message_id", fromMessageId)
+        .add("offset", offset)
+        .add("limit", limit)
+        .add("only_local", onlyLocal);
+    this->sendRequest(request);
 }
 
 void TDLibWrapper::viewMessage(qlonglong chatId, qlonglong messageId, bool force)
 {
     LOG("Mark message as viewed" << chatId << messageId);
-    QVariantMap requestObject;
-    requestObject.insert(_TYPE, "viewMessages");
-    requestObject.insert(CHAT_ID, chatId);
-    requestObject.insert("force_read", force);
-    QVariantList messageIds;
-    messageIds.append(messageId);
-    requestObject.insert("message_ids", messageIds);
-    this->sendRequest(requestObject);
+    TDLibRequest request(this->requestBuffer, "viewMessages");
+    request.add("chat_id", chatId)
+        .add("force_read", force)
+        .add("message_ids", QList<qlonglong>() << messageId);
+    this->sendRequest(request);
 }
 
 void TDLibWrapper::pinMessage(const QString &chatId, const QString &messageId, bool disableNotification)
@@ -656,12 +889,13 @@ void TDLibWrapper::forwardMessages(const QString &chatId, const QString &fromCha
 void TDLibWrapper::getMessage(qlonglong chatId, qlonglong messageId)
 {
     LOG("Retrieving message" << chatId << messageId);
-    QVariantMap requestObject;
-    requestObject.insert(_TYPE, "getMessage");
-    requestObject.insert(CHAT_ID, chatId);
-    requestObject.insert(MESSAGE_ID, messageId);
-    requestObject.insert(_EXTRA, QString("getMessage:%1:%2").arg(chatId).arg(messageId));
-    this->sendRequest(requestObject);
+    TDLibRequest request(this->requestBuffer, "getMessage");
+    request.add("chat_id", chatId)
+        .add("message_id", messageId);
+    TDLibResponse *response = this->sendRequest(request, MESSAGE_REQUEST_TIMEOUT);
+    response->setContext(QVariantList() << chatId << messageId);
+    connect(response, SIGNAL(finished(QVariantMap)), this, SLOT(handleMessageResponse(QVariantMap)));
+    connect(response, SIGNAL(failed(int, QString)), this, SLOT(handleMessageResponseFailed(int, QString)));
 }
 
 void TDLibWrapper::getMessageLinkInfo(const QString &url, const QString &extra)
@@ -711,8 +945,10 @@ void TDLibWrapper::getChatPinnedMessage(qlonglong chatId)
     QVariantMap requestObject;
     requestObject.insert(_TYPE, "getChatPinnedMessage");
     requestObject.insert(CHAT_ID, chatId);
-    requestObject.insert(_EXTRA, "getChatPinnedMessage:" + QString::number(chatId));
-    this->sendRequest(requestObject);
+    TDLibResponse *response = this->sendRequest(requestObject, MESSAGE_REQUEST_TIMEOUT);
+    response->setContext(chatId);
+    connect(response, SIGNAL(finished(QVariantMap)), this, SLOT(handlePinnedMessageResponse(QVariantMap)));
+    connect(response, SIGNAL(failed(int, QString)), this, SLOT(handlePinnedMessageResponseFailed(int, QString)));
 }
 
 void TDLibWrapper::getChatSponsoredMessage(qlonglong chatId)
@@ -864,14 +1100,14 @@ void TDLibWrapper::getGroupFullInfo(const QString &groupId, bool isSuperGroup)
     this->sendRequest(requestObject);
 }
 
-void TDLibWrapper::getUserFullInfo(const QString &userId)
+void TDLibWrapper::getUserFullInfo(const QString &userId, RequestPriority priority)
 {
     LOG("Retrieving UserFullInfo" << userId);
     QVariantMap requestObject;
     requestObject.insert(_TYPE, "getUserFullInfo");
     requestObject.insert(_EXTRA, userId);
     requestObject.insert("user_id", userId);
-    this->sendRequest(requestObject);
+    this->queueRequest(requestObject, priority);
 }
 
 void TDLibWrapper::createPrivateChat(const QString &userId, const QString &extra)
@@ -1585,17 +1821,46 @@ QVariantMap TDLibWrapper::getUserInformation()
 QVariantMap TDLibWrapper::getUserInformation(const QString &userId)
 {
     // LOG("Returning user information for ID" << userId);
-    return this->usersById.value(userId).toMap();
+    return this->users.toMap(userId.toLongLong());
 }
 
 bool TDLibWrapper::hasUserInformation(const QString &userId)
 {
-    return this->usersById.contains(userId);
+    return this->users.contains(userId.toLongLong());
 }
 
 QVariantMap TDLibWrapper::getUserInformationByName(const QString &userName)
 {
-    return this->usersByName.value(userName).toMap();
+    return UserStore::toMap(this->users.findByUsername(userName));
+}
+
+QString TDLibWrapper::getUserFullName(const QString &userId) const
+{
+    const UserStore::User *user = this->users.value(userId.toLongLong());
+    return user ? user->fullName() : QString();
+}
+
+QString TDLibWrapper::getUserUsername(const QString &userId) const
+{
+    const UserStore::User *user = this->users.value(userId.toLongLong());
+    return (user && !user->usernames.isEmpty()) ? user->usernames.first() : QString();
+}
+
+QVariantMap TDLibWrapper::getUserStatus(const QString &userId) const
+{
+    const UserStore::User *user = this->users.value(userId.toLongLong());
+    return user ? user->status : QVariantMap();
+}
+
+int TDLibWrapper::getUserPhotoFileId(const QString &userId) const
+{
+    const UserStore::User *user = this->users.value(userId.toLongLong());
+    return user ? user->photoFileId : 0;
+}
+
+const UserStore::User *TDLibWrapper::getUser(qlonglong userId) const
+{
+    return this->users.value(userId);
 }
 
 TDLibWrapper::UserPrivacySettingRule TDLibWrapper::getUserPrivacySettingRule(TDLibWrapper::UserPrivacySetting userPrivacySetting)
@@ -1618,7 +1883,7 @@ QVariantMap TDLibWrapper::getBasicGroup(qlonglong groupId) const
     const Group* group = basicGroups.value(groupId);
     if (group) {
         LOG("Returning basic group information for ID" << groupId);
-        return group->groupInfo;
+        return group->toMap();
     } else {
         LOG("No super group information for ID" << groupId);
         return QVariantMap();
@@ -1630,7 +1895,7 @@ QVariantMap TDLibWrapper::getSuperGroup(qlonglong groupId) const
     const Group* group = superGroups.value(groupId);
     if (group) {
         LOG("Returning super group information for ID" << groupId);
-        return group->groupInfo;
+        return group->toMap();
     } else {
         LOG("No super group information for ID" << groupId);
         return QVariantMap();
@@ -1640,13 +1905,18 @@ QVariantMap TDLibWrapper::getSuperGroup(qlonglong groupId) const
 QVariantMap TDLibWrapper::getChat(const QString &chatId)
 {
     LOG("Returning chat information for ID" << chatId);
-    return this->chats.value(chatId).toMap();
+    return this->chats.getChat(chatId.toLongLong());
+}
+
+const ChatStore *TDLibWrapper::getChatStore() const
+{
+    return &this->chats;
 }
 
 QStringList TDLibWrapper::getChatReactions(const QString &chatId)
 {
     LOG("Obtaining chat reactions for chat" << chatId);
-    const QVariant available_reactions(chats.value(chatId).toMap().value(CHAT_AVAILABLE_REACTIONS));
+    const QVariant available_reactions(chats.getChat(chatId.toLongLong()).value(CHAT_AVAILABLE_REACTIONS));
     const QVariantMap map(available_reactions.toMap());
     const QString reactions_type(map.value(_TYPE).toString());
     if (reactions_type == CHAT_AVAILABLE_REACTIONS_ALL) {
@@ -1754,6 +2024,46 @@ DBusAdaptor *TDLibWrapper::getDBusAdaptor()
     return this->dbusInterface->getDBusAdaptor();
 }
 
+QVariantMap TDLibWrapper::benchmarkRequests(int iterations) const
+{
+    return TDLibRequest::benchmark(iterations);
+}
+
+QVariantMap TDLibWrapper::getReceiverStatistics() const
+{
+    return this->tdLibReceiver->getStatistics();
+}
+
+QVariantMap TDLibWrapper::getChatListStatistics() const
+{
+    // Times are in milliseconds since getChats, -1 if it hasn't happened yet
+    QVariantMap statistics;
+    statistics.insert("loading", this->chatListLoading);
+    statistics.insert("chats", this->chats.count());
+    statistics.insert("pages", this->chatPagesLoaded);
+    statistics.insert("page_size", this->chatPageSize);
+    statistics.insert("first_page", this->chatListFirstPageTime);
+    statistics.insert("first_paint", this->chatListFirstPaintTime);
+    statistics.insert("complete", this->chatListCompleteTime);
+    return statistics;
+}
+
+void TDLibWrapper::registerChatListPainted()
+{
+    if (this->chatListFirstPaintTime < 0 && this->chatListTimer.isValid()) {
+        this->chatListFirstPaintTime = this->chatListTimer.elapsed();
+        LOG("First chats shown after" << this->chatListFirstPaintTime << "ms");
+    }
+}
+
+QVariantMap TDLibWrapper::getRequestQueueStatistics() const
+{
+    QVariantMap statistics;
+    statistics.insert("visible_media", this->requestQueue.getStatistics(PriorityVisibleMedia));
+    statistics.insert("background", this->requestQueue.getStatistics(PriorityBackground));
+    return statistics;
+}
+
 void TDLibWrapper::handleVersionDetected(const QString &version)
 {
     this->versionString = version;
@@ -1824,17 +2134,16 @@ void TDLibWrapper::handleAuthorizationStateChanged(const QString &authorizationS
         LOG("Reloading TD Lib...");
         this->basicGroups.clear();
         this->superGroups.clear();
-        this->usersById.clear();
-        this->usersByName.clear();
+        this->users.clear();
+        this->chats.clear();
+        // The client is closed by now, its id can't be used anymore
         this->tdLibReceiver->setActive(false);
-        while (this->tdLibReceiver->isRunning()) {
-            QCoreApplication::processEvents(QEventLoop::AllEvents, 1000);
-        }
-        td_json_client_destroy(this->tdLibClient);
-        this->tdLibReceiver->terminate();
+        failPendingResponses(REQUEST_NOT_SENT_CODE, "TD Lib client closed");
+        this->requestQueue.clear();
+        this->tdLibReceiver->deleteLater();
         QDir appPath(getApplicationDataPath());
         appPath.removeRecursively();
-        this->tdLibClient = td_json_client_create();
+        this->tdLibClientId = td_create_client_id();
         initializeTDLibReceiver();
         this->isLoggingOut = false;
     }
@@ -1885,41 +2194,50 @@ void TDLibWrapper::handleUserUpdated(const QVariantMap &updatedUserInformation)
         emit ownUserUpdated(updatedUserInformation);
     }
     LOG("User information updated:" << updatedUserInformation.value(USERNAMES).toMap().value(EDITABLE_USERNAME).toString() << updatedUserInformation.value(FIRST_NAME).toString() << updatedUserInformation.value(LAST_NAME).toString());
-    updateUserInformation(updatedUserId, updatedUserInformation);
+    this->users.update(updatedUserInformation);
     emit userUpdated(updatedUserId, updatedUserInformation);
 }
 
-void TDLibWrapper::handleUserStatusUpdated(const QString &userId, const QVariantMap &userStatusInformation)
+void TDLibWrapper::handleUserStatusUpdated(const UserStatusUpdate &update)
 {
-    if (userId == this->options.value("my_id").toString()) {
+    const QString userId(QString::number(update.userId));
+    if (update.userId == this->options.value("my_id").toLongLong()) {
         LOG("Own user status information updated :)");
-        this->userInformation.insert(STATUS, userStatusInformation);
+        this->userInformation.insert(STATUS, update.status);
     }
-    QVariantMap updatedUserInformation = this->usersById.value(userId).toMap();
-    if(updatedUserInformation[STATUS] == userStatusInformation) {
+    if (!this->users.updateStatus(update.userId, update.status)) {
         return;
     }
-    LOG("User status information updated:" << userId << userStatusInformation.value(_TYPE).toString());
-    updatedUserInformation.insert(STATUS, userStatusInformation);
-    updateUserInformation(userId, updatedUserInformation);
-    emit userUpdated(userId, updatedUserInformation);
+    LOG("User status information updated:" << userId << update.type);
+    emit userStatusUpdated(userId, update.status);
+}
+
+void TDLibWrapper::handleFileUpdated(const FileUpdate &update)
+{
+    if (!update.isDownloadingActive && this->requestQueue.release(DOWNLOAD_HOLD_KEY + QString::number(update.id))) {
+        sendQueuedRequests();
+    }
+    emit fileUpdate(update);
+    emit fileUpdated(update.id, update.file);
 }
 
-void TDLibWrapper::updateUserInformation(const QString &userId, const QVariantMap &userInformation)
+void TDLibWrapper::handleChatLastMessageUpdated(const ChatLastMessageUpdate &update)
 {
-    this->usersById.insert(userId, userInformation);
-    this->usersByName.insert(userInformation.value(USERNAMES).toMap().value(EDITABLE_USERNAME).toString(), userInformation);
+    emit chatLastMessageUpdate(update);
+    emit chatLastMessageUpdated(QString::number(update.chatId), (update.order < 0) ? QString() : QString::number(update.order), update.lastMessage);
 }
 
-void TDLibWrapper::handleFileUpdated(const QVariantMap &fileInformation)
+void TDLibWrapper::handleChatPositionUpdated(const ChatPositionUpdate &update)
 {
-    emit fileUpdated(fileInformation.value(ID).toInt(), fileInformation);
+    emit chatPositionUpdate(update);
+    if (update.chatListId == ChatPositionUpdate::ChatListMain) {
+        emit chatOrderUpdated(QString::number(update.chatId), QString::number(update.order));
+    }
 }
 
 void TDLibWrapper::handleNewChatDiscovered(const QVariantMap &chatInformation)
 {
     QString chatId = chatInformation.value(ID).toString();
-    this->chats.insert(chatId, chatInformation);
     emit newChatDiscovered(chatId, chatInformation);
 }
 
@@ -1981,12 +2299,7 @@ void TDLibWrapper::handleUnreadChatCountUpdated(const QVariantMap &chatCountInfo
 void TDLibWrapper::handleAvailableReactionsUpdated(qlonglong chatId, const QVariantMap &availableReactions)
 {
     LOG("Updating available reactions for chat" << chatId << availableReactions);
-    QString chatIdString = QString::number(chatId);
-    QVariantMap chatInformation = this->getChat(chatIdString);
-    chatInformation.insert(CHAT_AVAILABLE_REACTIONS, availableReactions);
-    this->chats.insert(chatIdString, chatInformation);
     emit chatAvailableReactionsUpdated(chatId, availableReactions);
-
 }
 
 void TDLibWrapper::handleBasicGroupUpdated(qlonglong groupId, const QVariantMap &groupInformation)
@@ -2053,24 +2366,125 @@ void TDLibWrapper::handleStorageOptimizerChanged()
 
 void TDLibWrapper::handleErrorReceived(int code, const QString &message, const QString &extra)
 {
-    if (!extra.isEmpty()) {
-        QStringList parts(extra.split(':'));
-        if (parts.size() == 3 && parts.at(0) == QStringLiteral("getMessage")) {
-            emit messageNotFound(parts.at(1).toLongLong(), parts.at(2).toLongLong());
-        }
-    }
     emit errorReceived(code, message, extra);
 }
 
 void TDLibWrapper::handleMessageInformation(qlonglong chatId, qlonglong messageId, const QVariantMap &receivedInformation)
 {
-    QString extraInformation = receivedInformation.value(_EXTRA).toString();
-    if (extraInformation.startsWith("getChatPinnedMessage:")) {
-        emit chatPinnedMessageUpdated(chatId, messageId);
-    }
     emit receivedMessage(chatId, messageId, receivedInformation);
 }
 
+void TDLibWrapper::handleResponseReceived(const QString &extra, const QVariantMap &response)
+{
+    TDLibResponse *pendingResponse = this->pendingResponses.take(extra);
+    if (pendingResponse) {
+        pendingResponse->complete(response);
+    } else if (this->replayMode) {
+        // Response ids are handed out in order, so a recording replayed
+        // into the same sequence of requests completes them one by one.
+        // Anything else goes where it would have gone without a handle.
+        LOG("Replaying unmatched response" << extra << response.value(_TYPE).toString());
+        this->tdLibReceiver->replayResponse(response);
+    } else {
+        // Cancelled, timed out or left over from the previous client
+        LOG("Dropping response" << extra << response.value(_TYPE).toString());
+    }
+}
+
+void TDLibWrapper::handleResponseReleased(const QString &extra)
+{
+    this->pendingResponses.remove(extra);
+}
+
+void TDLibWrapper::handleQueuedRequestCompleted(qlonglong requestId, bool active)
+{
+    this->requestQueue.complete(requestId, active);
+    sendQueuedRequests();
+}
+
+void TDLibWrapper::handleChatPageLoaded()
+{
+    this->chatPagesLoaded++;
+    this->chatPageRetries = 0;
+    if (this->chatListFirstPageTime < 0) {
+        this->chatListFirstPageTime = this->chatListTimer.elapsed();
+        LOG("First page of chats loaded after" << this->chatListFirstPageTime << "ms");
+    }
+    emit chatListPageLoaded(this->chatPagesLoaded, this->chatPageSize);
+    // Keep going until TDLib runs out of chats, in bigger and bigger steps
+    this->chatPageSize = qMin(this->chatPageSize * 2, CHAT_PAGE_SIZE_MAX);
+    this->loadNextChatPage();
+}
+
+void TDLibWrapper::handleChatPageFailed(int code, const QString &message)
+{
+    if (code != CHAT_LIST_NOT_FOUND_CODE && this->chatPageRetries < CHAT_PAGE_RETRY_MAX &&
+        !this->isLoggingOut && !this->tdLibReceiver->isClosed()) {
+        // Timeouts and network trouble during startup are worth another try,
+        // with the same page size
+        const int delay = CHAT_PAGE_RETRY_DELAY << this->chatPageRetries++;
+        WARN("Failed to load chats:" << code << message << "retrying in" << delay << "ms");
+        QTimer::singleShot(delay, this, SLOT(loadNextChatPage()));
+        return;
+    }
+    this->chatListLoading = false;
+    if (code == CHAT_LIST_NOT_FOUND_CODE) {
+        // That's how TDLib says that all chats have been loaded
+        this->chatListCompleteTime = this->chatListTimer.elapsed();
+        LOG("Chat list complete after" << this->chatListCompleteTime << "ms," << this->chatPagesLoaded << "pages," << this->chats.count() << "chats");
+        emit chatListLoaded();
+    } else {
+        WARN("Failed to load chats, giving up:" << code << message);
+        emit chatListLoadFailed();
+    }
+}
+
+void TDLibWrapper::handleMessageResponse(const QVariantMap &message)
+{
+    const QVariantMap cleanMessage(TDLibReceiver::cleanupMap(message));
+    emit receivedMessage(cleanMessage.value(CHAT_ID).toLongLong(), cleanMessage.value(ID).toLongLong(), cleanMessage);
+}
+
+void TDLibWrapper::handleMessageResponseFailed(int code, const QString &message)
+{
+    TDLibResponse *response = qobject_cast<TDLibResponse*>(sender());
+    if (!response) {
+        WARN("Message not received:" << code << message);
+        return;
+    }
+    const QVariantList ids(response->getContext().toList());
+    LOG("Message" << ids << "not received:" << code << message);
+    emit messageNotFound(ids.value(0).toLongLong(), ids.value(1).toLongLong());
+}
+
+void TDLibWrapper::handlePinnedMessageResponse(const QVariantMap &message)
+{
+    const QVariantMap cleanMessage(TDLibReceiver::cleanupMap(message));
+    const qlonglong chatId = cleanMessage.value(CHAT_ID).toLongLong();
+    const qlonglong messageId = cleanMessage.value(ID).toLongLong();
+    emit chatPinnedMessageUpdated(chatId, messageId);
+    emit receivedMessage(chatId, messageId, cleanMessage);
+}
+
+void TDLibWrapper::handlePinnedMessageResponseFailed(int code, const QString &message)
+{
+    TDLibResponse *response = qobject_cast<TDLibResponse*>(sender());
+    if (!response) {
+        WARN("Pinned message not received:" << code << message);
+        return;
+    }
+    const qlonglong chatId = response->getContext().toLongLong();
+    if (code == MESSAGE_NOT_FOUND_CODE) {
+        // That's how TDLib says that nothing is pinned (anymore)
+        LOG("No pinned message in chat" << chatId);
+        emit chatPinnedMessageUpdated(chatId, 0);
+    } else {
+        // Reported like any other error, as it was before the request got a handle
+        WARN("Pinned message of chat" << chatId << "not received:" << code << message);
+        emit errorReceived(code, message, "getChatPinnedMessage:" + QString::number(chatId));
+    }
+}
+
 void TDLibWrapper::handleMessageIsPinnedUpdated(qlonglong chatId, qlonglong messageId, bool isPinned)
 {
     if (isPinned) {
@@ -2247,6 +2661,12 @@ void TDLibWrapper::handleApplicationStateChanged(Qt::ApplicationState state) {
     this->tdLibReceiver->setPowerSavingMode(state != Qt::ApplicationState::ApplicationActive);
 }
 
+void TDLibWrapper::handleDisplayStatusChanged(const QString &displayStatus)
+{
+    LOG("Display status changed" << displayStatus);
+    this->tdLibReceiver->setDisplayOn(displayStatus != "off");
+}
+
 QVariantMap& TDLibWrapper::fillTdlibParameters(QVariantMap& parameters)
 {
     parameters.insert("api_id", TDLIB_API_ID);
@@ -2426,7 +2846,7 @@ const TDLibWrapper::Group *TDLibWrapper::updateGroup(qlonglong groupId, const QV
         group = new Group(groupId);
         groups->insert(groupId, group);
     }
-    group->groupInfo = groupInfo;
+    group->update(groupInfo);
     return group;
 }
 
@@ -2468,10 +2888,28 @@ TDLibWrapper::SecretChatState TDLibWrapper::secretChatStateFromString(const QStr
         SecretChatStateUnknown;
 }
 
-TDLibWrapper::ChatMemberStatus TDLibWrapper::Group::chatMemberStatus() const
+TDLibWrapper::Group::Group(qlonglong id) :
+    groupId(id),
+    memberStatus(ChatMemberStatusUnknown),
+    memberCount(0),
+    verified(false)
+{
+}
+
+void TDLibWrapper::Group::update(const QVariantMap &groupInfo)
+{
+    const QVariantMap status(groupInfo.value(STATUS).toMap());
+    const QString statusType(status.value(_TYPE).toString());
+    memberStatus = statusType.isEmpty() ? ChatMemberStatusUnknown : chatMemberStatusFromString(statusType);
+    permissions = status.value(PERMISSIONS).toMap();
+    memberCount = groupInfo.value(MEMBER_COUNT).toInt();
+    verified = groupInfo.value(IS_VERIFIED).toBool();
+    data = groupInfo;
+}
+
+QVariantMap TDLibWrapper::Group::toMap() const
 {
-    const QString statusType(groupInfo.value(STATUS).toMap().value(_TYPE).toString());
-    return statusType.isEmpty() ? ChatMemberStatusUnknown : chatMemberStatusFromString(statusType);
+    return data;
 }
 
 QString TDLibWrapper::getApplicationDataPath() const {
@@ -20,6 +20,7 @@
 #define TDLIBWRAPPER_H
 
 #include <QCoreApplication>
+#include <QElapsedTimer>
 #include <QUrl>
 #include <QNetworkRequest>
 #include <QNetworkReply>
@@ -27,6 +28,11 @@
 #include <QNetworkConfigurationManager>
 #include <td/telegram/td_json_client.h>
 #include "tdlibreceiver.h"
+#include "tdlibrequest.h"
+#include "tdlibresponse.h"
+#include "tdlibrequestqueue.h"
+#include "userstore.h"
+#include "chatstore.h"
 #include "dbusadaptor.h"
 #include "dbusinterface.h"
 #include "emojisearchworker.h"
@@ -124,13 +130,26 @@ public:
     };
     Q_ENUM(NetworkType)
 
+    enum RequestPriority {
+        PriorityInteractive,
+        PriorityVisibleMedia,
+        PriorityBackground
+    };
+    Q_ENUM(RequestPriority)
+
     class Group {
     public:
-        Group(qlonglong id) : groupId(id) { }
-        ChatMemberStatus chatMemberStatus() const;
+        Group(qlonglong id);
+        void update(const QVariantMap &groupInfo);
+        QVariantMap toMap() const;
     public:
         const qlonglong groupId;
-        QVariantMap groupInfo;
+        ChatMemberStatus memberStatus;
+        QVariantMap permissions; // Only set for restricted members
+        int memberCount;
+        bool verified;
+    private:
+        QVariantMap data; // As received, shared rather than copied
     };
 
     Q_INVOKABLE QString getVersion();
@@ -141,18 +160,30 @@ public:
     Q_INVOKABLE QVariantMap getUserInformation(const QString &userId);
     Q_INVOKABLE bool hasUserInformation(const QString &userId);
     Q_INVOKABLE QVariantMap getUserInformationByName(const QString &userName);
+    // Cheap alternatives to getUserInformation for the frequently used fields
+    Q_INVOKABLE QString getUserFullName(const QString &userId) const;
+    Q_INVOKABLE QString getUserUsername(const QString &userId) const;
+    Q_INVOKABLE QVariantMap getUserStatus(const QString &userId) const;
+    Q_INVOKABLE int getUserPhotoFileId(const QString &userId) const;
+    const UserStore::User *getUser(qlonglong userId) const;
     Q_INVOKABLE UserPrivacySettingRule getUserPrivacySettingRule(UserPrivacySetting userPrivacySetting);
     Q_INVOKABLE QVariantMap getUnreadMessageInformation();
     Q_INVOKABLE QVariantMap getUnreadChatInformation();
     Q_INVOKABLE QVariantMap getBasicGroup(qlonglong groupId) const;
     Q_INVOKABLE QVariantMap getSuperGroup(qlonglong groupId) const;
     Q_INVOKABLE QVariantMap getChat(const QString &chatId);
+    const ChatStore *getChatStore() const;
     Q_INVOKABLE QVariantMap getSecretChatFromCache(qlonglong secretChatId);
     Q_INVOKABLE QStringList getChatReactions(const QString &chatId);
     Q_INVOKABLE QString getOptionString(const QString &optionName);
     Q_INVOKABLE void copyFileToDownloads(const QString &filePath, bool openAfterCopy = false);
     Q_INVOKABLE void openFileOnDevice(const QString &filePath);
     Q_INVOKABLE void controlScreenSaver(bool enabled);
+    Q_INVOKABLE QVariantMap getReceiverStatistics() const;
+    Q_INVOKABLE QVariantMap benchmarkRequests(int iterations) const;
+    Q_INVOKABLE QVariantMap getRequestQueueStatistics() const;
+    Q_INVOKABLE QVariantMap getChatListStatistics() const;
+    void registerChatListPainted();
     Q_INVOKABLE bool getJoinChatRequested();
     Q_INVOKABLE void registerJoinChat();
 
@@ -160,14 +191,18 @@ public:
 
     // Direct TDLib functions
     Q_INVOKABLE void sendRequest(const QVariantMap &requestObject);
+    // The response only goes to the returned handle. The timeout is in
+    // milliseconds, zero means none.
+    TDLibResponse *sendRequest(const QVariantMap &requestObject, int timeout);
     Q_INVOKABLE void setAuthenticationPhoneNumber(const QString &phoneNumber);
     Q_INVOKABLE void setAuthenticationCode(const QString &authenticationCode);
     Q_INVOKABLE void setAuthenticationPassword(const QString &authenticationPassword);
     Q_INVOKABLE void registerUser(const QString &firstName, const QString &lastName);
     Q_INVOKABLE void logout();
-    Q_INVOKABLE void getChats();
+    // The first page should fit the screen, the following ones get bigger
+    Q_INVOKABLE void getChats(int firstPageSize = 0);
     Q_INVOKABLE void getChatFolder(qlonglong folderID);
-    Q_INVOKABLE void downloadFile(int fileId);
+    Q_INVOKABLE void downloadFile(int fileId, TDLibWrapper::RequestPriority priority = PriorityVisibleMedia);
     Q_INVOKABLE void openChat(const QString &chatId);
     Q_INVOKABLE void closeChat(const QString &chatId);
     Q_INVOKABLE void joinChat(const QString &chatId);
@@ -203,7 +238,7 @@ public:
     Q_INVOKABLE void getStickerSet(const QString &setId);
     Q_INVOKABLE void getSupergroupMembers(const QString &groupId, int limit, int offset);
     Q_INVOKABLE void getGroupFullInfo(const QString &groupId, bool isSuperGroup);
-    Q_INVOKABLE void getUserFullInfo(const QString &userId);
+    Q_INVOKABLE void getUserFullInfo(const QString &userId, TDLibWrapper::RequestPriority priority = PriorityInteractive);
     Q_INVOKABLE void createPrivateChat(const QString &userId, const QString &extra);
     Q_INVOKABLE void createNewSecretChat(const QString &userId, const QString &extra);
     Q_INVOKABLE void createSupergroupChat(const QString &supergroupId, const QString &extra);
@@ -273,18 +308,24 @@ signals:
     void optionUpdated(const QString &optionName, const QVariant &optionValue);
     void connectionStateChanged(const TDLibWrapper::ConnectionState &connectionState);
     void fileUpdated(int fileId, const QVariantMap &fileInformation);
+    void fileUpdate(const FileUpdate &update);
     void newChatDiscovered(const QString &chatId, const QVariantMap &chatInformation);
     void chatFolders(const QVariantList &folders, qlonglong mainChatlistPosition);
     void chatFolder(const QVariantMap &chatFolderInformation);
+    void chatListPageLoaded(int page, int pageSize);
+    void chatListLoaded();
+    void chatListLoadFailed();
     void unreadMessageCountUpdated(const QVariantMap &messageCountInformation);
     void unreadChatCountUpdated(const QVariantMap &chatCountInformation);
     void chatLastMessageUpdated(const QString &chatId, const QString &order, const QVariantMap &lastMessage);
+    void chatLastMessageUpdate(const ChatLastMessageUpdate &update);
     void chatOrderUpdated(const QString &chatId, const QString &order);
-    void chatPinnedUpdated(qlonglong chatId, bool isPinned);
-    void chatReadInboxUpdated(const QString &chatId, const QString &lastReadInboxMessageId, int unreadCount);
-    void chatReadOutboxUpdated(const QString &chatId, const QString &lastReadOutboxMessageId);
+    void chatPositionUpdate(const ChatPositionUpdate &update);
+    void chatReadInboxUpdate(const ChatReadInboxUpdate &update);
+    void chatReadOutboxUpdate(const ChatReadOutboxUpdate &update);
     void chatAvailableReactionsUpdated(const qlonglong &chatId, const QVariantMap &availableReactions);
     void userUpdated(const QString &userId, const QVariantMap &userInformation);
+    void userStatusUpdated(const QString &userId, const QVariantMap &status);
     void ownUserUpdated(const QVariantMap &userInformation);
     void basicGroupUpdated(qlonglong groupId);
     void superGroupUpdated(qlonglong groupId);
@@ -352,8 +393,10 @@ public slots:
     void handleOptionUpdated(const QString &optionName, const QVariant &optionValue);
     void handleConnectionStateChanged(const QString &connectionState);
     void handleUserUpdated(const QVariantMap &updatedUserInformation);
-    void handleUserStatusUpdated(const QString &userId, const QVariantMap &userStatusInformation);
-    void handleFileUpdated(const QVariantMap &fileInformation);
+    void handleUserStatusUpdated(const UserStatusUpdate &update);
+    void handleFileUpdated(const FileUpdate &update);
+    void handleChatLastMessageUpdated(const ChatLastMessageUpdate &update);
+    void handleChatPositionUpdated(const ChatPositionUpdate &update);
     void handleNewChatDiscovered(const QVariantMap &chatInformation);
     void handleChatFolders(const QVariantList &foldersInformation, qlonglong mainChatlistPosition);
     void handleChatFolder(const QVariantMap &chatFolderInforamtion);
@@ -379,6 +422,17 @@ public slots:
     void handleActiveEmojiReactionsUpdated(const QStringList& emojis);
     void handleGetPageSourceFinished();
     void handleApplicationStateChanged(Qt::ApplicationState state);
+    void handleDisplayStatusChanged(const QString &displayStatus);
+    void handleResponseReceived(const QString &extra, const QVariantMap &response);
+    void handleResponseReleased(const QString &extra);
+    void handleQueuedRequestCompleted(qlonglong requestId, bool active);
+    void handleMessageResponse(const QVariantMap &message);
+    void handleMessageResponseFailed(int code, const QString &message);
+    void handlePinnedMessageResponse(const QVariantMap &message);
+    void handlePinnedMessageResponseFailed(int code, const QString &message);
+    void handleChatPageLoaded();
+    void handleChatPageFailed(int code, const QString &message);
+    void loadNextChatPage();
 
 private:
     void setOption(const QString &name, const QString &type, const QVariant &value);
@@ -389,11 +443,21 @@ private:
     const Group *updateGroup(qlonglong groupId, const QVariantMap &groupInfo, QHash<qlonglong,Group*> *groups);
     QVariantMap newSendMessageRequest(qlonglong chatId, qlonglong replyToMessageId);
     void initializeTDLibReceiver();
-    void updateUserInformation(const QString &userId, const QVariantMap &userInformation);
+    void sendRequest(TDLibRequest &request);
+    TDLibResponse *sendRequest(TDLibRequest &request, int timeout);
+    TDLibResponse *newResponse(int timeout);
+    void failPendingResponses(int code, const QString &message);
+    void queueRequest(const QVariantMap &requestObject, RequestPriority priority);
+    void queueRequest(TDLibRequest &request, RequestPriority priority, const QString &holdKey = QString());
+    void sendQueuedRequests();
     QString getApplicationDataPath() const;
 
 private:
-    void *tdLibClient;
+    int tdLibClientId;
+    QByteArray requestBuffer;
+    QHash<QString, TDLibResponse*> pendingResponses;
+    quint64 lastResponseId;
+    TDLibRequestQueue requestQueue;
     QNetworkAccessManager *manager;
     QNetworkConfigurationManager *networkConfigurationManager;
     AppSettings *appSettings;
@@ -407,9 +471,8 @@ private:
     QVariantMap options;
     QVariantMap userInformation;
     QMap<UserPrivacySetting, UserPrivacySettingRule> userPrivacySettingRules;
-    QVariantMap usersById;
-    QVariantMap usersByName;
-    QVariantMap chats;
+    UserStore users;
+    ChatStore chats;
     QMap<qlonglong, QVariantMap> secretChats;
     QVariantMap unreadMessageInformation;
     QVariantMap unreadChatInformation;
@@ -422,6 +485,17 @@ private:
     QString activeChatSearchName;
     bool joinChatRequested;
     bool isLoggingOut;
+    QString recordingFile;
+    QString replayFile;
+    bool replayMode;
+    QElapsedTimer chatListTimer;
+    bool chatListLoading;
+    int chatPageSize;
+    int chatPagesLoaded;
+    int chatPageRetries;
+    qint64 chatListFirstPageTime;
+    qint64 chatListFirstPaintTime;
+    qint64 chatListCompleteTime;
 
 };
 
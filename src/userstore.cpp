@@ -0,0 +1,173 @@
+/*
+    Copyright (C) 2020 Sebastian J. Wolf and other contributors
+
+    This file is part of Fernschreiber.
+
+    Fernschreiber is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Fernschreiber is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Fernschreiber. If not, see <http://www.gnu.org/licenses/>.
+*/
+#include "userstore.h"
+
+#include <QJsonDocument>
+
+#define DEBUG_MODULE UserStore
+#include "debuglog.h"
+
+namespace {
+    const QString ID("id");
+    const QString STATUS("status");
+    const QString FIRST_NAME("first_name");
+    const QString LAST_NAME("last_name");
+    const QString USERNAMES("usernames");
+    const QString EDITABLE_USERNAME("editable_username");
+    const QString ACTIVE_USERNAMES("active_usernames");
+    const QString PROFILE_PHOTO("profile_photo");
+    const QString SMALL("small");
+    const QString IS_CONTACT("is_contact");
+    const QString TYPE("type");
+    const QString _TYPE("@type");
+    const QString USER_TYPE_BOT("userTypeBot");
+}
+
+QString UserStore::User::fullName() const
+{
+    return QString(firstName + " " + lastName).trimmed();
+}
+
+UserStore::UserStore()
+{
+}
+
+UserStore::~UserStore()
+{
+    qDeleteAll(users);
+}
+
+int UserStore::count() const
+{
+    return users.count();
+}
+
+bool UserStore::contains(qlonglong userId) const
+{
+    return users.contains(userId);
+}
+
+const UserStore::User *UserStore::value(qlonglong userId) const
+{
+    return users.value(userId);
+}
+
+const UserStore::User *UserStore::findByUsername(const QString &username) const
+{
+    return usernames.value(username.toLower());
+}
+
+QVariantMap UserStore::toMap(qlonglong userId) const
+{
+    return toMap(users.value(userId));
+}
+
+QVariantMap UserStore::toMap(const User *user)
+{
+    if (!user) {
+        return QVariantMap();
+    }
+    if (user->map.isEmpty()) {
+        user->map = QJsonDocument::fromJson(user->json).toVariant().toMap();
+        if (!user->status.isEmpty()) {
+            user->map.insert(STATUS, user->status);
+        }
+    }
+    return user->map;
+}
+
+const UserStore::User *UserStore::update(const QVariantMap &userInformation)
+{
+    const qlonglong userId = userInformation.value(ID).toLongLong();
+    User *user = users.value(userId);
+    if (user) {
+        removeUsernames(user);
+    } else {
+        user = new User(userId);
+        users.insert(userId, user);
+    }
+
+    const QVariantMap names(userInformation.value(USERNAMES).toMap());
+    const QString editableUsername(names.value(EDITABLE_USERNAME).toString());
+    user->usernames.clear();
+    if (!editableUsername.isEmpty()) {
+        user->usernames.append(editableUsername);
+    }
+    const QVariantList activeUsernames(names.value(ACTIVE_USERNAMES).toList());
+    for (const QVariant &activeUsername : activeUsernames) {
+        const QString username(activeUsername.toString());
+        if (!username.isEmpty() && username != editableUsername) {
+            user->usernames.append(username);
+        }
+    }
+    addUsernames(user);
+
+    user->firstName = userInformation.value(FIRST_NAME).toString();
+    user->lastName = userInformation.value(LAST_NAME).toString();
+    user->status = userInformation.value(STATUS).toMap();
+    user->photoSmall = userInformation.value(PROFILE_PHOTO).toMap().value(SMALL).toMap();
+    user->photoFileId = user->photoSmall.value(ID).toInt();
+    user->isContact = userInformation.value(IS_CONTACT).toBool();
+    user->isBot = userInformation.value(TYPE).toMap().value(_TYPE).toString() == USER_TYPE_BOT;
+
+    // The status is updated separately and much more often
+    QVariantMap rest(userInformation);
+    rest.remove(STATUS);
+    user->json = QJsonDocument::fromVariant(rest).toJson(QJsonDocument::Compact);
+    user->map.clear();
+    return user;
+}
+
+bool UserStore::updateStatus(qlonglong userId, const QVariantMap &status)
+{
+    User *user = users.value(userId);
+    if (user && user->status != status) {
+        user->status = status;
+        if (!user->map.isEmpty()) {
+            user->map.insert(STATUS, status);
+        }
+        return true;
+    }
+    return false;
+}
+
+void UserStore::clear()
+{
+    qDeleteAll(users);
+    users.clear();
+    usernames.clear();
+}
+
+void UserStore::addUsernames(User *user)
+{
+    for (const QString &username : user->usernames) {
+        usernames.insert(username.toLower(), user);
+    }
+}
+
+void UserStore::removeUsernames(const User *user)
+{
+    for (const QString &username : user->usernames) {
+        // The name may have been taken over by somebody else in the meantime
+        const QString key(username.toLower());
+        if (usernames.value(key) == user) {
+            usernames.remove(key);
+        }
+    }
+}
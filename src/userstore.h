@@ -0,0 +1,80 @@
+/*
+    Copyright (C) 2020 Sebastian J. Wolf and other contributors
+
+    This file is part of Fernschreiber.
+
+    Fernschreiber is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Fernschreiber is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Fernschreiber. If not, see <http://www.gnu.org/licenses/>.
+*/
+#ifndef USERSTORE_H
+#define USERSTORE_H
+
+#include <QByteArray>
+#include <QHash>
+#include <QString>
+#include <QStringList>
+#include <QVariantMap>
+
+// The users known to TDLibWrapper. The fields which the UI keeps asking
+// for are stored as such, the rest of the user object is kept as compact
+// JSON and only turned back into a QVariantMap when somebody asks for it.
+// That map is then kept until the user gets updated, so that the message
+// delegates asking for the same few senders get it for free.
+
+class UserStore
+{
+public:
+    class User {
+    public:
+        User(qlonglong userId) : id(userId), photoFileId(0), isContact(false), isBot(false) {}
+        QString fullName() const;
+    public:
+        const qlonglong id;
+        QString firstName;
+        QString lastName;
+        QStringList usernames; // Active ones, the editable one goes first
+        QVariantMap status;
+        QVariantMap photoSmall; // Small profile photo, empty if none
+        int photoFileId; // Its file id, zero if none
+        bool isContact;
+        bool isBot;
+        QByteArray json; // Everything but the status
+        mutable QVariantMap map; // Decoded on demand, empty until then
+    };
+
+    UserStore();
+    ~UserStore();
+
+    int count() const;
+    bool contains(qlonglong userId) const;
+    const User *value(qlonglong userId) const;
+    const User *findByUsername(const QString &username) const;
+    QVariantMap toMap(qlonglong userId) const;
+
+    const User *update(const QVariantMap &userInformation);
+    // Returns false if the user is unknown or the status hasn't changed
+    bool updateStatus(qlonglong userId, const QVariantMap &status);
+    void clear();
+
+    static QVariantMap toMap(const User *user);
+
+private:
+    void addUsernames(User *user);
+    void removeUsernames(const User *user);
+
+private:
+    QHash<qlonglong, User*> users;
+    QHash<QString, User*> usernames; // Lower case, usernames are case insensitive
+};
+
+#endif // USERSTORE_H